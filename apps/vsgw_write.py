@@ -0,0 +1,65 @@
+#!/usr/bin/env python3
+#
+# Copyright 2022 Signal Hound.
+#
+# SPDX-License-Identifier: GPL-3.0-or-later
+#
+
+"""
+Convert a raw complex64 file, as written by a GNU Radio file sink, to a
+.vsgw waveform file that the VSG60 IQ Sink block maps and plays directly.
+"""
+
+import argparse
+import struct
+import sys
+import zlib
+
+# magic, version, data_offset, checksum, length, sample_rate, frequency, level
+HEADER = struct.Struct('<4sIIIQddd')
+VERSION = 1
+SAMPLE_SIZE = 8
+CHUNK = 1 << 24
+# The body starts on a page boundary so the mapping can be used as is. A
+# multiple of every common page size, so files play on any host.
+DATA_OFFSET = 65536
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument('input', help='raw interleaved float32 I/Q file')
+    parser.add_argument('output', help='.vsgw file to write')
+    parser.add_argument('-r', '--sample-rate', type=float, required=True, help='sample rate (Hz)')
+    parser.add_argument('-f', '--frequency', type=float, required=True, help='center frequency (Hz)')
+    parser.add_argument('-l', '--level', type=float, default=-10, help='output level (dBm)')
+    args = parser.parse_args()
+
+    with open(args.input, 'rb') as src:
+        src.seek(0, 2)
+        length = src.tell() // SAMPLE_SIZE
+        if length == 0 or length > 0x7fffffff:
+            sys.exit('%s: sample count %d out of range' % (args.input, length))
+        src.seek(0)
+
+        with open(args.output, 'wb') as dst:
+            dst.write(b'\0' * DATA_OFFSET)
+
+            checksum = 0
+            remaining = length * SAMPLE_SIZE
+            while remaining:
+                chunk = src.read(min(CHUNK, remaining))
+                if not chunk:
+                    sys.exit('%s: ended early, %d bytes short' % (args.input, remaining))
+                checksum = zlib.crc32(chunk, checksum)
+                dst.write(chunk)
+                remaining -= len(chunk)
+
+            dst.seek(0)
+            dst.write(HEADER.pack(b'VSGW', VERSION, DATA_OFFSET, checksum, length,
+                                  args.sample_rate, args.frequency, args.level))
+
+    print('%s: %d samples, %.3f s' % (args.output, length, length / args.sample_rate))
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,91 @@
+#!/usr/bin/env python3
+#
+# Copyright 2022 Signal Hound.
+#
+# SPDX-License-Identifier: GPL-3.0-or-later
+#
+
+"""
+Pack a raw interleaved sc16 or sc8 I/Q capture into a .vsgz file of
+independently decodable zstd frames, which the VSG60 Compressed Player
+block decompresses in parallel and streams to the device.
+"""
+
+import argparse
+import struct
+import sys
+
+try:
+    import zstandard
+except ImportError:
+    sys.exit('vsgz_write.py needs the zstandard module, pip install zstandard')
+
+# magic, version, format, frame_samples, length, frame_count, index_offset,
+# sample_rate, frequency, level
+HEADER = struct.Struct('<4sIIIQQQddd')
+# offset, compressed size, samples
+FRAME = struct.Struct('<QII')
+VERSION = 1
+FORMATS = {'sc16': (0, 4), 'sc8': (1, 2)}
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument('input', help='raw interleaved integer I/Q file')
+    parser.add_argument('output', help='.vsgz file to write')
+    parser.add_argument('-t', '--type', choices=sorted(FORMATS), default='sc16',
+                        help='sample type of the input (default sc16)')
+    parser.add_argument('-r', '--sample-rate', type=float, required=True, help='sample rate (Hz)')
+    parser.add_argument('-f', '--frequency', type=float, required=True, help='center frequency (Hz)')
+    parser.add_argument('-l', '--level', type=float, default=-10, help='output level (dBm)')
+    parser.add_argument('-s', '--frame-samples', type=int, default=1 << 18,
+                        help='samples per frame, the unit decoded in parallel (default 262144)')
+    parser.add_argument('-z', '--zstd-level', type=int, default=3, help='zstd compression level')
+    args = parser.parse_args()
+
+    if not 0 < args.frame_samples <= 1 << 24:
+        sys.exit('frame samples must be 1 to %d' % (1 << 24))
+
+    fmt, sample_size = FORMATS[args.type]
+    compressor = zstandard.ZstdCompressor(level=args.zstd_level, write_content_size=True)
+    frame_bytes = args.frame_samples * sample_size
+
+    index = []
+    length = 0
+    with open(args.input, 'rb') as src, open(args.output, 'wb') as dst:
+        dst.write(b'\0' * HEADER.size)
+        offset = HEADER.size
+
+        while True:
+            chunk = src.read(frame_bytes)
+            if len(chunk) < sample_size:
+                break
+            chunk = chunk[:len(chunk) // sample_size * sample_size]
+
+            frame = compressor.compress(chunk)
+            dst.write(frame)
+            samples = len(chunk) // sample_size
+            index.append(FRAME.pack(offset, len(frame), samples))
+            offset += len(frame)
+            length += samples
+
+        if not index:
+            sys.exit('%s: no samples' % args.input)
+
+        # The index is read in place, keep its entries aligned
+        pad = -offset % 8
+        dst.write(b'\0' * pad)
+        index_offset = offset + pad
+        dst.write(b''.join(index))
+
+        dst.seek(0)
+        dst.write(HEADER.pack(b'VSGZ', VERSION, fmt, args.frame_samples, length, len(index),
+                              index_offset, args.sample_rate, args.frequency, args.level))
+
+    print('%s: %d samples in %d frames, %.3f s, ratio %.2f' %
+          (args.output, length, len(index), length / args.sample_rate,
+           length * sample_size / float(index_offset - HEADER.size)))
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,68 @@
+/*
+ * Copyright 2022 Signal Hound.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+/*
+ * Example producer for the vsg60.shm_ingest block. Writes a complex tone
+ * into the block's shared memory ring for a number of seconds. The ring
+ * paces the producer: when it is full, the device has not caught up yet.
+ *
+ *     cc -O2 -I<prefix>/include shm_producer.c -o shm_producer -lm -lrt
+ *     ./shm_producer /vsg60 10 1e6 50e6
+ */
+
+#include <vsg60/shm_ring.h>
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+int main(int argc, char **argv)
+{
+    if(argc < 2) {
+        fprintf(stderr, "usage: %s NAME [SECONDS] [TONE_HZ] [SAMPLE_RATE]\n", argv[0]);
+        return 1;
+    }
+    const char *name = argv[1];
+    double seconds = argc > 2 ? atof(argv[2]) : 10;
+    double tone = argc > 3 ? atof(argv[3]) : 1e6;
+    double srate = argc > 4 ? atof(argv[4]) : 50e6;
+
+    vsg60_ring ring;
+    if(vsg60_ring_open(&ring, name) < 0) {
+        perror("vsg60_ring_open");
+        return 1;
+    }
+
+    const uint64_t total = (uint64_t)(seconds * srate);
+    const double step = 2 * M_PI * tone / srate;
+    const struct timespec wait = {0, 100000};
+    uint64_t n = 0;
+
+    while(n < total) {
+        /* Generate in place, straight into the shared memory */
+        float *iq;
+        uint64_t len = vsg60_ring_write_span(&ring, &iq);
+        if(len == 0) {
+            nanosleep(&wait, NULL);
+            continue;
+        }
+        if(len > total - n) len = total - n;
+
+        for(uint64_t i = 0; i < len; i++) {
+            double phase = fmod(step * (double)(n + i), 2 * M_PI);
+            iq[2 * i] = (float)cos(phase);
+            iq[2 * i + 1] = (float)sin(phase);
+        }
+        vsg60_ring_commit(&ring, len);
+        n += len;
+    }
+
+    vsg60_ring_finish(&ring);
+    vsg60_ring_close(&ring);
+    printf("wrote %llu samples\n", (unsigned long long)n);
+    return 0;
+}
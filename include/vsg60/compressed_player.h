@@ -0,0 +1,70 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2022 Signal Hound.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#ifndef INCLUDED_VSG60_COMPRESSED_PLAYER_H
+#define INCLUDED_VSG60_COMPRESSED_PLAYER_H
+
+#include <gnuradio/block.h>
+#include <vsg60/api.h>
+#include <map>
+#include <string>
+
+namespace gr {
+namespace vsg60 {
+
+/*!
+ * \brief Streams a zstd compressed capture to the device at full rate.
+ * \ingroup vsg60
+ *
+ * Plays a .vsgz file, integer I/Q packed in independently decodable zstd
+ * frames, written by apps/vsgz_write.py. Frames are decompressed and
+ * converted to float by a pool of threads working ahead of the device.
+ * They are put back in order and submitted without passing through the
+ * flowgraph. Sample rate, frequency and level come from the file.
+ *
+ * A threads of 0 uses all cores but one. stats() compares the decode rate
+ * with the device's; a headroom below 1 means the pool cannot keep up and
+ * the output will stall.
+ *
+ * When the file ends the device is released to the next block, unless
+ * repeat is set. The device can be shared with other vsg60 blocks, see
+ * iqin. Requires the module to be built with zstd.
+ *
+ * The block has no stream ports. GRC attaches it to the flowgraph on its
+ * own; in Python use tb.connect(block), or a message connection, or it is
+ * not run. The "active" message port takes a bool, or a pair holding one
+ * as GUI widgets send, and calls set_active().
+ */
+class VSG60_API compressed_player : virtual public gr::block
+{
+public:
+    typedef std::shared_ptr<compressed_player> sptr;
+
+    static sptr make(const std::string &path,
+                     bool repeat = false,
+                     int threads = 0,
+                     int serial = 0);
+
+    //! Priority among the blocks sharing the device, higher wins
+    virtual void set_device_priority(int priority) = 0;
+    //! Request the device while running, or release it to the next block
+    virtual void set_active(bool active) = 0;
+
+    /*!
+     * Playback counters: submitted_samples, frames, stalls (times the
+     * device ran dry waiting for a frame), errors (corrupt frames skipped),
+     * ready_frames (decoded ahead), decode_rate (samples per second the
+     * pool can decode), device_rate (sample rate), headroom (their ratio)
+     * and compression_ratio.
+     */
+    virtual std::map<std::string, double> stats() = 0;
+};
+
+} // namespace vsg60
+} // namespace gr
+
+#endif /* INCLUDED_VSG60_COMPRESSED_PLAYER_H */
@@ -0,0 +1,81 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2022 Signal Hound.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#ifndef INCLUDED_VSG60_GENERATOR_H
+#define INCLUDED_VSG60_GENERATOR_H
+
+#include <gnuradio/block.h>
+#include <vsg60/api.h>
+#include <vector>
+
+namespace gr {
+namespace vsg60 {
+
+/*!
+ * \brief Generates test signals on the VSG60 without streaming samples.
+ * \ingroup vsg60
+ *
+ * CW (waveform 0) uses the device's own CW output. Multi-tone (1), chirp
+ * (2) and noise (3) waveforms are computed once when a parameter changes
+ * and repeated by the device, so no host CPU is used while they play.
+ *
+ * Tones are offsets from the center frequency in Hz, snapped to a 1 kHz
+ * grid so that the waveform repeats seamlessly. The chirp sweeps linearly
+ * across bandwidth Hz, centered, once per period. Noise is Gaussian,
+ * band limited to bandwidth Hz, and repeats every period seconds.
+ * Waveforms are scaled so their peak stays within full scale.
+ * make() and the setters throw std::invalid_argument for an unknown
+ * waveform, one longer than 2^24 samples at the sample rate, or tone
+ * offsets that are not within +/- half the sample rate, and leave the
+ * settings unchanged.
+ *
+ * All parameters can be changed while running. Output starts when the
+ * flowgraph starts and stops when it stops.
+ *
+ * The device can be shared with other vsg60 blocks, see iqin. Output
+ * starts whenever this block is handed the device, so switching between a
+ * stream and a test signal is a set_active() call.
+ *
+ * The block has no stream ports. GRC attaches it to the flowgraph on its
+ * own; in Python use tb.connect(block), or a message connection, or it is
+ * not run. The "active" message port takes a bool, or a pair holding one
+ * as GUI widgets send, and calls set_active().
+ */
+class VSG60_API generator : virtual public gr::block
+{
+public:
+    typedef std::shared_ptr<generator> sptr;
+
+    static sptr make(int waveform = 0,
+                     double frequency = 1e9,
+                     double level = -10,
+                     double srate = 50e6,
+                     int serial = 0);
+
+    //! 0 CW, 1 multi-tone, 2 chirp, 3 noise
+    virtual void set_waveform(int waveform) = 0;
+    virtual void set_frequency(double frequency) = 0;
+    virtual void set_level(double level) = 0;
+    virtual void set_srate(double srate) = 0;
+
+    //! Tone offsets from the center frequency, Hz
+    virtual void set_tones(const std::vector<double> &offsets) = 0;
+    //! Swept bandwidth in Hz and sweep period in seconds
+    virtual void set_chirp(double bandwidth, double period) = 0;
+    //! Noise bandwidth in Hz and repeat period in seconds
+    virtual void set_noise(double bandwidth, double period) = 0;
+
+    //! Priority among the blocks sharing the device, higher wins
+    virtual void set_device_priority(int priority) = 0;
+    //! Request the device while running, or release it to the next block
+    virtual void set_active(bool active) = 0;
+};
+
+} // namespace vsg60
+} // namespace gr
+
+#endif /* INCLUDED_VSG60_GENERATOR_H */
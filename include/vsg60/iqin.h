@@ -10,6 +10,9 @@
 
 #include <gnuradio/sync_block.h>
 #include <vsg60/api.h>
+#include <map>
+#include <string>
+#include <vector>
 
 namespace gr {
 namespace vsg60 {
@@ -18,6 +21,23 @@ namespace vsg60 {
  * \brief This block accepts I/Q data for the Signal Hound VSG60 vector signal generator to output.
  * \ingroup vsg60
  *
+ * cal_file names a table of I/Q imbalance and flatness corrections,
+ * applied for the current frequency before samples are submitted, see
+ * lib/iq_correction.h for the format. With threads > 1, preprocessing of
+ * large work() chunks is split across that many workers.
+ *
+ * Blocks in one process given the same serial number share the device,
+ * serial 0 opens the next device not yet opened, see set_device_priority().
+ * All the VSG60s in a process take turns on USB, see set_bus_capacity().
+ *
+ * API errors do not stop the flowgraph. They are logged and the affected
+ * samples are dropped. If the USB connection is lost the device is reopened
+ * by serial number, its settings are restored and streaming resumes.
+ *
+ * Stream tags "tx_time" and "trigger" are described at set_start_time(),
+ * "level" at set_level_automation(); tags are ignored in repeat mode.
+ * Message inputs are "align" and "level", outputs "latency", "health" and
+ * "signal".
  */
 class VSG60_API iqin : virtual public gr::sync_block
 {
@@ -27,13 +47,216 @@ public:
     static sptr make(double frequency = 1e9,
                      double level = -10,
                      double srate = 50e6,
-                     bool repeat = false);
+                     bool repeat = false,
+                     const std::string &cal_file = "",
+                     int threads = 1,
+                     int serial = 0);
 
 
     virtual void set_frequency(double frequency) = 0;
     virtual void set_level(double level) = 0;
     virtual void set_srate(double srate) = 0;
     virtual void set_repeat(bool repeat) = 0;                     
+
+    //! Pin the submitting thread to these CPUs, empty leaves affinity unchanged
+    virtual void set_submit_affinity(const std::vector<int> &cpus) = 0;
+    //! SCHED_FIFO priority for the submitting thread, 0 for normal scheduling
+    virtual void set_submit_priority(int priority) = 0;
+    //! Enable the API's power saving CPU mode, lowers CPU use but adds latency
+    virtual void set_power_saving(bool enabled) = 0;
+
+    /*!
+     * Submit timing since the last reset, in microseconds: count, call_mean,
+     * call_max, jitter_rms, jitter_min and jitter_max. Jitter is the time
+     * between submits minus the duration of the previously submitted samples.
+     */
+    virtual std::map<std::string, double> submit_stats() = 0;
+    virtual void reset_submit_stats() = 0;
+
+    /*!
+     * Keep the last samples submitted and, if input stalls long enough that
+     * the device would run dry, repeat them with vsgRepeatWaveform until
+     * input resumes. 0 disables concealment.
+     */
+    virtual void set_underrun_concealment(int samples) = 0;
+    //! Waveform repeated on underrun instead of the history, empty uses history
+    virtual void set_underrun_filler(const std::vector<gr_complex> &filler) = 0;
+    //! Underrun concealment counters: count and duration (seconds)
+    virtual std::map<std::string, double> underrun_stats() = 0;
+
+    /*!
+     * Stop sending silent runs, every sample at or below threshold
+     * magnitude, longer than min_silence seconds, 0 disables. RF output is
+     * turned off once the queued samples have played, and the next active
+     * samples are held until the skipped span would have played out.
+     */
+    virtual void set_gating(float threshold, double min_silence) = 0;
+    /*!
+     * Gating counters: spans, gated_samples, usb_bytes_saved,
+     * usb_fraction_saved and cpu_seconds_saved. CPU saved is estimated from
+     * the submitting thread's CPU time per submitted sample.
+     */
+    virtual std::map<std::string, double> gating_stats() = 0;
+
+    /*!
+     * Hold the next sample until this host time, seconds since the epoch.
+     * A "tx_time" tag, a tuple of integer and fractional seconds, holds the
+     * tagged sample the same way: submission waits until shortly before the
+     * deadline and prefills the queue with zeros so the sample starts on
+     * time. A "trigger" tag outputs a trigger at the tagged sample.
+     */
+    virtual void set_start_time(double seconds) = 0;
+    //! Time the trigger output stays high, seconds
+    virtual void set_trigger_length(double seconds) = 0;
+
+    /*!
+     * Insert a trigger marker every interval seconds of samples, 0 disables.
+     * When each marker plays is estimated from the submission and
+     * consumption rates. Timestamps of the trigger output, UDP datagrams
+     * "seq seconds" (host clock) received on udp_port, give the measured
+     * latency, 0 for estimates only. Results are published on the "latency"
+     * port. Histograms have bins bins over [0, max_latency) seconds, both
+     * must be positive.
+     */
+    virtual void set_latency_probe(double interval,
+                                   int udp_port = 0,
+                                   double max_latency = 0.1,
+                                   int bins = 100) = 0;
+    //! Measured (true) or estimated (false) latency histogram counts
+    virtual std::vector<uint64_t> latency_histogram(bool measured = true) = 0;
+    virtual std::map<std::string, double> latency_stats() = 0;
+
+    /*!
+     * Error recovery counters: errors, reconnects, downtime (seconds) and
+     * dropped_samples. Handovers between the blocks sharing the device:
+     * handovers, preemptions, and the switchover gap_count, gap_mean and
+     * gap_max (seconds).
+     */
+    virtual std::map<std::string, double> device_stats() = 0;
+
+    /*!
+     * Priority among the blocks sharing the device, higher wins, the latest
+     * request breaking a tie. A block releasing the device lets its queued
+     * samples play, one outranked is aborted. Without the device, input is
+     * consumed at the sample rate and discarded.
+     */
+    virtual void set_device_priority(int priority) = 0;
+    //! Request the device while running, or release it to the next block
+    virtual void set_active(bool active) = 0;
+
+    /*!
+     * Sample device health every interval seconds, 0 disables. Recalibrate
+     * once the temperature has drifted recal_threshold degrees C since the
+     * last calibration and output has stopped for as long as a
+     * recalibration takes, 0 never recalibrates. Runs on a low
+     * priority thread that only uses the device when the submit path is not
+     * waiting on it, and publishes on the "health" port and ControlPort.
+     * Blocks sharing the device share one monitor, at the shortest interval
+     * and lowest threshold any of them sets.
+     */
+    virtual void set_health_monitor(double interval, double recal_threshold = 0) = 0;
+    //! Last health sample: temperature, usb_ok, cal_date, rf_output and recals
+    virtual std::map<std::string, double> health() = 0;
+
+    /*!
+     * Write the VSG API calls recorded by all threads to path as Chrome
+     * trace JSON, viewable in Perfetto. Returns false if tracing was not
+     * enabled at build time (ENABLE_TRACING) or the file cannot be written.
+     */
+    virtual bool dump_trace(const std::string &path) = 0;
+
+    /*!
+     * Repeat the waveform in a .vsgw file, or output it once and return when
+     * done. An empty path stops a repeating file and resumes streaming the
+     * input. verify checks the body against the header checksum first.
+     *
+     * Files are written by apps/vsgw_write.py and play at the sample rate,
+     * frequency and level in their header. The file is mapped and handed to
+     * the API without conversion. While it repeats, input is discarded.
+     *
+     * Output once holds the device for the whole waveform, so work() and
+     * other blocks on the device wait until it has played.
+     */
+    virtual void play_waveform_file(const std::string &path,
+                                    bool repeat = true,
+                                    bool verify = false) = 0;
+
+    /*!
+     * Summarize the transmitted signal, after level automation and
+     * alignment, every interval seconds and before each retune, 0 disables.
+     * Published on the "signal" port with a CCDF of instantaneous power
+     * relative to the mean.
+     */
+    virtual void set_signal_stats(double interval) = 0;
+    /*!
+     * Last signal summary: samples, power_dbfs, rms, peak, crest_db,
+     * frequency and level. Amplitudes are in sample units, full scale 1 at
+     * level, the hardware level, so digital level changes show in power.
+     */
+    virtual std::map<std::string, double> signal_stats() = 0;
+
+    /*!
+     * Reach levels down to range dB below the hardware level digitally, 0
+     * disables, so fades and steps land on the exact sample. Gain up is
+     * limited to the headroom vsgGetIQScale leaves; only a level outside
+     * that window changes the hardware level, ahead of the samples needing
+     * it. While enabled set_level() is a digital step, and a "level" tag or
+     * message sets a level: dBm, or a (level, ramp seconds) pair or dict
+     * with "level" and "ramp". Not applied in repeat mode.
+     */
+    virtual void set_level_automation(double range) = 0;
+    //! Ramp the output level to level dBm, linear in dB over seconds
+    virtual void set_level_ramp(double level, double seconds) = 0;
+    //! Ramp through levels (dBm) spaced interval seconds apart, from the next sample
+    virtual void set_level_profile(const std::vector<double> &levels,
+                                   double interval,
+                                   bool repeat = false) = 0;
+    /*!
+     * Level automation state: level, target, hardware_level (dBm), headroom,
+     * digital_gain (dB), hardware_changes and limited_samples, samples whose
+     * gain was held to the headroom until the hardware level changed.
+     */
+    virtual std::map<std::string, double> level_stats() = 0;
+
+    /*!
+     * USB capacity shared by every VSG60 in the process, bytes per second, 0
+     * for the default. Devices take turns submitting, in chunks while more
+     * than one is open, one about to run dry first. A rate taking the
+     * combined rates past the capacity is logged, or with refuse, not set.
+     */
+    virtual void set_bus_capacity(double bytes_per_second, bool refuse = false) = 0;
+    /*!
+     * Bus governor state: devices, streaming, demand, capacity and
+     * measured_capacity (bytes per second), grants, waits, late (turns
+     * granted after the queue ran dry), wait_mean and wait_max (seconds).
+     */
+    virtual std::map<std::string, double> bus_stats() = 0;
+
+    /*!
+     * Delay the stream by 0 to 32 samples and rotate it by phase radians,
+     * to keep several devices coherent. A dict with "delay" and "phase" on
+     * the "align" port does the same. Settings are ramped to without steps,
+     * so alignment can be trimmed while streaming. Not applied in repeat
+     * mode.
+     */
+    virtual void set_alignment(double delay, double phase) = 0;
+    //! Alignment being applied or ramped to: delay (samples) and phase (radians)
+    virtual std::map<std::string, double> alignment() = 0;
+
+    /*!
+     * Record transmitted samples to path.sigmf-data and path.sigmf-meta,
+     * buffering up to queue_blocks 1 MiB blocks. An empty path stops.
+     * Written with O_DIRECT from a background thread; if the disk falls
+     * behind, whole blocks are dropped and counted. Setting changes, digital
+     * level changes included, drops and breaks start new captures, each
+     * holding the hardware level the samples are scaled against.
+     */
+    virtual void set_audit_recording(const std::string &path, int queue_blocks = 16) = 0;
+    /*!
+     * Recorder counters: recorded_samples, dropped_samples, dropped_blocks,
+     * write_errors and captures.
+     */
+    virtual std::map<std::string, double> audit_stats() = 0;
 };
 
 } // namespace vsg60
@@ -0,0 +1,87 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2022 Signal Hound.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#ifndef INCLUDED_VSG60_SEQUENCER_H
+#define INCLUDED_VSG60_SEQUENCER_H
+
+#include <gnuradio/block.h>
+#include <vsg60/api.h>
+#include <string>
+#include <vector>
+
+namespace gr {
+namespace vsg60 {
+
+/*!
+ * \brief Plays a playlist of preloaded waveform segments on the VSG60 without gaps.
+ * \ingroup vsg60
+ *
+ * Segments are loaded into memory up front, either from a file of
+ * interleaved 32-bit float I/Q (complex64) or from a vector. Playlist
+ * entries reference a segment and give the frequency and level to play it
+ * at, a duration and a repeat count. An entry plays its segment repeat
+ * times, or if duration is positive, loops the segment for exactly that
+ * many seconds.
+ *
+ * When the block starts, the full submission schedule is computed and fed
+ * to the device from a dedicated thread, submitting straight from segment
+ * memory. The playlist is played loops times, 0 plays until stopped.
+ *
+ * For each transition between entries, the difference between when the
+ * first sample of the entry was due and when the device could start it is
+ * estimated from the host clock. It is published as a dict on the
+ * "transitions" message port (keys entry, error, drift; seconds) and kept
+ * for transition_errors().
+ *
+ * A playlist file has one entry per line, '#' starts a comment:
+ *
+ *     segment_path frequency level duration repeat
+ *
+ * The device can be shared with other vsg60 blocks, see iqin. While
+ * another block owns it the schedule keeps time without submitting.
+ *
+ * The block has no stream ports. GRC attaches it to the flowgraph on its
+ * own; in Python use tb.connect(block), or a message connection, or it is
+ * not run.
+ */
+class VSG60_API sequencer : virtual public gr::block
+{
+public:
+    typedef std::shared_ptr<sequencer> sptr;
+
+    static sptr make(double srate = 50e6,
+                     int loops = 1,
+                     const std::string &playlist = "",
+                     int serial = 0);
+
+    virtual void add_segment(const std::string &name,
+                             const std::vector<gr_complex> &samples) = 0;
+    virtual void load_segment(const std::string &name, const std::string &path) = 0;
+    virtual void add_entry(const std::string &segment,
+                           double frequency,
+                           double level,
+                           double duration = 0,
+                           int repeat = 1) = 0;
+    virtual void load_playlist(const std::string &path) = 0;
+    virtual void clear() = 0;
+
+    virtual void set_srate(double srate) = 0;
+    virtual void set_loops(int loops) = 0;
+
+    //! Priority among the blocks sharing the device, higher wins
+    virtual void set_device_priority(int priority) = 0;
+    //! Request the device while running, or release it to the next block
+    virtual void set_active(bool active) = 0;
+
+    //! Timing error of each transition in the last run, seconds
+    virtual std::vector<double> transition_errors() = 0;
+};
+
+} // namespace vsg60
+} // namespace gr
+
+#endif /* INCLUDED_VSG60_SEQUENCER_H */
@@ -0,0 +1,74 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2022 Signal Hound.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#ifndef INCLUDED_VSG60_SHM_INGEST_H
+#define INCLUDED_VSG60_SHM_INGEST_H
+
+#include <gnuradio/block.h>
+#include <vsg60/api.h>
+#include <map>
+#include <string>
+
+namespace gr {
+namespace vsg60 {
+
+/*!
+ * \brief Plays I/Q written by another process into a shared memory ring.
+ * \ingroup vsg60
+ *
+ * The block creates a POSIX shared memory ring of capacity samples named
+ * name, see vsg60/shm_ring.h for the producer side and
+ * examples/shm_producer.c. Samples are submitted to the device straight
+ * from the mapping, without passing through the flowgraph, and their space
+ * is returned to the producer once the API has taken them. A producer that
+ * writes faster than the sample rate is held back by the full ring.
+ *
+ * Runs of samples shorter than a chunk are held briefly while the device
+ * still has samples queued, so a producer writing in small pieces does not
+ * turn into many small submits. When the producer finishes, the queue is
+ * flushed so the last samples play.
+ *
+ * The device can be shared with other vsg60 blocks, see iqin.
+ *
+ * The block has no stream ports. GRC attaches it to the flowgraph on its
+ * own; in Python use tb.connect(block), or a message connection, or it is
+ * not run. The "active" message port takes a bool, or a pair holding one
+ * as GUI widgets send, and calls set_active().
+ */
+class VSG60_API shm_ingest : virtual public gr::block
+{
+public:
+    typedef std::shared_ptr<shm_ingest> sptr;
+
+    static sptr make(const std::string &name = "/vsg60",
+                     int capacity = 1 << 22,
+                     double frequency = 1e9,
+                     double level = -10,
+                     double srate = 50e6,
+                     int serial = 0);
+
+    virtual void set_frequency(double frequency) = 0;
+    virtual void set_level(double level) = 0;
+    virtual void set_srate(double srate) = 0;
+
+    //! Priority among the blocks sharing the device, higher wins
+    virtual void set_device_priority(int priority) = 0;
+    //! Request the device while running, or release it to the next block
+    virtual void set_active(bool active) = 0;
+
+    /*!
+     * Ingest counters: submitted_samples, submits, underruns (times the
+     * device ran dry waiting for the producer), ring_fill and
+     * ring_capacity (samples).
+     */
+    virtual std::map<std::string, double> stats() = 0;
+};
+
+} // namespace vsg60
+} // namespace gr
+
+#endif /* INCLUDED_VSG60_SHM_INGEST_H */
@@ -0,0 +1,205 @@
+/* -*- c -*- */
+/*
+ * Copyright 2022 Signal Hound.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#ifndef INCLUDED_VSG60_SHM_RING_H
+#define INCLUDED_VSG60_SHM_RING_H
+
+/*
+ * Single producer, single consumer ring of interleaved 32-bit float I/Q in
+ * POSIX shared memory, read by the vsg60.shm_ingest block. Plain C, so
+ * producers need nothing from GNU Radio.
+ *
+ * The block creates the ring as /dev/shm/<name>. A producer opens it,
+ * writes samples into the span from vsg60_ring_write_span() and publishes
+ * them with vsg60_ring_commit(). The block submits published samples to the
+ * device straight from the mapping and then returns their space. Neither
+ * side locks: only the producer advances head and only the consumer
+ * advances tail, each with a release store after the data it covers.
+ *
+ * Positions count samples since the ring was created and never wrap. A
+ * position's index into the data is taken modulo the capacity, which is a
+ * power of two.
+ *
+ * See examples/shm_producer.c. Link with -lrt on glibc older than 2.34.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define VSG60_RING_MAGIC 0x52475356u /* "VSGR" */
+#define VSG60_RING_VERSION 1u
+/* Samples start on their own page */
+#define VSG60_RING_DATA_OFFSET 4096u
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t capacity; /* samples, a power of two */
+    uint8_t pad0[48];
+
+    /* Producer's cache line */
+    uint64_t head;
+    uint32_t closed; /* nonzero once the producer has finished */
+    uint8_t pad1[52];
+
+    /* Consumer's cache line */
+    uint64_t tail;
+    uint8_t pad2[56];
+} vsg60_ring_header;
+
+typedef struct {
+    vsg60_ring_header *header;
+    float *data; /* 2 * capacity floats */
+    size_t size; /* bytes mapped */
+} vsg60_ring;
+
+static inline int vsg60_ring_map(vsg60_ring *ring, int fd, size_t size)
+{
+    void *base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if(base == MAP_FAILED) return -1;
+
+    ring->header = (vsg60_ring_header *)base;
+    ring->data = (float *)((char *)base + VSG60_RING_DATA_OFFSET);
+    ring->size = size;
+    return 0;
+}
+
+/* Consumer: create the ring, replacing any left from an earlier run.
+ * Capacity is rounded up to a power of two. Returns 0, or -1 with errno set. */
+static inline int vsg60_ring_create(vsg60_ring *ring, const char *name, uint64_t capacity)
+{
+    uint64_t size = 1;
+    while(size < capacity) size <<= 1;
+
+    /* Producers still mapping a stale ring keep it, they cannot corrupt this one */
+    shm_unlink(name);
+    int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0666);
+    if(fd < 0) return -1;
+
+    size_t bytes = VSG60_RING_DATA_OFFSET + size * 2 * sizeof(float);
+    int failed = ftruncate(fd, (off_t)bytes) < 0 || vsg60_ring_map(ring, fd, bytes) < 0;
+    int err = errno;
+    close(fd);
+    if(failed) {
+        shm_unlink(name);
+        errno = err;
+        return -1;
+    }
+
+    memset(ring->header, 0, sizeof(vsg60_ring_header));
+    ring->header->capacity = size;
+    ring->header->version = VSG60_RING_VERSION;
+    __atomic_store_n(&ring->header->magic, VSG60_RING_MAGIC, __ATOMIC_RELEASE);
+    return 0;
+}
+
+/* Producer: open a ring created by the block. Returns 0, or -1 with errno
+ * set, EINVAL if it is not a ring of this version. */
+static inline int vsg60_ring_open(vsg60_ring *ring, const char *name)
+{
+    int fd = shm_open(name, O_RDWR, 0);
+    if(fd < 0) return -1;
+
+    struct stat st;
+    if(fstat(fd, &st) < 0 || (size_t)st.st_size < VSG60_RING_DATA_OFFSET) {
+        close(fd);
+        errno = EINVAL;
+        return -1;
+    }
+    int failed = vsg60_ring_map(ring, fd, (size_t)st.st_size) < 0;
+    int err = errno;
+    close(fd);
+    if(failed) {
+        errno = err;
+        return -1;
+    }
+
+    vsg60_ring_header *h = ring->header;
+    if(__atomic_load_n(&h->magic, __ATOMIC_ACQUIRE) != VSG60_RING_MAGIC ||
+       h->version != VSG60_RING_VERSION ||
+       VSG60_RING_DATA_OFFSET + h->capacity * 2 * sizeof(float) > ring->size) {
+        munmap(ring->header, ring->size);
+        errno = EINVAL;
+        return -1;
+    }
+
+    __atomic_store_n(&h->closed, 0, __ATOMIC_RELEASE);
+    return 0;
+}
+
+static inline void vsg60_ring_close(vsg60_ring *ring)
+{
+    if(ring->header) munmap(ring->header, ring->size);
+    ring->header = NULL;
+}
+
+/* Producer: contiguous free space at the head, in samples. *iq points at it. */
+static inline uint64_t vsg60_ring_write_span(const vsg60_ring *ring, float **iq)
+{
+    vsg60_ring_header *h = ring->header;
+    uint64_t head = h->head;
+    uint64_t space = h->capacity - (head - __atomic_load_n(&h->tail, __ATOMIC_ACQUIRE));
+    uint64_t index = head & (h->capacity - 1);
+    uint64_t to_end = h->capacity - index;
+
+    *iq = ring->data + 2 * index;
+    return space < to_end ? space : to_end;
+}
+
+/* Producer: publish len samples written into the span */
+static inline void vsg60_ring_commit(vsg60_ring *ring, uint64_t len)
+{
+    __atomic_store_n(&ring->header->head, ring->header->head + len, __ATOMIC_RELEASE);
+}
+
+/* Producer: copy in as many samples as fit, returns how many */
+static inline uint64_t vsg60_ring_write(vsg60_ring *ring, const float *iq, uint64_t len)
+{
+    uint64_t written = 0;
+    while(written < len) {
+        float *span;
+        uint64_t n = vsg60_ring_write_span(ring, &span);
+        if(n == 0) break;
+        if(n > len - written) n = len - written;
+        memcpy(span, iq + 2 * written, n * 2 * sizeof(float));
+        vsg60_ring_commit(ring, n);
+        written += n;
+    }
+    return written;
+}
+
+/* Producer: no more samples follow, the block lets the queue play out */
+static inline void vsg60_ring_finish(vsg60_ring *ring)
+{
+    __atomic_store_n(&ring->header->closed, 1, __ATOMIC_RELEASE);
+}
+
+/* Consumer: contiguous published samples at the tail. *iq points at them. */
+static inline uint64_t vsg60_ring_read_span(const vsg60_ring *ring, const float **iq)
+{
+    vsg60_ring_header *h = ring->header;
+    uint64_t tail = h->tail;
+    uint64_t used = __atomic_load_n(&h->head, __ATOMIC_ACQUIRE) - tail;
+    uint64_t index = tail & (h->capacity - 1);
+    uint64_t to_end = h->capacity - index;
+
+    *iq = ring->data + 2 * index;
+    return used < to_end ? used : to_end;
+}
+
+/* Consumer: return the space of len samples to the producer */
+static inline void vsg60_ring_release(vsg60_ring *ring, uint64_t len)
+{
+    __atomic_store_n(&ring->header->tail, ring->header->tail + len, __ATOMIC_RELEASE);
+}
+
+#endif /* INCLUDED_VSG60_SHM_RING_H */
@@ -0,0 +1,343 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2022 Signal Hound.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "arbiter.h"
+
+#include <algorithm>
+
+namespace gr {
+namespace vsg60 {
+
+// How often a lost device is tried again
+static const int RECONNECT_RETRY_MS = 250;
+
+// Arbiters by serial number, entries expire with the last block using them
+static gr::thread::mutex registry_mutex;
+static std::map<int, std::weak_ptr<arbiter>> registry;
+
+std::shared_ptr<arbiter> arbiter::get(gr::logger_ptr logger, int serial)
+{
+    gr::thread::scoped_lock lock(registry_mutex);
+
+    for(auto it = registry.begin(); it != registry.end();) {
+        std::shared_ptr<arbiter> existing = it->second.lock();
+        if(!existing) {
+            it = registry.erase(it);
+            continue;
+        }
+        // Serial 0 opens the next device not yet opened
+        if(serial != 0 && it->first == serial) return existing;
+        ++it;
+    }
+
+    std::shared_ptr<arbiter> opened = std::make_shared<arbiter>(logger, serial);
+    registry[opened->_device.serial()] = opened;
+    return opened;
+}
+
+arbiter::arbiter(gr::logger_ptr logger, int serial)
+    : _device(logger, serial),
+    _next_id(0),
+    _requests(0),
+    _owner(-1),
+    _draining(false),
+    _flushed(-1),
+    _switch_pending(false),
+    _handovers(0),
+    _preemptions(0),
+    _running(true),
+    _monitor_interval(0),
+    _monitor_threshold(0)
+{
+    _thread.reset(new gr::thread::thread([this]() { run(); }));
+}
+
+arbiter::~arbiter()
+{
+    {
+        // Its thread calls back into the arbiter
+        gr::thread::scoped_lock lock(_monitor_mutex);
+        _monitor.reset();
+    }
+    {
+        gr::thread::scoped_lock lock(_state_mutex);
+        _running = false;
+    }
+    _cond.notify_all();
+    _thread->join();
+}
+
+void
+arbiter::run() {
+    gr::thread::scoped_lock lock(_state_mutex);
+
+    while(_running) {
+        _cond.timed_wait(lock, boost::posix_time::milliseconds(RECONNECT_RETRY_MS));
+        if(!_running || !_device.lost()) continue;
+
+        // Off the clients' threads, a submit fails at once while lost
+        lock.unlock();
+        {
+            gr::thread::scoped_lock device_lock(_mutex);
+            _device.reconnect();
+        }
+        _device.flush_log();
+        lock.lock();
+    }
+}
+
+int
+arbiter::add_client(const std::string &name, int priority,
+                    const notify_fn &granted, const notify_fn &preempted) {
+    gr::thread::scoped_lock lock(_state_mutex);
+    _clients[_next_id] = {name, priority, false, 0, granted, preempted,
+                          0, 0, nullptr, nullptr, nullptr};
+    return _next_id++;
+}
+
+void
+arbiter::remove_client(int id) {
+    // Releasing first flushes what the client queued
+    request(id, false);
+
+    {
+        gr::thread::scoped_lock lock(_state_mutex);
+        _clients.erase(id);
+    }
+    configure_monitor();
+}
+
+void
+arbiter::set_priority(int id, int priority) {
+    update(id, [priority](client &c) { c.priority = priority; });
+}
+
+void
+arbiter::request(int id, bool wants) {
+    update(id, [this, wants](client &c) {
+        if(wants && !c.wants) c.requested = ++_requests;
+        c.wants = wants;
+    });
+}
+
+void
+arbiter::set_health_monitor(int id, double interval, double recal_threshold,
+                            const health_monitor::state_fn &quiet,
+                            const health_monitor::idle_fn &idle,
+                            const health_monitor::publish_fn &publish) {
+    {
+        gr::thread::scoped_lock lock(_state_mutex);
+        auto it = _clients.find(id);
+        if(it == _clients.end()) return;
+        client &c = it->second;
+        c.health_interval = std::max(interval, 0.0);
+        c.recal_threshold = recal_threshold;
+        c.quiet = quiet;
+        c.idle = idle;
+        c.publish = publish;
+    }
+    configure_monitor();
+}
+
+void
+arbiter::configure_monitor() {
+    gr::thread::scoped_lock monitor_lock(_monitor_mutex);
+
+    // The shortest interval and lowest threshold any client asks for
+    double interval = 0, threshold = 0;
+    {
+        gr::thread::scoped_lock lock(_state_mutex);
+        for(const auto &entry : _clients) {
+            const client &c = entry.second;
+            if(c.health_interval <= 0) continue;
+            if(interval <= 0 || c.health_interval < interval) interval = c.health_interval;
+            if(c.recal_threshold > 0 && (threshold <= 0 || c.recal_threshold < threshold)) {
+                threshold = c.recal_threshold;
+            }
+        }
+    }
+    if(interval == _monitor_interval && threshold == _monitor_threshold) return;
+
+    // The old monitor's thread takes _state_mutex, it is stopped without it
+    _monitor.reset();
+    _monitor_interval = interval;
+    _monitor_threshold = threshold;
+    if(interval <= 0) return;
+
+    _monitor.reset(new health_monitor(
+        _device, _mutex, interval, threshold,
+        [this]() { return monitor_quiet(); },
+        [this](double hold) { return monitor_idle(hold); },
+        [this](const std::map<std::string, double> &values) { monitor_publish(values); }));
+}
+
+bool
+arbiter::monitor_quiet() {
+    gr::thread::scoped_lock lock(_state_mutex);
+
+    // Only the owner knows whether its output tolerates a pause
+    auto it = _clients.find(_owner);
+    return it != _clients.end() && it->second.quiet && it->second.quiet();
+}
+
+bool
+arbiter::monitor_idle(double hold) {
+    gr::thread::scoped_lock lock(_state_mutex);
+    auto it = _clients.find(_owner);
+    return it != _clients.end() && it->second.idle && it->second.idle(hold);
+}
+
+void
+arbiter::monitor_publish(const std::map<std::string, double> &values) {
+    // Under the lock, a removed client is never called
+    gr::thread::scoped_lock lock(_state_mutex);
+    for(const auto &entry : _clients) {
+        const client &c = entry.second;
+        if(c.health_interval > 0 && c.publish) c.publish(values);
+    }
+}
+
+std::map<std::string, double>
+arbiter::health() {
+    gr::thread::scoped_lock lock(_monitor_mutex);
+    if(!_monitor) return std::map<std::string, double>();
+    return _monitor->values();
+}
+
+bool
+arbiter::active_message(const pmt::pmt_t &msg, bool &wants) {
+    pmt::pmt_t value = pmt::is_pair(msg) ? pmt::cdr(msg) : msg;
+    if(pmt::is_bool(value)) {
+        wants = pmt::to_bool(value);
+    } else if(pmt::is_integer(value) || pmt::is_real(value)) {
+        wants = pmt::to_double(value) != 0;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+void
+arbiter::update(int id, const std::function<void(client &)> &change) {
+    {
+        gr::thread::scoped_lock lock(_state_mutex);
+        auto it = _clients.find(id);
+        if(it == _clients.end()) return;
+        change(it->second);
+        // The client draining its queue arbitrates again once it is done
+        if(_draining) return;
+    }
+
+    notify_fn granted, preempted;
+    {
+        gr::thread::scoped_lock device_lock(_mutex);
+        gr::thread::scoped_lock lock(_state_mutex);
+        while(!_draining && arbitrate(granted, preempted)) {
+            // Only the device is held while the queue plays, other clients
+            // keep changing their requests
+            _draining = true;
+            lock.unlock();
+            VSG_CALL(_device, vsgFlushAndWait);
+            lock.lock();
+            _draining = false;
+        }
+    }
+    _device.flush_log();
+
+    // Outside the lock, clients take it again to output
+    if(preempted) preempted();
+    if(granted) granted();
+}
+
+bool
+arbiter::arbitrate(notify_fn &granted, notify_fn &preempted) {
+    int next = -1;
+    for(const auto &entry : _clients) {
+        const client &c = entry.second;
+        if(!c.wants) continue;
+        if(next < 0) {
+            next = entry.first;
+            continue;
+        }
+        const client &best = _clients[next];
+        if(c.priority > best.priority ||
+           (c.priority == best.priority && c.requested > best.requested)) {
+            next = entry.first;
+        }
+    }
+
+    const int previous = _owner;
+    if(next == previous) return false;
+
+    if(previous >= 0) {
+        const client &old = _clients[previous];
+        if(old.wants) {
+            // Outranked, its output stops now
+            VSG_CALL(_device, vsgAbort);
+            preempted = old.preempted;
+            _preemptions++;
+        } else if(next >= 0) {
+            // Released, the caller lets what it queued play out with no
+            // owner. A repeating waveform has no end to wait for.
+            VsgBool repeating = vsgFalse;
+            VSG_CALL(_device, vsgIsWaveformActive, &repeating);
+            if(!repeating) {
+                _owner = -1;
+                _flushed = previous;
+                return true;
+            }
+            VSG_CALL(_device, vsgAbort);
+        }
+    }
+
+    // After a drain the old owner may have asked for the device back
+    const int old = previous >= 0 ? previous : _flushed;
+    const bool handover = old >= 0 && next >= 0 && next != old;
+    _flushed = -1;
+    if(handover) _handovers++;
+
+    // The old owner may have left RF off, e.g. while gating
+    if(next >= 0 && !_device.rf_output()) _device.set_rf_output(true);
+
+    _owner = next;
+    _switch_pending = handover;
+    _switch_start = std::chrono::steady_clock::now();
+    if(next >= 0) granted = _clients[next].granted;
+    return false;
+}
+
+void
+arbiter::output_started(int id) {
+    gr::thread::scoped_lock lock(_state_mutex);
+    if(!_switch_pending || id != _owner) return;
+
+    _gap_stats.add(std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - _switch_start).count());
+    _switch_pending = false;
+}
+
+std::map<std::string, double>
+arbiter::stats() {
+    gr::thread::scoped_lock lock(_state_mutex);
+    return {
+        {"handovers", (double)_handovers},
+        {"preemptions", (double)_preemptions},
+        {"gap_count", (double)_gap_stats.count()},
+        {"gap_mean", _gap_stats.mean()},
+        {"gap_max", _gap_stats.max()}
+    };
+}
+
+std::string
+arbiter::owner() {
+    gr::thread::scoped_lock lock(_state_mutex);
+    auto it = _clients.find(_owner);
+    return it == _clients.end() ? std::string() : it->second.name;
+}
+
+} /* namespace vsg60 */
+} /* namespace gr */
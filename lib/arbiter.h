@@ -0,0 +1,166 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2022 Signal Hound.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#ifndef INCLUDED_VSG60_ARBITER_H
+#define INCLUDED_VSG60_ARBITER_H
+
+#include "device.h"
+#include "health_monitor.h"
+#include "running_stats.h"
+#include <gnuradio/logger.h>
+#include <gnuradio/thread/thread.h>
+#include <pmt/pmt.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+
+namespace gr {
+namespace vsg60 {
+
+/*!
+ * \brief Shares one VSG60 between the blocks of a process.
+ *
+ * Blocks asking for the same serial number get the same arbiter, which owns
+ * the device and the mutex serializing API calls on it. Serial 0 opens the
+ * next device not yet opened, sharing needs the serial number.
+ *
+ * Blocks register as clients with a priority and request the device when
+ * they want to output. It belongs to the highest priority client wanting it,
+ * the latest request winning a tie. An owner that releases the device hands
+ * it over with a flush, so what it queued still plays. The flush runs on the
+ * releasing client's thread with only the device mutex held, and no client
+ * owns the device until it returns. An owner outranked
+ * while still wanting it is preempted and its output aborted. Clients check
+ * owns() before each output call and apply their own settings whenever they
+ * gain the device.
+ *
+ * The switchover gap runs from the end of the old owner's output, once the
+ * flush or abort returns, to the new owner's first output call.
+ *
+ * A device lost from USB is reopened from the arbiter's own thread, with
+ * the device mutex held for each attempt, so whichever block was streaming
+ * carries on once it is back.
+ *
+ * The device has one health monitor however many clients enable it, at the
+ * shortest interval and lowest recalibration threshold any of them asks
+ * for. It samples only when the owner's callbacks allow and publishes to
+ * every client that enabled it.
+ */
+class arbiter
+{
+public:
+    // Called with no lock held, after the device changed hands
+    typedef std::function<void()> notify_fn;
+
+private:
+      struct client {
+          std::string name;
+          int priority;
+          bool wants;
+          // Order of the latest request, breaks ties in priority
+          uint64_t requested;
+          notify_fn granted;
+          notify_fn preempted;
+          // Health monitoring asked for, interval 0 when not
+          double health_interval;
+          double recal_threshold;
+          health_monitor::state_fn quiet;
+          health_monitor::idle_fn idle;
+          health_monitor::publish_fn publish;
+      };
+
+      device _device;
+      gr::thread::mutex _mutex;
+      // Clients and ownership, taken after _mutex when both are needed
+      gr::thread::mutex _state_mutex;
+
+      std::map<int, client> _clients;
+      int _next_id;
+      uint64_t _requests;
+      std::atomic<int> _owner;
+      // A released owner's queue is playing out, and whose
+      bool _draining;
+      int _flushed;
+
+      // Handover waiting for the new owner's first output
+      bool _switch_pending;
+      std::chrono::steady_clock::time_point _switch_start;
+      uint64_t _handovers;
+      uint64_t _preemptions;
+      running_stats _gap_stats;
+
+      // Reopens the device while it is lost
+      std::unique_ptr<gr::thread::thread> _thread;
+      gr::thread::condition_variable _cond;
+      bool _running;
+
+      // Replaced as clients change their settings, taken before the others
+      gr::thread::mutex _monitor_mutex;
+      std::unique_ptr<health_monitor> _monitor;
+      double _monitor_interval;
+      double _monitor_threshold;
+
+      // True when the owner released the device and its queue must play
+      // out before the next owner is chosen
+      bool arbitrate(notify_fn &granted, notify_fn &preempted);
+      void update(int id, const std::function<void(client &)> &change);
+      void run();
+      void configure_monitor();
+      // The health monitor's callbacks, passed on to the owner
+      bool monitor_quiet();
+      bool monitor_idle(double hold);
+      void monitor_publish(const std::map<std::string, double> &values);
+
+public:
+    arbiter(gr::logger_ptr logger, int serial);
+    ~arbiter();
+
+      // The arbiter for a serial number, opening the device if no block has
+      static std::shared_ptr<arbiter> get(gr::logger_ptr logger, int serial = 0);
+
+      device &dev() { return _device; }
+      // Held around every API call on the device
+      gr::thread::mutex &mutex() { return _mutex; }
+
+      int add_client(const std::string &name, int priority,
+                     const notify_fn &granted = notify_fn(),
+                     const notify_fn &preempted = notify_fn());
+      void remove_client(int id);
+      void set_priority(int id, int priority);
+      void request(int id, bool wants);
+      // Reads a request from an active port message, a bool, a number or a
+      // pair holding one as GUI widgets send. False if it is none of these.
+      static bool active_message(const pmt::pmt_t &msg, bool &wants);
+
+      // Lock free, cheap enough to check before every submit
+      bool owns(int id) const { return _owner == id; }
+      // Call with the mutex held after each output call
+      void output_started(int id);
+
+      // Interval 0 stops monitoring for the client. The state callbacks are
+      // called with the device mutex held while the client owns the device.
+      void set_health_monitor(int id, double interval, double recal_threshold,
+                              const health_monitor::state_fn &quiet,
+                              const health_monitor::idle_fn &idle,
+                              const health_monitor::publish_fn &publish);
+      // Last health sample, empty while no client monitors
+      std::map<std::string, double> health();
+
+      // handovers, preemptions, gap_count, gap_mean, gap_max (seconds)
+      std::map<std::string, double> stats();
+      std::string owner();
+};
+
+} // namespace vsg60
+} // namespace gr
+
+#endif /* INCLUDED_VSG60_ARBITER_H */
@@ -0,0 +1,298 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2022 Signal Hound.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "audit_recorder.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <stdexcept>
+
+namespace gr {
+namespace vsg60 {
+
+// Samples per block, 1 MiB, a multiple of any O_DIRECT alignment
+static const int BLOCK_SAMPLES = 131072;
+static const size_t BLOCK_ALIGN = 4096;
+
+static const char *DATA_SUFFIX = ".sigmf-data";
+static const char *META_SUFFIX = ".sigmf-meta";
+
+static double wall_time()
+{
+    return std::chrono::duration<double>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+// SigMF datetime, ISO 8601 UTC with microseconds
+static std::string iso8601(double seconds)
+{
+    time_t whole = (time_t)seconds;
+    tm utc;
+    gmtime_r(&whole, &utc);
+
+    char date[32], text[48];
+    strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", &utc);
+    snprintf(text, sizeof(text), "%s.%06dZ", date, (int)((seconds - whole) * 1e6));
+    return text;
+}
+
+audit_recorder::audit_recorder(const std::string &base, int queue_blocks)
+    : _base(base),
+    _fd(-1),
+    _offered(0),
+    _recorded(0),
+    _new_capture(true),
+    _frequency(0),
+    _level(0),
+    _hardware_level(0),
+    _sample_rate(0),
+    _meta_rate(0),
+    _captures_changed(false),
+    _dropped_samples(0),
+    _dropped_blocks(0),
+    _write_errors(0),
+    _written(0),
+    _running(true)
+{
+    // Accept the data file name as well as the base
+    const size_t suffix = strlen(DATA_SUFFIX);
+    if(_base.size() > suffix && _base.compare(_base.size() - suffix, suffix, DATA_SUFFIX) == 0) {
+        _base.resize(_base.size() - suffix);
+    }
+
+    const std::string path = _base + DATA_SUFFIX;
+    _fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_DIRECT, 0644);
+    if(_fd < 0 && errno == EINVAL) {
+        // Some filesystems, tmpfs for one, do not support O_DIRECT
+        _fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    }
+    if(_fd < 0) {
+        throw std::runtime_error("vsg60: unable to open audit recording " + path);
+    }
+
+    // One block being filled, the rest free or queued for writing
+    for(int i = 0; i < std::max(queue_blocks, 1) + 1; i++) {
+        void *memory;
+        if(posix_memalign(&memory, BLOCK_ALIGN, BLOCK_SAMPLES * sizeof(gr_complex))) {
+            for(gr_complex *allocated : _memory) free(allocated);
+            close(_fd);
+            throw std::bad_alloc();
+        }
+        _memory.push_back((gr_complex *)memory);
+        _free.push_back({(gr_complex *)memory, 0});
+    }
+    _fill = _free.back();
+    _free.pop_back();
+
+    write_meta(_captures, _meta_rate);
+    _thread.reset(new gr::thread::thread([this]() { run(); }));
+}
+
+audit_recorder::~audit_recorder()
+{
+    {
+        gr::thread::scoped_lock lock(_mutex);
+        _running = false;
+    }
+    _cond.notify_all();
+    _thread->join();
+
+    // The last, partial block cannot be written with O_DIRECT
+    if(_fill.len) {
+        fcntl(_fd, F_SETFL, fcntl(_fd, F_GETFL) & ~O_DIRECT);
+        if(write_block(_fill)) {
+            _written += _fill.len;
+        } else {
+            _write_errors++;
+        }
+    }
+    close(_fd);
+    write_meta(_captures, _meta_rate);
+
+    for(gr_complex *memory : _memory) free(memory);
+}
+
+void
+audit_recorder::set_settings(double frequency, double level, double hardware_level, double sample_rate) {
+    if(frequency == _frequency && level == _level && hardware_level == _hardware_level &&
+       sample_rate == _sample_rate) return;
+    _frequency = frequency;
+    _level = level;
+    _hardware_level = hardware_level;
+    _sample_rate = sample_rate;
+    _new_capture = true;
+}
+
+void
+audit_recorder::record(const gr_complex *iq, int len, bool contiguous) {
+    if(!contiguous) _new_capture = true;
+
+    while(len > 0) {
+        if(_new_capture) {
+            gr::thread::scoped_lock lock(_mutex);
+            _captures.push_back({_recorded, _offered, wall_time(),
+                                 _frequency, _level, _hardware_level, _sample_rate});
+            _meta_rate = _sample_rate;
+            _captures_changed = true;
+            _new_capture = false;
+        }
+
+        int n = std::min(len, BLOCK_SAMPLES - _fill.len);
+        memcpy(_fill.data + _fill.len, iq, n * sizeof(gr_complex));
+        _fill.len += n;
+        _offered += n;
+        _recorded += n;
+        iq += n;
+        len -= n;
+
+        if(_fill.len == BLOCK_SAMPLES) hand_off();
+    }
+}
+
+void
+audit_recorder::hand_off() {
+    {
+        gr::thread::scoped_lock lock(_mutex);
+
+        if(!_free.empty()) {
+            _full.push_back(_fill);
+            _fill = _free.back();
+            _free.pop_back();
+        } else {
+            // Writer is behind, drop this block rather than wait for it
+            _recorded -= _fill.len;
+            _dropped_samples += _fill.len;
+            _dropped_blocks++;
+
+            // Captures that started in the dropped block no longer exist
+            while(!_captures.empty() && _captures.back().sample_start >= _recorded) {
+                _captures.pop_back();
+                _captures_changed = true;
+            }
+            _new_capture = true;
+        }
+        _fill.len = 0;
+    }
+    _cond.notify_one();
+}
+
+bool
+audit_recorder::write_block(const block &blk) {
+    const char *data = (const char *)blk.data;
+    size_t remaining = blk.len * sizeof(gr_complex);
+
+    while(remaining > 0) {
+        ssize_t n = write(_fd, data, remaining);
+        if(n <= 0) {
+            if(n < 0 && errno == EINTR) continue;
+            return false;
+        }
+        data += n;
+        remaining -= n;
+    }
+    return true;
+}
+
+void
+audit_recorder::write_meta(const std::vector<capture> &captures, double sample_rate) {
+    // The recording's rate is that of its first capture
+    if(!captures.empty()) sample_rate = captures.front().sample_rate;
+
+    std::ofstream meta(_base + META_SUFFIX, std::ios::trunc);
+    meta.precision(15);
+    meta << "{\n"
+         << "  \"global\": {\n"
+         << "    \"core:datatype\": \"cf32_le\",\n"
+         << "    \"core:sample_rate\": " << sample_rate << ",\n"
+         << "    \"core:version\": \"1.0.0\",\n"
+         << "    \"core:hw\": \"Signal Hound VSG60\",\n"
+         << "    \"core:recorder\": \"gr-vsg60\",\n"
+         << "    \"core:description\": \"Transmit audit recording\",\n"
+         << "    \"core:extensions\": [\n"
+         << "      {\"name\": \"vsg60\", \"version\": \"1.0.0\", \"optional\": true}\n"
+         << "    ]\n"
+         << "  },\n"
+         << "  \"captures\": [";
+
+    for(size_t i = 0; i < captures.size(); i++) {
+        const capture &cap = captures[i];
+        meta << (i ? "," : "") << "\n    {"
+             << "\"core:sample_start\": " << cap.sample_start
+             << ", \"core:global_index\": " << cap.global_index
+             << ", \"core:datetime\": \"" << iso8601(cap.datetime) << "\""
+             << ", \"core:frequency\": " << cap.frequency
+             << ", \"vsg60:level\": " << cap.level
+             << ", \"vsg60:hardware_level\": " << cap.hardware_level
+             << ", \"vsg60:sample_rate\": " << cap.sample_rate << "}";
+    }
+
+    meta << "\n  ],\n"
+         << "  \"annotations\": []\n"
+         << "}\n";
+}
+
+void
+audit_recorder::run() {
+    gr::thread::scoped_lock lock(_mutex);
+
+    while(true) {
+        while(_running && _full.empty() && !_captures_changed) _cond.wait(lock);
+        if(!_running && _full.empty()) break;
+
+        if(!_full.empty()) {
+            block blk = _full.front();
+            _full.pop_front();
+
+            lock.unlock();
+            bool ok = write_block(blk);
+            lock.lock();
+
+            if(ok) {
+                _written += blk.len;
+            } else {
+                _write_errors++;
+            }
+            blk.len = 0;
+            _free.push_back(blk);
+        }
+
+        // Keep the metadata current in case the process does not exit cleanly
+        if(_captures_changed && _full.empty()) {
+            std::vector<capture> captures = _captures;
+            double sample_rate = _meta_rate;
+            _captures_changed = false;
+
+            lock.unlock();
+            write_meta(captures, sample_rate);
+            lock.lock();
+        }
+    }
+}
+
+std::map<std::string, double>
+audit_recorder::stats() {
+    gr::thread::scoped_lock lock(_mutex);
+    return {
+        {"recorded_samples", (double)_written},
+        {"dropped_samples", (double)_dropped_samples},
+        {"dropped_blocks", (double)_dropped_blocks},
+        {"write_errors", (double)_write_errors},
+        {"captures", (double)_captures.size()}
+    };
+}
+
+} /* namespace vsg60 */
+} /* namespace gr */
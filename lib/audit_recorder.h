@@ -0,0 +1,113 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2022 Signal Hound.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#ifndef INCLUDED_VSG60_AUDIT_RECORDER_H
+#define INCLUDED_VSG60_AUDIT_RECORDER_H
+
+#include <gnuradio/gr_complex.h>
+#include <gnuradio/thread/thread.h>
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace gr {
+namespace vsg60 {
+
+/*!
+ * \brief Records transmitted samples to a SigMF recording on a background thread.
+ *
+ * Samples are copied into fixed, page aligned blocks that a writer thread
+ * writes to base.sigmf-data with O_DIRECT, bypassing the page cache. The
+ * number of blocks is bounded. When none is free a full block is dropped
+ * and counted, so record() never waits on the disk.
+ *
+ * A new SigMF capture starts whenever the frequency, level, hardware level
+ * or sample rate changes, after a dropped block, and after a break in transmission. Each
+ * capture holds the sample's global index in the transmitted stream and
+ * its host time. base.sigmf-meta is rewritten as captures are added and
+ * when the recording is closed.
+ *
+ * record() and set_settings() must be called from a single thread.
+ */
+class audit_recorder
+{
+private:
+      struct capture {
+          uint64_t sample_start;
+          uint64_t global_index;
+          double datetime;
+          double frequency;
+          double level;
+          double hardware_level;
+          double sample_rate;
+      };
+
+      struct block {
+          gr_complex *data;
+          int len;
+      };
+
+      std::string _base;
+      int _fd;
+
+      // Producer state
+      block _fill;
+      uint64_t _offered;
+      uint64_t _recorded;
+      bool _new_capture;
+      double _frequency;
+      double _level;
+      double _hardware_level;
+      double _sample_rate;
+
+      // Shared with the writer
+      gr::thread::mutex _mutex;
+      gr::thread::condition_variable _cond;
+      std::vector<block> _free;
+      std::deque<block> _full;
+      std::vector<capture> _captures;
+      // Rate of the latest capture, for the global metadata
+      double _meta_rate;
+      bool _captures_changed;
+      uint64_t _dropped_samples;
+      uint64_t _dropped_blocks;
+      uint64_t _write_errors;
+      uint64_t _written;
+
+      std::vector<gr_complex *> _memory;
+      std::unique_ptr<gr::thread::thread> _thread;
+      bool _running;
+
+      void hand_off();
+      bool write_block(const block &blk);
+      void write_meta(const std::vector<capture> &captures, double sample_rate);
+      void run();
+
+public:
+    // Records to base.sigmf-data and base.sigmf-meta using queue_blocks blocks
+    audit_recorder(const std::string &base, int queue_blocks);
+    ~audit_recorder();
+
+      // Settings in effect for the following samples. level is the output
+      // level, the samples are relative to full scale at hardware_level.
+      void set_settings(double frequency, double level, double hardware_level, double sample_rate);
+      // Record transmitted samples, contiguous is false after a break
+      void record(const gr_complex *iq, int len, bool contiguous);
+
+      // recorded_samples, dropped_samples, dropped_blocks, write_errors, captures
+      std::map<std::string, double> stats();
+};
+
+} // namespace vsg60
+} // namespace gr
+
+#endif /* INCLUDED_VSG60_AUDIT_RECORDER_H */
@@ -0,0 +1,212 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2022 Signal Hound.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+/*
+ * Simulates several devices streaming through one USB controller, first
+ * submitting freely, then through the bus governor. The controller is a
+ * stub: each device queues a limited amount and a submit blocks for room,
+ * as vsgSubmitIQ does, and transfers in flight together share the bus
+ * capacity, lose some of it to contention and now and then stall. Producers
+ * submit back to back, as iqin does with its input always available. No
+ * device is needed.
+ *
+ * Usage: bench_bus [devices] [rate MS/s] [capacity MB/s] [wall seconds]
+ *
+ * A comma separated list of rates gives each device its own.
+ */
+
+#include "bus_governor.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+using namespace gr::vsg60;
+typedef std::chrono::steady_clock clock_type;
+
+// Samples a producer hands over per call, and the queue the stub API holds
+static const int SUBMIT = 65536;
+static const double API_QUEUE = 0.1;
+// Rates and capacity run this much slower in wall time, so sleep and wakeup
+// latency stay small next to a transfer. Results are scaled back.
+static const double SLOWDOWN = 20;
+// Capacity lost per extra transfer in flight, and chance of a stall
+static const double CONTENTION = 0.15;
+static const double STALL_CHANCE = 0.05;
+static const double STALL = 0.004;
+
+static clock_type::duration period(int n, double srate)
+{
+    return std::chrono::duration_cast<clock_type::duration>(std::chrono::duration<double>(n / srate));
+}
+
+// Stub controller and devices
+class controller
+{
+private:
+      struct queue {
+          double srate;
+          clock_type::time_point end;
+          bool started;
+          uint64_t samples;
+          uint64_t underruns;
+      };
+
+      gr::thread::mutex _mutex;
+      double _capacity;
+      int _active;
+      std::mt19937 _rng;
+      std::vector<queue> _queues;
+
+public:
+    controller(double capacity, const std::vector<double> &rates)
+        : _capacity(capacity), _active(0), _rng(1)
+    {
+        for(double srate : rates) _queues.push_back({srate, clock_type::now(), false, 0, 0});
+    }
+
+      // vsgSubmitIQ, blocks for queue room, then for the transfer
+      void submit(int dev, int samples) {
+          double seconds;
+          clock_type::time_point room;
+          {
+              gr::thread::scoped_lock lock(_mutex);
+              queue &q = _queues[dev];
+              room = q.end + period(samples, q.srate) - period((int)(API_QUEUE * q.srate), q.srate);
+          }
+          std::this_thread::sleep_until(room);
+
+          {
+              gr::thread::scoped_lock lock(_mutex);
+              int k = ++_active;
+              double share = _capacity * std::max(0.1, 1 - CONTENTION * (k - 1)) / k;
+              seconds = samples * bus_governor::BYTES_PER_SAMPLE / share;
+              if(k > 1 && std::uniform_real_distribution<double>()(_rng) < STALL_CHANCE) seconds += STALL;
+          }
+          std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+
+          gr::thread::scoped_lock lock(_mutex);
+          _active--;
+          queue &q = _queues[dev];
+          clock_type::time_point now = clock_type::now();
+          // The device ran dry before these samples landed
+          if(q.started && now > q.end) q.underruns++;
+          q.end = std::max(q.end, now) + period(samples, q.srate);
+          q.started = true;
+          q.samples += samples;
+      }
+
+      uint64_t samples(int dev) { return _queues[dev].samples; }
+      uint64_t underruns(int dev) { return _queues[dev].underruns; }
+};
+
+// Same steps as device::submit
+static void submit(controller &usb, bus_governor *bus, int dev, int id, double srate,
+                   int len, clock_type::time_point deadline)
+{
+    const int chunk = bus ? bus->chunk(id) : len;
+    for(int pos = 0; pos < len; pos += chunk) {
+        const int n = std::min(chunk, len - pos);
+        deadline = std::max(deadline, clock_type::now());
+        if(bus) bus->acquire(id, deadline, period(n, srate));
+        usb.submit(dev, n);
+        if(bus) bus->release(id, n);
+        deadline += period(n, srate);
+    }
+}
+
+static void stream(controller &usb, bus_governor *bus, int dev, int id, double srate,
+                   double seconds)
+{
+    const clock_type::time_point stop = clock_type::now() +
+        std::chrono::duration_cast<clock_type::duration>(std::chrono::duration<double>(seconds));
+
+    // Host estimate of the queue end, as iqin keeps it
+    clock_type::time_point queue_end = clock_type::now();
+    while(clock_type::now() < stop) {
+        clock_type::time_point start = clock_type::now();
+        submit(usb, bus, dev, id, srate, SUBMIT, queue_end);
+        queue_end = std::max(queue_end, start) + period(SUBMIT, srate);
+    }
+}
+
+static void run(const char *name, const std::vector<double> &rates, double capacity,
+                double seconds, bool governed)
+{
+    std::vector<double> slow;
+    for(double srate : rates) slow.push_back(srate / SLOWDOWN);
+
+    controller usb(capacity / SLOWDOWN, slow);
+    bus_governor bus;
+    bus.set_capacity(capacity / SLOWDOWN, false);
+
+    std::vector<int> ids;
+    std::string warning;
+    for(size_t i = 0; i < rates.size(); i++) {
+        ids.push_back(bus.add_device("device " + std::to_string(i)));
+        bus.set_rate(ids.back(), slow[i], warning);
+    }
+
+    std::vector<std::thread> threads;
+    for(size_t i = 0; i < rates.size(); i++) {
+        threads.emplace_back(stream, std::ref(usb), governed ? &bus : nullptr, (int)i, ids[i],
+                             slow[i], seconds);
+    }
+    for(std::thread &t : threads) t.join();
+
+    printf("%s\n", name);
+    printf("device     rate     MS/s  underruns\n");
+    for(size_t i = 0; i < rates.size(); i++) {
+        printf("%6zu %8.1f %8.1f %10llu\n", i, rates[i] / 1e6,
+               usb.samples(i) * SLOWDOWN / seconds / 1e6,
+               (unsigned long long)usb.underruns(i));
+    }
+    if(governed) {
+        std::map<std::string, double> stats = bus.stats();
+        printf("grants %.0f, waits %.0f, late %.0f, wait mean %.3f ms, max %.3f ms (wall), "
+               "measured %.1f MB/s\n",
+               stats["grants"], stats["waits"], stats["late"], stats["wait_mean"] * 1e3,
+               stats["wait_max"] * 1e3, stats["measured_capacity"] * SLOWDOWN / 1e6);
+    }
+    printf("\n");
+}
+
+int main(int argc, char **argv)
+{
+    int devices = argc > 1 ? atoi(argv[1]) : 3;
+    std::vector<double> rates;
+    std::istringstream list(argc > 2 ? argv[2] : "25");
+    for(std::string rate; std::getline(list, rate, ',');) rates.push_back(atof(rate.c_str()) * 1e6);
+    while((int)rates.size() < devices) rates.push_back(rates.back());
+    rates.resize(devices);
+    double capacity = (argc > 3 ? atof(argv[3]) : 360) * 1e6;
+    double seconds = argc > 4 ? atof(argv[4]) : 4;
+
+    printf("%d devices, capacity %.1f MB/s\n\n", devices, capacity / 1e6);
+
+    // Admission, each rate checked against those already set
+    {
+        bus_governor bus;
+        bus.set_capacity(capacity, true);
+        for(int i = 0; i < devices; i++) {
+            std::string warning;
+            bool allowed = bus.set_rate(bus.add_device("device " + std::to_string(i)), rates[i], warning);
+            printf("device %d: %s\n", i, warning.empty() ? "ok" : warning.c_str());
+            if(!allowed) break;
+        }
+        printf("\n");
+    }
+
+    run("ungoverned", rates, capacity, seconds, false);
+    run("governed", rates, capacity, seconds, true);
+    return 0;
+}
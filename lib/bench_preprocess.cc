@@ -0,0 +1,85 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2022 Signal Hound.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+/*
+ * Measures preprocessing throughput of the iqin staging path with 1 to N
+ * worker threads. No device is needed.
+ *
+ * Usage: bench_preprocess [max_threads] [taps] [chunk]
+ */
+
+#include "iq_correction.h"
+#include "worker_pool.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <random>
+
+using namespace gr::vsg60;
+
+// Same range size iqin_impl hands to its workers
+static const int PARALLEL_CHUNK = 16384;
+static const int TOTAL_SAMPLES = 1 << 24;
+
+int main(int argc, char **argv)
+{
+    int max_threads = argc > 1 ? atoi(argv[1]) : (int)gr::thread::thread::hardware_concurrency();
+    int ntaps = argc > 2 ? atoi(argv[2]) : 64;
+    int chunk = argc > 3 ? atoi(argv[3]) : 131072;
+
+    // Two point table with random taps, so interpolation and the FFT filter run
+    std::mt19937 rng(1);
+    std::normal_distribution<float> norm(0.0f, 0.1f);
+    const char *cal_file = "bench_preprocess_cal.txt";
+    {
+        std::ofstream cal(cal_file);
+        for(double freq : {1e9, 2e9}) {
+            cal << freq << " 0.2 1.5";
+            for(int i = 0; i < ntaps; i++) cal << " " << norm(rng) << " " << norm(rng);
+            cal << "\n";
+        }
+    }
+
+    std::vector<gr_complex> in(ntaps + chunk);
+    std::vector<gr_complex> out(chunk);
+    for(gr_complex &s : in) s = gr_complex(norm(rng), norm(rng));
+
+    printf("taps %d, chunk %d samples\n", ntaps, chunk);
+    printf("threads     MS/s  speedup\n");
+
+    double base = 0;
+    for(int threads = 1; threads <= max_threads; threads++) {
+        iq_correction correction(cal_file, threads);
+        correction.set_frequency(1.5e9);
+        std::unique_ptr<worker_pool> pool;
+        if(threads > 1) pool.reset(new worker_pool(threads));
+
+        const gr_complex *src = in.data() + correction.history() - 1;
+        auto t0 = std::chrono::steady_clock::now();
+        for(int done = 0; done < TOTAL_SAMPLES; done += chunk) {
+            if(pool) {
+                pool->run_ordered(chunk, PARALLEL_CHUNK,
+                    [&](int start, int len, int worker) {
+                        correction.process(src + start, out.data() + start, len, worker);
+                    },
+                    [](int, int) {});
+            } else {
+                correction.process(src, out.data(), chunk);
+            }
+        }
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - t0;
+
+        double msps = TOTAL_SAMPLES / elapsed.count() / 1e6;
+        if(threads == 1) base = msps;
+        printf("%7d %8.1f %8.2f\n", threads, msps, msps / base);
+    }
+
+    std::remove(cal_file);
+    return 0;
+}
@@ -0,0 +1,267 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2022 Signal Hound.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "bus_governor.h"
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstdlib>
+#include <sstream>
+#include <thread>
+
+namespace gr {
+namespace vsg60 {
+
+// Sustained bulk throughput of a typical USB 3.0 host controller, bytes per
+// second. VSG60_USB_CAPACITY overrides it, e.g. with a bench_bus result.
+static const double DEFAULT_CAPACITY = 360e6;
+
+// Largest submit per turn while the bus is shared
+static const int SHARED_CHUNK = 16384;
+static const int MIN_CHUNK = 256;
+
+// Queue kept ahead while shared, the API is assumed to take this much
+// without blocking, so a turn only covers the transfer
+static const std::chrono::milliseconds QUEUE_AHEAD(50);
+
+// A device this close to running dry goes ahead of the round robin
+static const std::chrono::milliseconds URGENT(2);
+
+// A device submitting within this window counts as streaming
+static const std::chrono::seconds STREAMING_WINDOW(1);
+
+// Saturated time needed before the measured capacity is trusted
+static const double MIN_MEASURED = 0.5;
+
+bus_governor &
+bus_governor::get() {
+    static bus_governor governor;
+    return governor;
+}
+
+bus_governor::bus_governor()
+    : _next_id(0),
+    _holder(-1),
+    _last(-1),
+    _capacity(DEFAULT_CAPACITY),
+    _refuse(false),
+    _grants(0),
+    _waits(0),
+    _late(0),
+    _saturated_bytes(0),
+    _saturated_time(0)
+{
+    const char *capacity = getenv("VSG60_USB_CAPACITY");
+    if(capacity && atof(capacity) > 0) _capacity = atof(capacity);
+}
+
+bus_governor::~bus_governor()
+{
+}
+
+int
+bus_governor::add_device(const std::string &name) {
+    gr::thread::scoped_lock lock(_mutex);
+    int id = _next_id++;
+    _devices[id] = {name, NAN, false, clock::time_point(), clock::time_point()};
+    return id;
+}
+
+void
+bus_governor::remove_device(int id) {
+    gr::thread::scoped_lock lock(_mutex);
+    _devices.erase(id);
+    if(_holder == id) _holder = -1;
+    _cond.notify_all();
+}
+
+double
+bus_governor::demand(int id, double srate) {
+    double total = 0;
+    for(const auto &d : _devices) {
+        // Configured rates count, the devices tend to start together
+        double rate = d.first == id ? srate : d.second.srate;
+        if(!std::isnan(rate)) total += rate * BYTES_PER_SAMPLE;
+    }
+    return total;
+}
+
+double
+bus_governor::capacity() {
+    if(_saturated_time < MIN_MEASURED) return _capacity;
+    return std::min(_capacity, _saturated_bytes / _saturated_time);
+}
+
+bool
+bus_governor::set_rate(int id, double srate, std::string &warning) {
+    gr::thread::scoped_lock lock(_mutex);
+    auto it = _devices.find(id);
+    if(it == _devices.end()) return true;
+
+    double needed = demand(id, srate);
+    double available = capacity();
+    warning.clear();
+    if(needed > available) {
+        std::ostringstream msg;
+        msg << it->second.name << " at " << srate / 1e6 << " MS/s brings USB demand to "
+            << needed / 1e6 << " MB/s, over the bus capacity of " << available / 1e6 << " MB/s"
+            << (_refuse ? ", refused" : "");
+        warning = msg.str();
+        if(_refuse) return false;
+    }
+
+    it->second.srate = srate;
+    return true;
+}
+
+void
+bus_governor::set_capacity(double capacity, bool refuse) {
+    gr::thread::scoped_lock lock(_mutex);
+    _capacity = capacity > 0 ? capacity : DEFAULT_CAPACITY;
+    _refuse = refuse;
+}
+
+int
+bus_governor::chunk(int id) {
+    gr::thread::scoped_lock lock(_mutex);
+    if(_devices.size() < 2) return INT_MAX;
+
+    // Half the queue kept ahead at most, so pacing leaves a margin
+    auto it = _devices.find(id);
+    if(it == _devices.end() || std::isnan(it->second.srate)) return SHARED_CHUNK;
+    double half = it->second.srate * std::chrono::duration<double>(QUEUE_AHEAD).count() / 2;
+    return std::max(MIN_CHUNK, std::min(SHARED_CHUNK, (int)half));
+}
+
+int
+bus_governor::pick(clock::time_point now) {
+    // Earliest deadline among the devices about to run dry
+    int urgent = -1;
+    for(const auto &d : _devices) {
+        if(!d.second.waiting || d.second.deadline > now + URGENT) continue;
+        if(urgent < 0 || d.second.deadline < _devices[urgent].deadline) urgent = d.first;
+    }
+    if(urgent >= 0) return urgent;
+
+    // Otherwise the next waiting device after the last one served
+    auto it = _devices.upper_bound(_last);
+    for(size_t n = 0; n < _devices.size(); n++, it++) {
+        if(it == _devices.end()) it = _devices.begin();
+        if(it->second.waiting) return it->first;
+    }
+    return -1;
+}
+
+bus_governor::clock::time_point
+bus_governor::next_urgent(clock::time_point now) {
+    clock::time_point next = clock::time_point::max();
+    for(const auto &d : _devices) {
+        if(!d.second.waiting) continue;
+        clock::time_point urgent = d.second.deadline - URGENT;
+        if(urgent > now) next = std::min(next, urgent);
+    }
+    return next;
+}
+
+void
+bus_governor::acquire(int id, clock::time_point deadline, clock::duration length) {
+    gr::thread::scoped_lock lock(_mutex);
+    auto it = _devices.find(id);
+    if(it == _devices.end()) return;
+
+    // Wait for queue room off the bus, blocking in the API would hold the
+    // turn. A device alone has no one to hold up.
+    clock::time_point room = deadline + length - QUEUE_AHEAD;
+    if(_devices.size() > 1 && room > clock::now()) {
+        lock.unlock();
+        std::this_thread::sleep_until(room);
+        lock.lock();
+        it = _devices.find(id);
+        if(it == _devices.end()) return;
+    }
+    device_entry &entry = it->second;
+
+    entry.waiting = true;
+    entry.deadline = deadline;
+    // The devices waiting changed, those asleep pick again
+    _cond.notify_all();
+
+    clock::time_point start = clock::now();
+    clock::time_point now = start;
+    bool waited = false;
+    while(_holder >= 0 || pick(now) != id) {
+        waited = true;
+        // A free bus goes to whoever pick() chooses, which changes as
+        // deadlines come within the margin, so wake for the next one
+        clock::time_point wake = _holder >= 0 ? clock::time_point::max() : next_urgent(now);
+        if(wake == clock::time_point::max()) {
+            _cond.wait(lock);
+        } else {
+            _cond.timed_wait(lock, boost::posix_time::microseconds(
+                std::chrono::duration_cast<std::chrono::microseconds>(wake - now).count() + 1));
+        }
+        now = clock::now();
+    }
+
+    _holder = _last = id;
+    _granted = now;
+    entry.waiting = false;
+    entry.last_submit = now;
+
+    _grants++;
+    if(waited) {
+        _waits++;
+        _wait_stats.add(std::chrono::duration<double>(now - start).count());
+        // Only lateness the wait caused, not a queue that was already empty
+        if(start <= deadline && now > deadline) _late++;
+    }
+}
+
+void
+bus_governor::release(int id, int samples) {
+    gr::thread::scoped_lock lock(_mutex);
+    if(_holder != id) return;
+
+    // Back to back transfers show what the bus delivers under load
+    bool others = std::any_of(_devices.begin(), _devices.end(),
+        [](const std::pair<const int, device_entry> &d) { return d.second.waiting; });
+    if(others) {
+        _saturated_bytes += (double)samples * BYTES_PER_SAMPLE;
+        _saturated_time += std::chrono::duration<double>(clock::now() - _granted).count();
+    }
+
+    _holder = -1;
+    _cond.notify_all();
+}
+
+std::map<std::string, double>
+bus_governor::stats() {
+    gr::thread::scoped_lock lock(_mutex);
+    clock::time_point now = clock::now();
+
+    int streaming = 0;
+    for(const auto &d : _devices) {
+        if(now - d.second.last_submit < STREAMING_WINDOW) streaming++;
+    }
+
+    return {
+        {"devices", (double)_devices.size()},
+        {"streaming", (double)streaming},
+        {"demand", demand(-1, NAN)},
+        {"capacity", _capacity},
+        {"measured_capacity", _saturated_time > 0 ? _saturated_bytes / _saturated_time : 0},
+        {"grants", (double)_grants},
+        {"waits", (double)_waits},
+        {"late", (double)_late},
+        {"wait_mean", _wait_stats.mean()},
+        {"wait_max", _wait_stats.max()}
+    };
+}
+
+} /* namespace vsg60 */
+} /* namespace gr */
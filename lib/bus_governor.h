@@ -0,0 +1,120 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2022 Signal Hound.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#ifndef INCLUDED_VSG60_BUS_GOVERNOR_H
+#define INCLUDED_VSG60_BUS_GOVERNOR_H
+
+#include "running_stats.h"
+#include <gnuradio/thread/thread.h>
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <string>
+
+namespace gr {
+namespace vsg60 {
+
+/*!
+ * \brief Schedules submits of all the VSG60s in a process over the USB bus.
+ *
+ * Devices streaming at high rates through one host controller saturate it,
+ * and concurrent transfers then stall each other unpredictably. Every open
+ * device registers here with its sample rate and takes a turn on the bus
+ * around each submit, so one transfer is in flight at a time. Submits are
+ * split into chunks when more than one device is registered, so no device
+ * holds the bus for long. A device then waits for room in its queue before
+ * its turn, so the turn is not spent blocked in the API.
+ *
+ * Turns go round robin among the devices waiting. A device whose queue is
+ * about to run dry, its deadline within a small margin, goes first,
+ * earliest deadline first.
+ *
+ * Demand is the sum of the rates set on the devices, at 4 bytes per
+ * sample. A rate that takes it past the capacity is warned about, or
+ * refused. The capacity is the configured one, or the throughput measured
+ * while devices were queued back to back for the bus if that is lower.
+ */
+class bus_governor
+{
+public:
+    typedef std::chrono::steady_clock clock;
+
+private:
+      struct device_entry {
+          std::string name;
+          double srate;
+          bool waiting;
+          clock::time_point deadline;
+          clock::time_point last_submit;
+      };
+
+      gr::thread::mutex _mutex;
+      gr::thread::condition_variable _cond;
+      std::map<int, device_entry> _devices;
+      int _next_id;
+
+      // Device holding the bus, -1 when free, and the last granted a turn
+      int _holder;
+      int _last;
+      clock::time_point _granted;
+
+      double _capacity;
+      bool _refuse;
+
+      uint64_t _grants;
+      uint64_t _waits;
+      uint64_t _late;
+      running_stats _wait_stats;
+      // Transfers made while another device was waiting
+      double _saturated_bytes;
+      double _saturated_time;
+
+      int pick(clock::time_point now);
+      // When the next waiting device becomes urgent, max() if none will
+      clock::time_point next_urgent(clock::time_point now);
+      double demand(int id, double srate);
+      double capacity();
+
+public:
+    // Bytes per sample on the bus, 16-bit I and Q
+    static const int BYTES_PER_SAMPLE = 4;
+
+    bus_governor();
+    ~bus_governor();
+
+      // The governor shared by every device in the process
+      static bus_governor &get();
+
+      int add_device(const std::string &name);
+      void remove_device(int id);
+
+      // Returns false if the rate is refused. warning is set when the rate
+      // takes demand over capacity, refused or not.
+      bool set_rate(int id, double srate, std::string &warning);
+      // Bus capacity in bytes per second, refuse rather than warn past it
+      void set_capacity(double capacity, bool refuse);
+
+      // Largest submit in one turn
+      int chunk(int id);
+      // Wait for queue room for length and then for a turn, deadline is
+      // when this device's queue runs dry
+      void acquire(int id, clock::time_point deadline, clock::duration length);
+      void release(int id, int samples);
+
+      /*!
+       * devices, streaming, demand and capacity (bytes per second),
+       * measured_capacity, grants, waits, late (turns granted after their
+       * deadline), wait_mean and wait_max (seconds).
+       */
+      std::map<std::string, double> stats();
+};
+
+} // namespace vsg60
+} // namespace gr
+
+#endif /* INCLUDED_VSG60_BUS_GOVERNOR_H */
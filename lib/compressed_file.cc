@@ -0,0 +1,146 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2022 Signal Hound.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "compressed_file.h"
+#include <volk/volk.h>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef VSG60_ZSTD
+#include <zstd.h>
+#endif
+
+#include <cstring>
+#include <stdexcept>
+
+namespace gr {
+namespace vsg60 {
+
+static const uint32_t VSGZ_VERSION = 1;
+
+// Largest frame accepted, keeps a decoder's buffers bounded
+static const uint32_t MAX_FRAME_SAMPLES = 1 << 24;
+
+static const char *NO_ZSTD = "vsg60: built without zstd, compressed playback is unavailable";
+
+compressed_file::compressed_file(const std::string &path)
+    : _map(MAP_FAILED),
+    _map_size(0),
+    _index(nullptr)
+{
+#ifndef VSG60_ZSTD
+    throw std::runtime_error(NO_ZSTD);
+#endif
+
+    int fd = open(path.c_str(), O_RDONLY);
+    if(fd < 0) {
+        throw std::runtime_error("vsg60: unable to open compressed file " + path);
+    }
+
+    struct stat st;
+    if(fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(vsgz_header)) {
+        close(fd);
+        throw std::runtime_error("vsg60: " + path + " is not a compressed capture");
+    }
+    _map_size = st.st_size;
+
+    // Not prefaulted, captures can be much larger than memory
+    _map = mmap(nullptr, _map_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if(_map == MAP_FAILED) {
+        throw std::runtime_error("vsg60: unable to map compressed file " + path);
+    }
+    madvise(_map, _map_size, MADV_SEQUENTIAL);
+
+    memcpy(&_header, _map, sizeof(_header));
+    _index = (const vsgz_frame *)((const char *)_map + _header.index_offset);
+
+    std::string error;
+    if(memcmp(_header.magic, "VSGZ", 4) || _header.version != VSGZ_VERSION) {
+        error = " is not a version 1 compressed capture";
+    } else if((_header.format != VSGZ_SC16 && _header.format != VSGZ_SC8) ||
+              _header.frame_samples == 0 || _header.frame_samples > MAX_FRAME_SAMPLES ||
+              _header.frame_count == 0 || _header.index_offset % alignof(vsgz_frame) ||
+              _header.index_offset > _map_size ||
+              _header.frame_count > (_map_size - _header.index_offset) / sizeof(vsgz_frame)) {
+        error = " has an invalid header";
+    } else {
+        uint64_t total = 0;
+        for(uint64_t n = 0; n < _header.frame_count && error.empty(); n++) {
+            const vsgz_frame &f = _index[n];
+            if(f.offset > _map_size || f.size > _map_size - f.offset ||
+               f.samples == 0 || f.samples > _header.frame_samples) {
+                error = " has an invalid frame index";
+            }
+            total += f.samples;
+        }
+        if(error.empty() && total != _header.length) {
+            error = " frame index does not cover its length";
+        }
+    }
+
+    if(!error.empty()) {
+        munmap(_map, _map_size);
+        throw std::runtime_error("vsg60: " + path + error);
+    }
+}
+
+compressed_file::~compressed_file()
+{
+    munmap(_map, _map_size);
+}
+
+compressed_file::decoder::decoder()
+    : _ctx(nullptr)
+{
+#ifdef VSG60_ZSTD
+    _ctx = ZSTD_createDCtx();
+    if(!_ctx) throw std::runtime_error("vsg60: unable to create zstd context");
+#else
+    throw std::runtime_error(NO_ZSTD);
+#endif
+}
+
+compressed_file::decoder::~decoder()
+{
+#ifdef VSG60_ZSTD
+    ZSTD_freeDCtx((ZSTD_DCtx *)_ctx);
+#endif
+}
+
+int
+compressed_file::decoder::decode(const compressed_file &file, uint64_t n, gr_complex *out) {
+    const vsgz_frame &f = file.frame(n);
+    const size_t expected = (size_t)f.samples * file.sample_size();
+    if(_packed.size() < expected) _packed.resize(expected);
+
+#ifdef VSG60_ZSTD
+    size_t got = ZSTD_decompressDCtx((ZSTD_DCtx *)_ctx, _packed.data(), expected,
+                                     file.data(n), f.size);
+    if(ZSTD_isError(got)) {
+        throw std::runtime_error("vsg60: compressed frame " + std::to_string(n) +
+                                 ": " + ZSTD_getErrorName(got));
+    }
+    if(got != expected) {
+        throw std::runtime_error("vsg60: compressed frame " + std::to_string(n) + " is short");
+    }
+#endif
+
+    // Integer full scale maps to 1.0
+    if(file._header.format == VSGZ_SC16) {
+        volk_16i_s32f_convert_32f((float *)out, (const int16_t *)_packed.data(), 32768.0f, 2 * f.samples);
+    } else {
+        volk_8i_s32f_convert_32f((float *)out, _packed.data(), 128.0f, 2 * f.samples);
+    }
+    return (int)f.samples;
+}
+
+} /* namespace vsg60 */
+} /* namespace gr */
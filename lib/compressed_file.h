@@ -0,0 +1,113 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2022 Signal Hound.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#ifndef INCLUDED_VSG60_COMPRESSED_FILE_H
+#define INCLUDED_VSG60_COMPRESSED_FILE_H
+
+#include <gnuradio/gr_complex.h>
+#include <volk/volk_alloc.hh>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace gr {
+namespace vsg60 {
+
+/*
+ * Header at the start of a .vsgz file, little endian. The body is a series
+ * of zstd frames, each holding frame_samples interleaved integer I/Q pairs,
+ * the last frame possibly fewer. index_offset points at frame_count
+ * vsgz_frame entries locating them. apps/vsgz_write.py writes these files.
+ */
+struct vsgz_header {
+    char magic[4];          // "VSGZ"
+    uint32_t version;       // 1
+    uint32_t format;        // VSGZ_SC16 or VSGZ_SC8
+    uint32_t frame_samples; // complex samples per frame
+    uint64_t length;        // complex samples
+    uint64_t frame_count;
+    uint64_t index_offset;  // bytes from the start of the file to the index
+    double sample_rate;
+    double frequency;
+    double level;
+};
+
+struct vsgz_frame {
+    uint64_t offset;        // bytes from the start of the file
+    uint32_t size;          // compressed bytes
+    uint32_t samples;       // complex samples once decompressed
+};
+
+enum { VSGZ_SC16 = 0, VSGZ_SC8 = 1 };
+
+/*!
+ * \brief A .vsgz compressed capture mapped into memory.
+ *
+ * Frames decompress independently, so several decoders can work on one
+ * file at once, each on its own frame. The mapping is read on demand with
+ * sequential read ahead, files far larger than memory play without being
+ * loaded.
+ *
+ * Needs zstd at build time, without it the constructor throws.
+ */
+class compressed_file
+{
+private:
+      void *_map;
+      size_t _map_size;
+      vsgz_header _header;
+      const vsgz_frame *_index;
+
+public:
+    // Throws std::runtime_error if the file is missing or malformed
+    compressed_file(const std::string &path);
+    ~compressed_file();
+
+      compressed_file(const compressed_file &) = delete;
+      compressed_file &operator=(const compressed_file &) = delete;
+
+      uint64_t length() const { return _header.length; }
+      uint64_t frame_count() const { return _header.frame_count; }
+      int frame_samples() const { return (int)_header.frame_samples; }
+      // Bytes per complex sample once decompressed
+      int sample_size() const { return _header.format == VSGZ_SC16 ? 4 : 2; }
+      double sample_rate() const { return _header.sample_rate; }
+      double frequency() const { return _header.frequency; }
+      double level() const { return _header.level; }
+
+      const vsgz_frame &frame(uint64_t n) const { return _index[n]; }
+      const void *data(uint64_t n) const { return (const char *)_map + _index[n].offset; }
+
+    /*!
+     * \brief Decompresses frames and converts them to float I/Q.
+     *
+     * Holds a zstd context and the integer scratch buffer. One per thread.
+     */
+    class decoder
+    {
+    private:
+          void *_ctx;
+          volk::vector<int8_t> _packed;
+
+    public:
+        decoder();
+        ~decoder();
+
+          decoder(const decoder &) = delete;
+          decoder &operator=(const decoder &) = delete;
+
+          // Frame n of file into out, scaled to +/-1 full scale. Returns
+          // the samples written, throws std::runtime_error if corrupt.
+          int decode(const compressed_file &file, uint64_t n, gr_complex *out);
+    };
+};
+
+} // namespace vsg60
+} // namespace gr
+
+#endif /* INCLUDED_VSG60_COMPRESSED_FILE_H */
@@ -0,0 +1,317 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2022 Signal Hound.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "compressed_player_impl.h"
+#include <gnuradio/io_signature.h>
+
+#include <algorithm>
+#include <limits>
+#include <thread>
+
+namespace gr {
+namespace vsg60 {
+
+// Largest single submission, frames are split so the device can change
+// hands between submits
+static const int SUBMIT_CHUNK = 65536;
+
+// Decoders most cores can keep busy without starving the submit thread
+static const int MAX_THREADS = 16;
+
+static const pmt::pmt_t ACTIVE_PORT = pmt::mp("active");
+
+compressed_player::sptr compressed_player::make(const std::string &path, bool repeat,
+                                                int threads, int serial)
+{
+    return gnuradio::make_block_sptr<compressed_player_impl>(path, repeat, threads, serial);
+}
+
+compressed_player_impl::compressed_player_impl(const std::string &path, bool repeat,
+                                               int threads, int serial)
+    : gr::block("compressed_player",
+                gr::io_signature::make(0, 0, 0),
+                gr::io_signature::make(0, 0, 0)),
+    _file(path),
+    _arbiter(arbiter::get(d_logger, serial)),
+    _device(_arbiter->dev()),
+    _client(-1),
+    _repeat(repeat),
+    _nthreads(threads),
+    _active(true),
+    _end(0),
+    _next_decode(0),
+    _next_submit(0),
+    _submitted(0),
+    _stalls(0),
+    _errors(0),
+    _decoded(0),
+    _decoded_bytes(0),
+    _compressed_bytes(0),
+    _decode_time(0),
+    _running(false)
+{
+    if(_nthreads <= 0) {
+        _nthreads = std::max(1, (int)gr::thread::thread::hardware_concurrency() - 1);
+    }
+    _nthreads = std::min(_nthreads, MAX_THREADS);
+
+    // Two frames per decoder keeps each busy while the oldest is submitted
+    _slots.resize(2 * _nthreads + 2);
+    for(slot &s : _slots) {
+        s.samples.resize(_file.frame_samples());
+        s.seq = 0;
+        s.len = 0;
+        s.ready = false;
+    }
+
+    GR_LOG_INFO(d_logger, "Compressed capture " << path << ", " << _file.length()
+                << " samples in " << _file.frame_count() << " frames, "
+                << _nthreads << " decode threads");
+
+    message_port_register_in(ACTIVE_PORT);
+    set_msg_handler(ACTIVE_PORT, [this](const pmt::pmt_t &msg) { handle_active(msg); });
+
+    _client = _arbiter->add_client(alias(), 0);
+}
+
+compressed_player_impl::~compressed_player_impl()
+{
+    stop();
+    _arbiter->remove_client(_client);
+}
+
+void
+compressed_player_impl::set_device_priority(int priority) {
+    _arbiter->set_priority(_client, priority);
+}
+
+void
+compressed_player_impl::set_active(bool active) {
+    _active = active;
+    // Requests wait for start(), and the end of the file releases
+    if(_running) _arbiter->request(_client, active);
+}
+
+void
+compressed_player_impl::handle_active(const pmt::pmt_t &msg) {
+    bool active;
+    if(!arbiter::active_message(msg, active)) {
+        GR_LOG_WARN(d_logger, "Active message is not a bool, ignored");
+        return;
+    }
+    set_active(active);
+}
+
+std::map<std::string, double>
+compressed_player_impl::stats() {
+    gr::thread::scoped_lock lock(_mutex);
+
+    // Each decoder's rate while busy, times the decoders working at once
+    double decode_rate = _decode_time > 0 ? _decoded / _decode_time * _nthreads : 0;
+    uint64_t ready = 0;
+    for(const slot &s : _slots) ready += s.ready;
+
+    return {
+        {"submitted_samples", (double)_submitted},
+        {"frames", (double)_next_submit},
+        {"stalls", (double)_stalls},
+        {"errors", (double)_errors},
+        {"ready_frames", (double)ready},
+        {"decode_rate", decode_rate},
+        {"device_rate", _file.sample_rate()},
+        {"headroom", decode_rate / _file.sample_rate()},
+        {"compression_ratio", _compressed_bytes ? (double)_decoded_bytes / _compressed_bytes : 0}
+    };
+}
+
+void
+compressed_player_impl::decode() {
+    typedef std::chrono::steady_clock clock;
+    compressed_file::decoder decoder;
+
+    gr::thread::scoped_lock lock(_mutex);
+    while(true) {
+        while(_running && _next_decode < _end && _next_decode >= _next_submit + _slots.size()) {
+            _free_cond.wait(lock);
+        }
+        if(!_running || _next_decode >= _end) return;
+
+        // Frames are taken in order, whichever decoder is free next
+        const uint64_t seq = _next_decode++;
+        const uint64_t n = seq % _file.frame_count();
+        slot &s = _slots[seq % _slots.size()];
+
+        lock.unlock();
+        clock::time_point start = clock::now();
+        int len = 0;
+        try {
+            len = decoder.decode(_file, n, s.samples.data());
+        } catch(const std::exception &e) {
+            GR_LOG_ERROR(d_logger, e.what());
+        }
+        double elapsed = std::chrono::duration<double>(clock::now() - start).count();
+        lock.lock();
+
+        // A corrupt frame is skipped rather than ending playback
+        if(len == 0) _errors++;
+        _decoded += len;
+        _decoded_bytes += (uint64_t)len * _file.sample_size();
+        _compressed_bytes += _file.frame(n).size;
+        _decode_time += elapsed;
+
+        s.seq = seq;
+        s.len = len;
+        s.ready = true;
+        _ready_cond.notify_all();
+    }
+}
+
+void
+compressed_player_impl::submit(const gr_complex *iq, int len, bool &owned,
+                               std::chrono::steady_clock::time_point &queue_end) {
+    typedef std::chrono::steady_clock clock;
+
+    for(int pos = 0; pos < len && _running; pos += SUBMIT_CHUNK) {
+        const int n = std::min(SUBMIT_CHUNK, len - pos);
+        clock::time_point now = clock::now();
+
+        bool owner;
+        {
+            gr::thread::scoped_lock lock(_arbiter->mutex());
+            owner = _arbiter->owns(_client);
+            if(owner && !owned) {
+                _device.set_srate(_file.sample_rate());
+                _device.set_frequency(_file.frequency());
+                _device.set_level(_file.level());
+            }
+            owned = owner;
+
+            if(owner) {
+                if(_device.submit(iq + pos, n, queue_end)) {
+                    _arbiter->output_started(_client);
+                } else {
+                    // A lost device takes its queue with it
+                    queue_end = clock::now();
+                }
+            }
+        }
+
+        queue_end = std::max(queue_end, now) +
+            std::chrono::duration_cast<clock::duration>(
+                std::chrono::duration<double>(n / _file.sample_rate()));
+
+        if(owner) {
+            gr::thread::scoped_lock lock(_mutex);
+            _submitted += n;
+        } else {
+            // Without the device, keep the file to real time
+            std::this_thread::sleep_until(queue_end);
+        }
+    }
+    _device.flush_log();
+}
+
+void
+compressed_player_impl::run() {
+    typedef std::chrono::steady_clock clock;
+
+    // Host estimate of when the device finishes what has been submitted
+    clock::time_point queue_end = clock::now();
+    bool owned = false;
+
+    while(_running) {
+        slot *s;
+        {
+            gr::thread::scoped_lock lock(_mutex);
+            if(_next_submit >= _end) break;
+
+            s = &_slots[_next_submit % _slots.size()];
+            while(_running && !(s->ready && s->seq == _next_submit)) {
+                _ready_cond.wait(lock);
+            }
+            if(!_running) break;
+
+            // The device ran dry while the frame was decoding
+            if(_next_submit > 0 && clock::now() > queue_end) _stalls++;
+        }
+
+        submit(s->samples.data(), s->len, owned, queue_end);
+
+        gr::thread::scoped_lock lock(_mutex);
+        s->ready = false;
+        _next_submit++;
+        _free_cond.notify_all();
+    }
+
+    if(_next_submit >= _end) {
+        // Let the end of the file play, then hand the device on
+        {
+            gr::thread::scoped_lock lock(_arbiter->mutex());
+            if(_arbiter->owns(_client)) VSG_CALL(_device, vsgFlush);
+        }
+        _running = false;
+        _arbiter->request(_client, false);
+        _device.flush_log();
+        GR_LOG_INFO(d_logger, "Compressed capture finished");
+    }
+}
+
+bool
+compressed_player_impl::start() {
+    {
+        gr::thread::scoped_lock lock(_mutex);
+        _end = _repeat ? std::numeric_limits<uint64_t>::max() : _file.frame_count();
+        _next_decode = _next_submit = 0;
+        for(slot &s : _slots) s.ready = false;
+    }
+    _running = true;
+    if(_active) _arbiter->request(_client, true);
+
+    for(int i = 0; i < _nthreads; i++) {
+        _decoders.emplace_back(new gr::thread::thread([this]() { decode(); }));
+    }
+    _thread.reset(new gr::thread::thread([this]() { run(); }));
+    return true;
+}
+
+bool
+compressed_player_impl::stop() {
+    {
+        gr::thread::scoped_lock lock(_mutex);
+        _running = false;
+    }
+    _free_cond.notify_all();
+    _ready_cond.notify_all();
+
+    if(!_thread) return true;
+    _thread->join();
+    _thread.reset();
+    for(auto &t : _decoders) {
+        t->join();
+    }
+    _decoders.clear();
+
+    {
+        gr::thread::scoped_lock lock(_arbiter->mutex());
+        if(_arbiter->owns(_client)) VSG_CALL(_device, vsgAbort);
+    }
+    _arbiter->request(_client, false);
+    _device.flush_log();
+
+    std::map<std::string, double> counters = stats();
+    if(counters["frames"] > 0) {
+        GR_LOG_INFO(d_logger, "Played " << counters["submitted_samples"] << " samples in "
+                    << counters["frames"] << " frames, decode "
+                    << counters["decode_rate"] / 1e6 << " MS/s ("
+                    << counters["headroom"] << "x the device), "
+                    << counters["stalls"] << " stalls, " << counters["errors"] << " errors");
+    }
+    return true;
+}
+
+} /* namespace vsg60 */
+} /* namespace gr */
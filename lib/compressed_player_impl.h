@@ -0,0 +1,91 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2022 Signal Hound.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#ifndef INCLUDED_VSG60_COMPRESSED_PLAYER_IMPL_H
+#define INCLUDED_VSG60_COMPRESSED_PLAYER_IMPL_H
+
+#include <vsg60/compressed_player.h>
+#include "arbiter.h"
+#include "compressed_file.h"
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <vector>
+
+namespace gr {
+namespace vsg60 {
+
+class compressed_player_impl : public compressed_player
+{
+private:
+      // Opened first, a bad path fails before the device is touched
+      compressed_file _file;
+
+      // Shared with other blocks on the same device
+      std::shared_ptr<arbiter> _arbiter;
+      device &_device;
+      int _client;
+
+      bool _repeat;
+      int _nthreads;
+      std::atomic<bool> _active;
+
+      // A decoded frame waiting for its turn
+      struct slot {
+          volk::vector<gr_complex> samples;
+          uint64_t seq;
+          int len;
+          bool ready;
+      };
+
+      // Frame seq decodes into slot seq % size once frame seq - size has
+      // been submitted, so the decoders stay at most a ring ahead
+      gr::thread::mutex _mutex;
+      gr::thread::condition_variable _free_cond;
+      gr::thread::condition_variable _ready_cond;
+      std::vector<slot> _slots;
+      uint64_t _end;
+      uint64_t _next_decode;
+      uint64_t _next_submit;
+
+      // Guarded by _mutex
+      uint64_t _submitted;
+      uint64_t _stalls;
+      uint64_t _errors;
+      uint64_t _decoded;
+      uint64_t _decoded_bytes;
+      uint64_t _compressed_bytes;
+      double _decode_time;
+
+      std::vector<std::unique_ptr<gr::thread::thread>> _decoders;
+      std::unique_ptr<gr::thread::thread> _thread;
+      std::atomic<bool> _running;
+
+      void decode();
+      void run();
+      void handle_active(const pmt::pmt_t &msg);
+      void submit(const gr_complex *iq, int len, bool &owned,
+                  std::chrono::steady_clock::time_point &queue_end);
+
+public:
+    compressed_player_impl(const std::string &path, bool repeat, int threads, int serial);
+    ~compressed_player_impl();
+
+      void set_device_priority(int priority);
+      void set_active(bool active);
+
+      std::map<std::string, double> stats();
+
+      bool start();
+      bool stop();
+};
+
+} // namespace vsg60
+} // namespace gr
+
+#endif /* INCLUDED_VSG60_COMPRESSED_PLAYER_IMPL_H */
@@ -0,0 +1,240 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2022 Signal Hound.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "device.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+namespace gr {
+namespace vsg60 {
+
+// A device still not reopened after this long is reported, attempts go on
+static const std::chrono::seconds RECONNECT_TIMEOUT(30);
+
+// Messages queued beyond this before a flush are dropped
+static const size_t MAX_QUEUED_LOG = 64;
+
+static bool connection_lost(VsgStatus status)
+{
+    return status == vsgUsbXferErr ||
+           status == vsgDeviceNotFoundErr ||
+           status == vsgInvalidDeviceErr;
+}
+
+device::device(gr::logger_ptr logger, int serial)
+    : _handle(-1),
+    _serial(serial),
+    _logger(logger),
+    _frequency(std::numeric_limits<double>::quiet_NaN()),
+    _level(std::numeric_limits<double>::quiet_NaN()),
+    _srate(std::numeric_limits<double>::quiet_NaN()),
+    _trigger_length(std::numeric_limits<double>::quiet_NaN()),
+    _rf_output(true),
+    _bus(bus_governor::get()),
+    _bus_id(-1),
+    _errors(0),
+    _reconnects(0),
+    _downtime(0),
+    _lost(false),
+    _lost_reported(false),
+    _log_pending(false)
+{
+    GR_LOG_INFO(_logger, "API Version: " << VSG_TRACE("vsgGetAPIVersion", vsgGetAPIVersion()));
+
+    // Open device
+    VsgStatus status = serial ?
+        VSG_TRACE("vsgOpenDeviceBySerial", vsgOpenDeviceBySerial(&_handle, serial)) :
+        VSG_TRACE("vsgOpenDevice", vsgOpenDevice(&_handle));
+    if(status < vsgNoError) {
+        throw std::runtime_error(std::string("vsg60: unable to open device: ") +
+                                 vsgGetErrorString(status));
+    }
+
+    VSG_CALL(*this, vsgGetSerialNumber, &_serial);
+    flush_log();
+    GR_LOG_INFO(_logger, "Serial Number: " << _serial);
+
+    _bus_id = _bus.add_device("VSG60 " + std::to_string(_serial));
+}
+
+device::~device()
+{
+    _bus.remove_device(_bus_id);
+    if(_handle >= 0) {
+        VSG_TRACE("vsgAbort", vsgAbort(_handle));
+        VSG_TRACE("vsgCloseDevice", vsgCloseDevice(_handle));
+    }
+    flush_log();
+}
+
+void
+device::queue_log(bool error, const std::string &msg) {
+    gr::thread::scoped_lock lock(_log_mutex);
+    if(_log.size() < MAX_QUEUED_LOG) _log.push_back(std::make_pair(error, msg));
+    _log_pending = true;
+}
+
+void
+device::flush_log() {
+    if(!_log_pending) return;
+
+    std::vector<std::pair<bool, std::string>> log;
+    {
+        gr::thread::scoped_lock lock(_log_mutex);
+        log.swap(_log);
+        _log_pending = false;
+    }
+
+    for(const auto &entry : log) {
+        if(entry.first) {
+            GR_LOG_ERROR(_logger, entry.second);
+        } else {
+            GR_LOG_WARN(_logger, entry.second);
+        }
+    }
+}
+
+bool
+device::check(VsgStatus status, const char *call) {
+    if(status == vsgNoError) return true;
+
+    // Calls on a lost device fail until it is reopened, once is reported
+    if(_lost && connection_lost(status)) return false;
+
+    std::string msg = std::string(call) + ": " + vsgGetErrorString(status);
+    if(status > vsgNoError) {
+        queue_log(false, msg);
+        return true;
+    }
+
+    _errors++;
+    queue_log(true, msg);
+    if(connection_lost(status)) {
+        queue_log(true, "Device " + std::to_string(_serial) + " lost, reconnecting");
+        _lost_at = std::chrono::steady_clock::now();
+        _lost_reported = false;
+        _lost = true;
+    }
+    return false;
+}
+
+bool
+device::poll() {
+    return VSG_CALL(*this, vsgGetUSBStatus);
+}
+
+bool
+device::reconnect() {
+    if(!_lost) return true;
+
+    if(_handle >= 0) VSG_TRACE("vsgCloseDevice", vsgCloseDevice(_handle));
+    _handle = -1;
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - _lost_at;
+    if(VSG_TRACE("vsgOpenDeviceBySerial", vsgOpenDeviceBySerial(&_handle, _serial)) != vsgNoError) {
+        _handle = -1;
+        if(!_lost_reported && elapsed > RECONNECT_TIMEOUT) {
+            queue_log(true, "Device " + std::to_string(_serial) + " could not be reopened in " +
+                            std::to_string(RECONNECT_TIMEOUT.count()) + " s, still trying");
+            _lost_reported = true;
+        }
+        return false;
+    }
+
+    // Restore the configuration the device was streaming with
+    if(!std::isnan(_srate)) VSG_TRACE("vsgSetSampleRate", vsgSetSampleRate(_handle, _srate));
+    if(!std::isnan(_frequency)) VSG_TRACE("vsgSetFrequency", vsgSetFrequency(_handle, _frequency));
+    if(!std::isnan(_level)) VSG_TRACE("vsgSetLevel", vsgSetLevel(_handle, _level));
+    if(!std::isnan(_trigger_length)) VSG_TRACE("vsgSetTriggerLength", vsgSetTriggerLength(_handle, _trigger_length));
+    if(!_rf_output) VSG_TRACE("vsgSetRFOutputState", vsgSetRFOutputState(_handle, vsgFalse));
+
+    _downtime += elapsed.count();
+    _reconnects++;
+    _lost = false;
+    queue_log(false, "Device " + std::to_string(_serial) + " reconnected after " +
+                     std::to_string(elapsed.count()) + " s");
+    return true;
+}
+
+bool
+device::set_frequency(double frequency) {
+    _frequency = frequency;
+    return VSG_CALL(*this, vsgSetFrequency, frequency);
+}
+
+bool
+device::set_level(double level) {
+    _level = level;
+    return VSG_CALL(*this, vsgSetLevel, level);
+}
+
+bool
+device::set_srate(double srate) {
+    // Rates the bus cannot carry are logged, or refused if configured to
+    std::string warning;
+    bool allowed = _bus.set_rate(_bus_id, srate, warning);
+    if(!warning.empty()) queue_log(!allowed, warning);
+    if(!allowed) return false;
+
+    _srate = srate;
+    return VSG_CALL(*this, vsgSetSampleRate, srate);
+}
+
+bool
+device::set_trigger_length(double seconds) {
+    _trigger_length = seconds;
+    return VSG_CALL(*this, vsgSetTriggerLength, seconds);
+}
+
+bool
+device::set_rf_output(bool enabled) {
+    _rf_output = enabled;
+    return VSG_CALL(*this, vsgSetRFOutputState, enabled ? vsgTrue : vsgFalse);
+}
+
+bool
+device::submit(const gr_complex *iq, int len, std::chrono::steady_clock::time_point deadline) {
+    typedef std::chrono::steady_clock clock;
+
+    // Nothing to wait for the bus with until the device is reopened
+    if(_lost) return false;
+
+    const int chunk = _bus.chunk(_bus_id);
+    for(int pos = 0; pos < len; pos += chunk) {
+        const int n = std::min(chunk, len - pos);
+        const clock::duration length = std::isnan(_srate) ? clock::duration::zero() :
+            std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(n / _srate));
+
+        // A queue already run dry starts again from now
+        deadline = std::max(deadline, clock::now());
+        _bus.acquire(_bus_id, deadline, length);
+        bool submitted = VSG_CALL(*this, vsgSubmitIQ, (float *)(iq + pos), n);
+        _bus.release(_bus_id, n);
+        if(!submitted) return false;
+
+        // Each chunk queued pushes the next one's deadline out
+        deadline += length;
+    }
+    return true;
+}
+
+std::map<std::string, double>
+device::stats() {
+    return {
+        {"errors", (double)_errors},
+        {"reconnects", (double)_reconnects},
+        {"downtime", _downtime + (_lost ? std::chrono::duration<double>(
+                         std::chrono::steady_clock::now() - _lost_at).count() : 0)}
+    };
+}
+
+} /* namespace vsg60 */
+} /* namespace gr */
@@ -0,0 +1,127 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2022 Signal Hound.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#ifndef INCLUDED_VSG60_DEVICE_H
+#define INCLUDED_VSG60_DEVICE_H
+
+#include <vsg60/vsg_api.h>
+#include "bus_governor.h"
+#include "trace.h"
+#include <gnuradio/gr_complex.h>
+#include <gnuradio/logger.h>
+#include <gnuradio/thread/thread.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace gr {
+namespace vsg60 {
+
+// Call an API function on a device's handle and check the returned status
+#define VSG_CALL(dev, fn, ...) \
+    (dev).check(VSG_TRACE(#fn, fn((dev).handle(), ##__VA_ARGS__)), #fn)
+
+/*!
+ * \brief An open VSG60 and the settings needed to restore it after a reconnect.
+ *
+ * API statuses are classified rather than aborting on error. Warnings and
+ * errors are logged and the call reports failure. When a status shows the
+ * USB connection was lost, the device is marked lost and submits fail at
+ * once, so no caller holds the bus or its lock while it is gone.
+ * reconnect(), called off the streaming path, reopens it by serial number.
+ * The cached sample rate, frequency, level, trigger length and RF output
+ * state are then restored, so the caller can resume streaming.
+ *
+ * Messages raised from the streaming path are queued and written to the
+ * GNU Radio logger by flush_log(), which the owner calls from a thread that
+ * can afford to block.
+ *
+ * Not thread safe, callers serialize access.
+ */
+class device
+{
+private:
+      int _handle;
+      int _serial;
+      gr::logger_ptr _logger;
+
+      // Settings restored after a reconnect, NaN when never set
+      double _frequency;
+      double _level;
+      double _srate;
+      double _trigger_length;
+      bool _rf_output;
+
+      // Turns on the USB bus shared with other devices
+      bus_governor &_bus;
+      int _bus_id;
+
+      uint64_t _errors;
+      uint64_t _reconnects;
+      double _downtime;
+      std::atomic<bool> _lost;
+      std::chrono::steady_clock::time_point _lost_at;
+      bool _lost_reported;
+
+      gr::thread::mutex _log_mutex;
+      std::vector<std::pair<bool, std::string>> _log;
+      std::atomic<bool> _log_pending;
+
+public:
+    // Open the device with this serial number, 0 opens the first found
+    device(gr::logger_ptr logger, int serial = 0);
+    ~device();
+
+      int handle() const { return _handle; }
+      int serial() const { return _serial; }
+
+      // Returns false if the call failed. A lost connection marks the
+      // device lost.
+      bool check(VsgStatus status, const char *call);
+      // Poll the USB status, marking the device lost if it is gone
+      bool poll();
+      // Lock free, true from a lost connection until reconnect() succeeds
+      bool lost() const { return _lost; }
+      // One attempt to reopen a lost device and restore its settings,
+      // returns true once it is back
+      bool reconnect();
+
+      bool set_frequency(double frequency);
+      bool set_level(double level);
+      bool set_srate(double srate);
+      bool set_trigger_length(double seconds);
+      bool set_rf_output(bool enabled);
+
+      // vsgSubmitIQ in turns with the other devices on the bus. deadline is
+      // when the samples already queued run out, paced on while shared.
+      // False at once while the device is lost.
+      bool submit(const gr_complex *iq, int len, std::chrono::steady_clock::time_point deadline);
+
+      // Queue a message without blocking, and write queued messages to the logger
+      void queue_log(bool error, const std::string &msg);
+      void flush_log();
+
+      // Last frequency, level and sample rate set, NaN when never set. A
+      // rate refused for the USB bus is not set.
+      double frequency() const { return _frequency; }
+      double level() const { return _level; }
+      double srate() const { return _srate; }
+      bool rf_output() const { return _rf_output; }
+
+      // errors, reconnects, downtime (seconds)
+      std::map<std::string, double> stats();
+};
+
+} // namespace vsg60
+} // namespace gr
+
+#endif /* INCLUDED_VSG60_DEVICE_H */
@@ -0,0 +1,178 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2022 Signal Hound.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "fractional_delay.h"
+#include <volk/volk.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace gr {
+namespace vsg60 {
+
+const int fractional_delay::MAX_DELAY;
+
+// Input kept from the previous block, enough for the longest delay and
+// the interpolator's four taps
+static const int HISTORY = fractional_delay::MAX_DELAY + 4;
+
+// Samples filtered at a time, keeps the scratch buffers in cache
+static const int BLOCK = 4096;
+
+// Largest change per sample while ramping, in samples and radians. The
+// delay slew is a 1000 ppm rate change, the phase slew a small frequency
+// offset.
+static const double DELAY_SLEW = 1e-3;
+static const double PHASE_SLEW = 1e-3;
+
+fractional_delay::fractional_delay()
+    : _input(HISTORY + BLOCK, gr_complex(0, 0)),
+    _scratch(2 * BLOCK),
+    _target_delay(0),
+    _target_phase(0),
+    _changed(false),
+    _enabled(false),
+    _delay(0),
+    _phase(0),
+    _delay_step(0),
+    _phase_step(0),
+    _ramp(0),
+    _ramp_delay(0),
+    _ramp_phase(0),
+    _rotation(1, 0)
+{
+}
+
+fractional_delay::~fractional_delay()
+{
+}
+
+void
+fractional_delay::set(double delay, double phase) {
+    gr::thread::scoped_lock lock(_mutex);
+    _target_delay = std::max(0.0, std::min(delay, (double)MAX_DELAY));
+    _target_phase = phase;
+
+    // Stays out of the path until there is something to trim
+    if(!_enabled && _target_delay == 0 && std::remainder(phase, 2 * M_PI) == 0) return;
+    _enabled = true;
+    _changed = true;
+}
+
+double
+fractional_delay::delay() {
+    gr::thread::scoped_lock lock(_mutex);
+    return _target_delay;
+}
+
+double
+fractional_delay::phase() {
+    gr::thread::scoped_lock lock(_mutex);
+    return _target_phase;
+}
+
+void
+fractional_delay::start_ramp() {
+    {
+        gr::thread::scoped_lock lock(_mutex);
+        _ramp_delay = _target_delay;
+        _ramp_phase = _phase + std::remainder(_target_phase - _phase, 2 * M_PI);
+        _changed = false;
+    }
+
+    // Both reach the target together, at whichever slew limit is slower
+    const double delay_change = _ramp_delay - _delay;
+    const double phase_change = _ramp_phase - _phase;
+    _ramp = std::max<int64_t>({1,
+        (int64_t)std::ceil(std::abs(delay_change) / DELAY_SLEW),
+        (int64_t)std::ceil(std::abs(phase_change) / PHASE_SLEW)});
+    _delay_step = delay_change / _ramp;
+    _phase_step = phase_change / _ramp;
+}
+
+void
+fractional_delay::filter_fixed(gr_complex *out, int start, int n) {
+    const int whole = std::min((int)_delay, MAX_DELAY);
+    const float d = (float)(_delay - whole);
+
+    // Lagrange weights of x[k], x[k-1], x[k-2], x[k-3] at 1 + d samples back
+    const float h[4] = {
+        -d * d * d / 6 + d * d / 2 - d / 3,
+        d * d * d / 2 - d * d - d / 2 + 1,
+        -d * d * d / 2 + d * d / 2 + d,
+        d * d * d / 6 - d / 6
+    };
+
+    // Interleaved I/Q scale as one float array
+    const gr_complex *x = _input.data() + HISTORY + start - whole;
+    float *o = (float *)out;
+    volk_32f_s32f_multiply_32f(o, (const float *)x, h[0], 2 * n);
+    for(int m = 1; m < 4; m++) {
+        volk_32f_s32f_multiply_32f(_scratch.data(), (const float *)(x - m), h[m], 2 * n);
+        volk_32f_x2_add_32f(o, o, _scratch.data(), 2 * n);
+    }
+    volk_32fc_s32fc_multiply_32fc(out, out, _rotation, n);
+}
+
+void
+fractional_delay::filter_ramp(gr_complex *out, int start, int n) {
+    for(int k = 0; k < n; k++) {
+        const int whole = std::min((int)_delay, MAX_DELAY);
+        const float d = (float)(_delay - whole);
+        const gr_complex *x = _input.data() + HISTORY + start + k - whole;
+
+        // Farrow form, the polynomial in d of the same weights
+        const gr_complex c0 = x[-1];
+        const gr_complex c1 = -x[0] / 3.0f - x[-1] / 2.0f + x[-2] - x[-3] / 6.0f;
+        const gr_complex c2 = x[0] / 2.0f - x[-1] + x[-2] / 2.0f;
+        const gr_complex c3 = -x[0] / 6.0f + x[-1] / 2.0f - x[-2] / 2.0f + x[-3] / 6.0f;
+        out[k] = (c0 + d * (c1 + d * (c2 + d * c3))) * std::polar(1.0f, (float)_phase);
+
+        if(--_ramp == 0) {
+            _delay = _ramp_delay;
+            _phase = std::remainder(_ramp_phase, 2 * M_PI);
+            _rotation = std::polar(1.0f, (float)_phase);
+            _delay_step = _phase_step = 0;
+        } else {
+            _delay += _delay_step;
+            _phase += _phase_step;
+        }
+    }
+}
+
+void
+fractional_delay::process(gr_complex *iq, int n) {
+    if(!_enabled) {
+        // History is kept while switched out, so switching in continues
+        // from the samples just played rather than from zeros
+        const int keep = std::min(n, HISTORY);
+        memmove(_input.data(), _input.data() + keep, (HISTORY - keep) * sizeof(gr_complex));
+        memcpy(_input.data() + HISTORY - keep, iq + n - keep, keep * sizeof(gr_complex));
+        return;
+    }
+
+    for(int pos = 0; pos < n; pos += BLOCK) {
+        const int len = std::min(BLOCK, n - pos);
+        memcpy(_input.data() + HISTORY, iq + pos, len * sizeof(gr_complex));
+
+        // A new target is picked up between blocks, never inside a ramp step
+        if(_changed) start_ramp();
+
+        int done = 0;
+        if(_ramp > 0) {
+            done = (int)std::min<int64_t>(_ramp, len);
+            filter_ramp(iq + pos, 0, done);
+        }
+        if(done < len) filter_fixed(iq + pos + done, done, len - done);
+
+        memmove(_input.data(), _input.data() + len, HISTORY * sizeof(gr_complex));
+    }
+}
+
+} /* namespace vsg60 */
+} /* namespace gr */
@@ -0,0 +1,86 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2022 Signal Hound.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#ifndef INCLUDED_VSG60_FRACTIONAL_DELAY_H
+#define INCLUDED_VSG60_FRACTIONAL_DELAY_H
+
+#include <gnuradio/gr_complex.h>
+#include <gnuradio/thread/thread.h>
+#include <volk/volk_alloc.hh>
+
+#include <atomic>
+#include <cstdint>
+
+namespace gr {
+namespace vsg60 {
+
+/*!
+ * \brief Fractional delay and phase trim for aligning several devices.
+ *
+ * A cubic Lagrange interpolator in Farrow form delays the stream by
+ * 1 + delay samples, delay from 0 to MAX_DELAY, then rotates it by a phase
+ * offset. The extra sample is the interpolator's latency and is the same on
+ * every channel. The first non-zero setting switches the stage in, which
+ * repeats one sample; history is kept while it is switched out, so the
+ * delayed stream otherwise continues from what was just played.
+ *
+ * New settings are reached by a linear ramp limited to a small delay and
+ * phase change per sample, so the output is continuous while alignment is
+ * trimmed. While the delay is steady the filter runs as four scaled VOLK
+ * passes, during a ramp the Farrow polynomial is evaluated per sample.
+ *
+ * set() may be called from any thread, process() from one thread at a time.
+ */
+class fractional_delay
+{
+private:
+      volk::vector<gr_complex> _input;
+      volk::vector<float> _scratch;
+
+      gr::thread::mutex _mutex;
+      double _target_delay;
+      double _target_phase;
+      std::atomic<bool> _changed;
+      std::atomic<bool> _enabled;
+
+      // Current setting, and per-sample steps of the ramp towards the target
+      double _delay;
+      double _phase;
+      double _delay_step;
+      double _phase_step;
+      int64_t _ramp;
+      double _ramp_delay;
+      double _ramp_phase;
+      gr_complex _rotation;
+
+      void start_ramp();
+      void filter_fixed(gr_complex *out, int start, int n);
+      void filter_ramp(gr_complex *out, int start, int n);
+
+public:
+    // Longest delay, in samples
+    static const int MAX_DELAY = 32;
+
+    fractional_delay();
+    ~fractional_delay();
+
+      // Delay in samples, phase in radians
+      void set(double delay, double phase);
+      bool enabled() const { return _enabled; }
+
+      // Delay n samples in place
+      void process(gr_complex *iq, int n);
+
+      // Setting being ramped to, reached within change / slew samples
+      double delay();
+      double phase();
+};
+
+} // namespace vsg60
+} // namespace gr
+
+#endif /* INCLUDED_VSG60_FRACTIONAL_DELAY_H */
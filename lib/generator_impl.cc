@@ -0,0 +1,348 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2022 Signal Hound.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "generator_impl.h"
+#include <gnuradio/fft/fft.h>
+#include <gnuradio/io_signature.h>
+#include <volk/volk.h>
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <stdexcept>
+
+namespace gr {
+namespace vsg60 {
+
+enum { CW = 0, TONES, CHIRP, NOISE };
+
+static const pmt::pmt_t ACTIVE_PORT = pmt::mp("active");
+
+// Tone offsets are multiples of this, so the waveform is srate / TONE_GRID long
+static const double TONE_GRID = 1e3;
+
+// Longest precomputed waveform, 128 MiB
+static const double MAX_SAMPLES = 1 << 24;
+
+static int waveform_length(double seconds, double srate)
+{
+    double len = std::round(seconds * srate);
+    if(len < 1 || len > MAX_SAMPLES) {
+        throw std::invalid_argument("vsg60: generator waveform must be 1 to " +
+                                    std::to_string((int)MAX_SAMPLES) + " samples");
+    }
+    return (int)len;
+}
+
+// Throws for a waveform that cannot be built, before a setter changes state
+static void check_waveform(int waveform, double srate, const std::vector<double> &tones,
+                           double chirp_period, double noise_period)
+{
+    switch(waveform) {
+    case CW: break;
+    case TONES:
+        waveform_length(1 / TONE_GRID, srate);
+        // Beyond the Nyquist limit a tone would alias to another offset
+        for(double offset : tones) {
+            if(std::abs(std::round(offset / TONE_GRID) * TONE_GRID) >= srate / 2) {
+                throw std::invalid_argument("vsg60: generator tone offset " +
+                                            std::to_string(offset) + " Hz is outside +/- " +
+                                            std::to_string(srate / 2) + " Hz");
+            }
+        }
+        break;
+    case CHIRP: waveform_length(chirp_period, srate); break;
+    case NOISE: waveform_length(noise_period, srate); break;
+    default:
+        throw std::invalid_argument("vsg60: unknown generator waveform " +
+                                    std::to_string(waveform));
+    }
+}
+
+// Two tones at +/- 1 MHz, closer in when the sample rate is too low for them
+static std::vector<double> default_tones(double srate)
+{
+    const double offset = std::min(1e6, std::floor(srate / 4 / TONE_GRID) * TONE_GRID);
+    return {-offset, offset};
+}
+
+generator::sptr generator::make(int waveform, double frequency, double level, double srate, int serial)
+{
+    return gnuradio::make_block_sptr<generator_impl>(waveform, frequency, level, srate, serial);
+}
+
+generator_impl::generator_impl(int waveform, double frequency, double level, double srate, int serial)
+    : gr::block("generator",
+                gr::io_signature::make(0, 0, 0),
+                gr::io_signature::make(0, 0, 0)),
+    _arbiter(arbiter::get(d_logger, serial)),
+    _device(_arbiter->dev()),
+    _client(-1),
+    _active(true),
+    _waveform(waveform),
+    _frequency(frequency),
+    _level(level),
+    _srate(srate),
+    _tones(default_tones(srate)),
+    _chirp_bandwidth(10e6),
+    _chirp_period(1e-3),
+    _noise_bandwidth(10e6),
+    _noise_period(10e-3),
+    _rebuild(true),
+    _running(false)
+{
+    check_waveform(_waveform, _srate, _tones, _chirp_period, _noise_period);
+
+    message_port_register_in(ACTIVE_PORT);
+    set_msg_handler(ACTIVE_PORT, [this](const pmt::pmt_t &msg) { handle_active(msg); });
+
+    // Output starts whenever the device is handed to this block
+    _client = _arbiter->add_client(alias(), 0, [this]() {
+        gr::thread::scoped_lock lock(_mutex);
+        output();
+    });
+}
+
+generator_impl::~generator_impl()
+{
+    _arbiter->remove_client(_client);
+}
+
+void
+generator_impl::set_waveform(int waveform) {
+    gr::thread::scoped_lock lock(_mutex);
+    check_waveform(waveform, _srate, _tones, _chirp_period, _noise_period);
+    _waveform = waveform;
+    _rebuild = true;
+    output();
+}
+
+void
+generator_impl::set_frequency(double frequency) {
+    gr::thread::scoped_lock lock(_mutex);
+    _frequency = frequency;
+    output();
+}
+
+void
+generator_impl::set_level(double level) {
+    gr::thread::scoped_lock lock(_mutex);
+    _level = level;
+    output();
+}
+
+void
+generator_impl::set_srate(double srate) {
+    gr::thread::scoped_lock lock(_mutex);
+    check_waveform(_waveform, srate, _tones, _chirp_period, _noise_period);
+    _srate = srate;
+    _rebuild = true;
+    output();
+}
+
+void
+generator_impl::set_tones(const std::vector<double> &offsets) {
+    gr::thread::scoped_lock lock(_mutex);
+    check_waveform(_waveform, _srate, offsets, _chirp_period, _noise_period);
+    _tones = offsets;
+    _rebuild = true;
+    output();
+}
+
+void
+generator_impl::set_chirp(double bandwidth, double period) {
+    gr::thread::scoped_lock lock(_mutex);
+    check_waveform(_waveform, _srate, _tones, period, _noise_period);
+    _chirp_bandwidth = bandwidth;
+    _chirp_period = period;
+    _rebuild = true;
+    output();
+}
+
+void
+generator_impl::set_noise(double bandwidth, double period) {
+    gr::thread::scoped_lock lock(_mutex);
+    check_waveform(_waveform, _srate, _tones, _chirp_period, period);
+    _noise_bandwidth = bandwidth;
+    _noise_period = period;
+    _rebuild = true;
+    output();
+}
+
+void
+generator_impl::set_device_priority(int priority) {
+    _arbiter->set_priority(_client, priority);
+}
+
+void
+generator_impl::set_active(bool active) {
+    bool running;
+    {
+        gr::thread::scoped_lock lock(_mutex);
+        _active = active;
+        running = _running;
+    }
+    // Not under the mutex, gaining the device outputs through it
+    if(running) _arbiter->request(_client, active);
+}
+
+void
+generator_impl::handle_active(const pmt::pmt_t &msg) {
+    bool active;
+    if(!arbiter::active_message(msg, active)) {
+        GR_LOG_WARN(d_logger, "Active message is not a bool, ignored");
+        return;
+    }
+    set_active(active);
+}
+
+void
+generator_impl::build_tones() {
+    const int len = waveform_length(1 / TONE_GRID, _srate);
+
+    // One cycle of the grid frequency, tones index into it so every tone
+    // completes a whole number of cycles in the waveform
+    volk::vector<gr_complex> cycle(len), tone(len);
+    for(int n = 0; n < len; n++) {
+        cycle[n] = std::polar(1.0f, (float)(2 * M_PI * n / len));
+    }
+
+    _samples.assign(len, gr_complex(0, 0));
+    const int count = (int)_tones.size();
+    for(int m = 0; m < count; m++) {
+        int64_t step = (int64_t)std::llround(_tones[m] / TONE_GRID) % len;
+        if(step < 0) step += len;
+
+        // Schroeder phases keep the crest factor of many tones low
+        const gr_complex phase = std::polar(1.0f, (float)(M_PI * m * m / count));
+        int64_t index = 0;
+        for(int n = 0; n < len; n++) {
+            tone[n] = cycle[index];
+            index += step;
+            if(index >= len) index -= len;
+        }
+        volk_32fc_s32fc_multiply_32fc(tone.data(), tone.data(), phase, len);
+        volk_32fc_x2_add_32fc(_samples.data(), _samples.data(), tone.data(), len);
+    }
+}
+
+void
+generator_impl::build_chirp() {
+    const int len = waveform_length(_chirp_period, _srate);
+    const double period = len / _srate;
+
+    // Phase in cycles returns to zero at the end of the sweep, so the
+    // repeated waveform has no phase step
+    _samples.resize(len);
+    for(int n = 0; n < len; n++) {
+        double t = n / _srate;
+        double cycles = t * (-_chirp_bandwidth / 2 + _chirp_bandwidth * t / (2 * period));
+        _samples[n] = std::polar(1.0f, (float)(2 * M_PI * (cycles - std::floor(cycles))));
+    }
+}
+
+void
+generator_impl::build_noise() {
+    const int len = waveform_length(_noise_period, _srate);
+
+    // Random bins within the bandwidth, transformed back to time, are
+    // periodic in the waveform length by construction
+    gr::fft::fft_complex_rev fft(len);
+    gr_complex *bins = fft.get_inbuf();
+    std::mt19937 rng(len);
+    std::normal_distribution<float> normal;
+    for(int k = 0; k < len; k++) {
+        double freq = (k < (len + 1) / 2 ? k : k - len) * _srate / len;
+        bins[k] = std::abs(freq) <= _noise_bandwidth / 2 ?
+            gr_complex(normal(rng), normal(rng)) : gr_complex(0, 0);
+    }
+    fft.execute();
+
+    _samples.assign(fft.get_outbuf(), fft.get_outbuf() + len);
+}
+
+void
+generator_impl::normalize() {
+    volk::vector<float> power(_samples.size());
+    uint32_t peak;
+    volk_32fc_magnitude_squared_32f(power.data(), _samples.data(), _samples.size());
+    volk_32f_index_max_32u(&peak, power.data(), _samples.size());
+    if(power[peak] > 0) {
+        const gr_complex scale(1 / std::sqrt(power[peak]), 0);
+        volk_32fc_s32fc_multiply_32fc(_samples.data(), _samples.data(), scale, _samples.size());
+    }
+}
+
+void
+generator_impl::output() {
+    if(!_running) return;
+
+    // Built before taking the device, long noise waveforms take a while.
+    // The setters reject waveforms that cannot be built, anything else that
+    // fails here is logged, this runs from the arbiter's grant callback.
+    if(_waveform != CW && _rebuild) {
+        try {
+            switch(_waveform) {
+            case TONES: build_tones(); break;
+            case CHIRP: build_chirp(); break;
+            case NOISE: build_noise(); break;
+            }
+            normalize();
+        } catch(const std::exception &e) {
+            GR_LOG_ERROR(d_logger, e.what());
+            return;
+        }
+        _rebuild = false;
+    }
+
+    {
+        gr::thread::scoped_lock lock(_arbiter->mutex());
+        if(!_arbiter->owns(_client)) return;
+
+        _device.set_srate(_srate);
+        _device.set_frequency(_frequency);
+        _device.set_level(_level);
+
+        // The API keeps its own copy and repeats it
+        bool started = _waveform == CW ?
+            VSG_CALL(_device, vsgOutputCW) :
+            VSG_CALL(_device, vsgRepeatWaveform, (float *)_samples.data(), (int)_samples.size());
+        if(started) _arbiter->output_started(_client);
+    }
+
+    _device.flush_log();
+}
+
+bool
+generator_impl::start() {
+    bool active;
+    {
+        gr::thread::scoped_lock lock(_mutex);
+        _running = true;
+        active = _active;
+    }
+    // Output starts once the device is granted
+    if(active) _arbiter->request(_client, true);
+    return true;
+}
+
+bool
+generator_impl::stop() {
+    {
+        gr::thread::scoped_lock lock(_mutex);
+        _running = false;
+
+        gr::thread::scoped_lock device_lock(_arbiter->mutex());
+        if(_arbiter->owns(_client)) VSG_CALL(_device, vsgAbort);
+    }
+    _arbiter->request(_client, false);
+    _device.flush_log();
+    return true;
+}
+
+} /* namespace vsg60 */
+} /* namespace gr */
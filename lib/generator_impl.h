@@ -0,0 +1,74 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2022 Signal Hound.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#ifndef INCLUDED_VSG60_GENERATOR_IMPL_H
+#define INCLUDED_VSG60_GENERATOR_IMPL_H
+
+#include <vsg60/generator.h>
+#include "arbiter.h"
+
+#include <volk/volk_alloc.hh>
+
+namespace gr {
+namespace vsg60 {
+
+class generator_impl : public generator
+{
+private:
+      // Shared with other blocks on the same device
+      std::shared_ptr<arbiter> _arbiter;
+      device &_device;
+      int _client;
+
+      gr::thread::mutex _mutex;
+      bool _active;
+      int _waveform;
+      double _frequency;
+      double _level;
+      double _srate;
+      std::vector<double> _tones;
+      double _chirp_bandwidth;
+      double _chirp_period;
+      double _noise_bandwidth;
+      double _noise_period;
+
+      // Precomputed waveform, rebuilt when a parameter it depends on changes
+      volk::vector<gr_complex> _samples;
+      bool _rebuild;
+      bool _running;
+
+      void build_tones();
+      void build_chirp();
+      void build_noise();
+      void normalize();
+      void output();
+      void handle_active(const pmt::pmt_t &msg);
+
+public:
+    generator_impl(int waveform, double frequency, double level, double srate, int serial);
+    ~generator_impl();
+
+      void set_waveform(int waveform);
+      void set_frequency(double frequency);
+      void set_level(double level);
+      void set_srate(double srate);
+
+      void set_tones(const std::vector<double> &offsets);
+      void set_chirp(double bandwidth, double period);
+      void set_noise(double bandwidth, double period);
+
+      void set_device_priority(int priority);
+      void set_active(bool active);
+
+      bool start();
+      bool stop();
+};
+
+} // namespace vsg60
+} // namespace gr
+
+#endif /* INCLUDED_VSG60_GENERATOR_IMPL_H */
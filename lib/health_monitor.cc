@@ -0,0 +1,127 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2022 Signal Hound.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "health_monitor.h"
+
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <thread>
+
+namespace gr {
+namespace vsg60 {
+
+// How often to retry when the device is busy
+static const std::chrono::milliseconds RETRY_INTERVAL(10);
+
+// Nice value of the monitor thread
+static const int MONITOR_NICE = 19;
+
+// Assumed length of a recalibration until one has been timed
+static const double RECAL_ESTIMATE = 1.0;
+
+health_monitor::health_monitor(device &dev,
+                               gr::thread::mutex &device_mutex,
+                               double interval,
+                               double recal_threshold,
+                               const state_fn &quiet,
+                               const idle_fn &idle,
+                               const publish_fn &publish)
+    : _device(dev),
+    _device_mutex(device_mutex),
+    _interval(interval),
+    _recal_threshold(recal_threshold),
+    _quiet(quiet),
+    _idle(idle),
+    _publish(publish),
+    _recal_temperature(std::numeric_limits<double>::quiet_NaN()),
+    _recal_duration(RECAL_ESTIMATE),
+    _recals(0),
+    _running(true)
+{
+    _thread.reset(new gr::thread::thread([this]() { run(); }));
+}
+
+health_monitor::~health_monitor()
+{
+    _running = false;
+    if(_thread) _thread->join();
+}
+
+std::map<std::string, double>
+health_monitor::values() {
+    gr::thread::scoped_lock lock(_mutex);
+    return _values;
+}
+
+bool
+health_monitor::sample(std::map<std::string, double> &values) {
+    // Never wait on the submit path
+    gr::thread::scoped_lock lock(_device_mutex, boost::try_to_lock);
+    if(!lock.owns_lock() || !_quiet()) return false;
+
+    float temperature = 0;
+    uint32_t cal_date = 0;
+    VsgBool rf_output = vsgFalse;
+    bool usb_ok = _device.poll();
+    VSG_CALL(_device, vsgReadTemperature, &temperature);
+    VSG_CALL(_device, vsgGetCalDate, &cal_date);
+    VSG_CALL(_device, vsgGetRFOutputState, &rf_output);
+
+    if(std::isnan(_recal_temperature)) _recal_temperature = temperature;
+    // Still under the lock, the submit path cannot refill until it returns
+    if(_recal_threshold > 0 && std::abs(temperature - _recal_temperature) >= _recal_threshold &&
+       _idle(_recal_duration)) {
+        auto start = std::chrono::steady_clock::now();
+        if(VSG_CALL(_device, vsgRecal)) {
+            _recal_duration = std::chrono::duration<double>(
+                std::chrono::steady_clock::now() - start).count();
+            _recal_temperature = temperature;
+            _recals++;
+        }
+    }
+
+    values = {
+        {"temperature", temperature},
+        {"usb_ok", usb_ok ? 1.0 : 0.0},
+        {"cal_date", (double)cal_date},
+        {"rf_output", rf_output == vsgTrue ? 1.0 : 0.0},
+        {"recals", (double)_recals}
+    };
+    return true;
+}
+
+void
+health_monitor::run() {
+    // Lower this thread's priority, the scheduler's threads come first
+    setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid), MONITOR_NICE);
+
+    auto next = std::chrono::steady_clock::now();
+    while(_running) {
+        std::this_thread::sleep_for(RETRY_INTERVAL);
+        if(std::chrono::steady_clock::now() < next) continue;
+
+        std::map<std::string, double> values;
+        if(!sample(values)) continue;
+        next = std::chrono::steady_clock::now() +
+            std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                std::chrono::duration<double>(_interval));
+
+        {
+            gr::thread::scoped_lock lock(_mutex);
+            _values = values;
+        }
+        if(_publish) _publish(values);
+    }
+}
+
+} /* namespace vsg60 */
+} /* namespace gr */
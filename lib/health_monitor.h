@@ -0,0 +1,84 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2022 Signal Hound.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#ifndef INCLUDED_VSG60_HEALTH_MONITOR_H
+#define INCLUDED_VSG60_HEALTH_MONITOR_H
+
+#include "device.h"
+#include <gnuradio/thread/thread.h>
+
+#include <atomic>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+
+namespace gr {
+namespace vsg60 {
+
+/*!
+ * \brief Samples device temperature, USB status, calibration date and RF
+ * output state on a low priority thread.
+ *
+ * The monitor only touches the device when it gets the device mutex without
+ * waiting and the owner reports the submit path has headroom, otherwise it
+ * retries shortly after. When the temperature has drifted by recal_threshold
+ * degrees since the last calibration and the owner reports it can pause for
+ * as long as the last recalibration took, vsgRecal is run. The device mutex
+ * is held from that check until vsgRecal returns.
+ */
+class health_monitor
+{
+public:
+    // Called with the device mutex held
+    typedef std::function<bool()> state_fn;
+    // Called with the device mutex held and the seconds a recalibration
+    // would keep it, true if output can stop that long
+    typedef std::function<bool(double)> idle_fn;
+    // Called after each sample, without the device mutex
+    typedef std::function<void(const std::map<std::string, double> &)> publish_fn;
+
+private:
+      device &_device;
+      gr::thread::mutex &_device_mutex;
+      double _interval;
+      double _recal_threshold;
+      state_fn _quiet;
+      idle_fn _idle;
+      publish_fn _publish;
+
+      gr::thread::mutex _mutex;
+      std::map<std::string, double> _values;
+      double _recal_temperature;
+      // How long the last recalibration held the device
+      double _recal_duration;
+      uint64_t _recals;
+
+      std::unique_ptr<gr::thread::thread> _thread;
+      std::atomic<bool> _running;
+
+      bool sample(std::map<std::string, double> &values);
+      void run();
+
+public:
+    health_monitor(device &dev,
+                   gr::thread::mutex &device_mutex,
+                   double interval,
+                   double recal_threshold,
+                   const state_fn &quiet,
+                   const idle_fn &idle,
+                   const publish_fn &publish);
+    ~health_monitor();
+
+      // temperature, usb_ok, cal_date, rf_output, recals, empty until sampled
+      std::map<std::string, double> values();
+};
+
+} // namespace vsg60
+} // namespace gr
+
+#endif /* INCLUDED_VSG60_HEALTH_MONITOR_H */
@@ -0,0 +1,210 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2022 Signal Hound.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "iq_correction.h"
+#include <volk/volk.h>
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+namespace gr {
+namespace vsg60 {
+
+// Entries kept before the cache is cleared, one per frequency visited
+static const size_t MAX_CACHED_FREQUENCIES = 64;
+
+iq_correction::iq_correction(const std::string &cal_file, int nworkers)
+    : _ntaps(0),
+    _fft_size(0)
+{
+    if(cal_file.empty()) return;
+
+    load(cal_file);
+
+    if(_ntaps > 0) {
+        // Keep the overlap small relative to the block so most of each FFT is output
+        _fft_size = 1024;
+        while(_fft_size < 4 * _ntaps) _fft_size *= 2;
+
+        _workspaces.resize(std::max(nworkers, 1));
+        for(workspace &ws : _workspaces) {
+            ws.fwd.reset(new gr::fft::fft_complex_fwd(_fft_size));
+            ws.rev.reset(new gr::fft::fft_complex_rev(_fft_size));
+        }
+    }
+}
+
+iq_correction::~iq_correction()
+{
+}
+
+void
+iq_correction::load(const std::string &cal_file) {
+    std::ifstream file(cal_file);
+    if(!file) {
+        throw std::runtime_error("vsg60: unable to open calibration file " + cal_file);
+    }
+
+    std::string line;
+    while(std::getline(file, line)) {
+        if(line.empty() || line[0] == '#') continue;
+
+        std::istringstream fields(line);
+        cal_point point;
+        if(!(fields >> point.frequency >> point.gain_db >> point.phase_deg)) continue;
+
+        float re, im;
+        while(fields >> re >> im) {
+            point.taps.push_back(gr_complex(re, im));
+        }
+
+        _ntaps = std::max(_ntaps, (int)point.taps.size());
+        _table.push_back(point);
+    }
+
+    if(_table.empty()) {
+        throw std::runtime_error("vsg60: no calibration points in " + cal_file);
+    }
+
+    std::sort(_table.begin(), _table.end(), [](const cal_point &l, const cal_point &r) {
+        return l.frequency < r.frequency;
+    });
+
+    // Pad shorter filters so all points share one FFT size
+    for(cal_point &point : _table) {
+        point.taps.resize(_ntaps, gr_complex(0, 0));
+    }
+}
+
+std::shared_ptr<const iq_correction::state>
+iq_correction::build(double frequency) {
+    // Find the bracketing points, clamping outside the table
+    auto hi = std::lower_bound(_table.begin(), _table.end(), frequency,
+        [](const cal_point &point, double f) { return point.frequency < f; });
+    auto lo = hi;
+    if(hi == _table.end()) {
+        lo = hi = _table.end() - 1;
+    } else if(hi != _table.begin() && hi->frequency != frequency) {
+        lo = hi - 1;
+    }
+
+    float t = 0;
+    if(hi != lo) {
+        t = (float)((frequency - lo->frequency) / (hi->frequency - lo->frequency));
+    }
+
+    auto s = std::make_shared<state>();
+    s->frequency = frequency;
+
+    // Invert the imbalance I_o = I, Q_o = g * (Q * cos(phi) - I * sin(phi))
+    float gain = std::pow(10.0f, ((1 - t) * lo->gain_db + t * hi->gain_db) / 20.0f);
+    float phase = ((1 - t) * lo->phase_deg + t * hi->phase_deg) * (float)M_PI / 180.0f;
+    s->c = std::tan(phase);
+    s->d = 1.0f / (gain * std::cos(phase));
+
+    if(_ntaps > 0) {
+        gr::fft::fft_complex_fwd fft(_fft_size);
+        gr_complex *taps = fft.get_inbuf();
+        std::fill(taps, taps + _fft_size, gr_complex(0, 0));
+        for(int i = 0; i < _ntaps; i++) {
+            taps[i] = (1 - t) * lo->taps[i] + t * hi->taps[i];
+        }
+        fft.execute();
+
+        s->response.resize(_fft_size);
+        const float scale = 1.0f / _fft_size;
+        for(int i = 0; i < _fft_size; i++) {
+            s->response[i] = fft.get_outbuf()[i] * scale;
+        }
+    }
+
+    return s;
+}
+
+std::shared_ptr<const iq_correction::state>
+iq_correction::lookup(double frequency) {
+    {
+        gr::thread::scoped_lock lock(_cache_mutex);
+        auto it = _cache.find(frequency);
+        if(it != _cache.end()) return it->second;
+    }
+
+    // The table is fixed after loading, so building needs no lock and a
+    // retune never waits on another frequency's transform
+    std::shared_ptr<const state> built = build(frequency);
+
+    gr::thread::scoped_lock lock(_cache_mutex);
+    if(_cache.size() >= MAX_CACHED_FREQUENCIES) _cache.clear();
+    // A concurrent build of the same frequency may have got there first
+    return _cache.emplace(frequency, built).first->second;
+}
+
+void
+iq_correction::prepare(double frequency) {
+    if(!enabled()) return;
+    lookup(frequency);
+}
+
+void
+iq_correction::set_frequency(double frequency) {
+    if(!enabled()) return;
+    std::atomic_store(&_state, lookup(frequency));
+}
+
+void
+iq_correction::filter(const gr_complex *in, gr_complex *out, int n,
+                      const state &s, workspace &ws) {
+    const int hist = _ntaps - 1;
+    const int step = _fft_size - hist;
+    gr_complex *fft_in = ws.fwd->get_inbuf();
+
+    for(int done = 0; done < n;) {
+        int m = std::min(step, n - done);
+
+        // Overlap-save block, zero padded when the chunk is short
+        std::copy(in + done - hist, in + done + m, fft_in);
+        std::fill(fft_in + hist + m, fft_in + _fft_size, gr_complex(0, 0));
+
+        ws.fwd->execute();
+        volk_32fc_x2_multiply_32fc(ws.rev->get_inbuf(), ws.fwd->get_outbuf(),
+                                   s.response.data(), _fft_size);
+        ws.rev->execute();
+
+        // The first hist outputs are circular wrap-around
+        std::copy(ws.rev->get_outbuf() + hist, ws.rev->get_outbuf() + hist + m, out + done);
+        done += m;
+    }
+}
+
+void
+iq_correction::process(const gr_complex *in, gr_complex *out, int n, int worker) {
+    // Hold a reference for the whole call, a retune may swap the state
+    std::shared_ptr<const state> s = std::atomic_load(&_state);
+    if(!s) {
+        std::copy(in, in + n, out);
+        return;
+    }
+
+    if(_ntaps > 0) {
+        filter(in, out, n, *s, _workspaces[worker]);
+    } else {
+        std::copy(in, in + n, out);
+    }
+
+    // I passes through unchanged
+    const float c = s->c, d = s->d;
+    float *iq = (float *)out;
+    for(int i = 0; i < n; i++) {
+        iq[2 * i + 1] = c * iq[2 * i] + d * iq[2 * i + 1];
+    }
+}
+
+} /* namespace vsg60 */
+} /* namespace gr */
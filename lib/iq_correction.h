@@ -0,0 +1,105 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2022 Signal Hound.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#ifndef INCLUDED_VSG60_IQ_CORRECTION_H
+#define INCLUDED_VSG60_IQ_CORRECTION_H
+
+#include <gnuradio/fft/fft.h>
+#include <gnuradio/gr_complex.h>
+#include <gnuradio/thread/thread.h>
+#include <volk/volk_alloc.hh>
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace gr {
+namespace vsg60 {
+
+/*!
+ * \brief Frequency dependent I/Q pre-correction applied before submission.
+ *
+ * Loads a calibration table of I/Q gain/phase imbalance and equalizer taps
+ * measured at a set of frequencies. The table is a text file, one point per
+ * line:
+ *
+ *     frequency_hz gain_db phase_deg [tap0_re tap0_im tap1_re tap1_im ...]
+ *
+ * Lines starting with '#' are ignored. Points between table entries are
+ * linearly interpolated. The prepared correction for each frequency is cached
+ * and swapped in atomically on retune, so the streaming path never waits on
+ * table lookups or tap transforms.
+ *
+ * The equalizer runs as an overlap-save FFT filter reading history() - 1
+ * samples before each chunk, so chunks of any length can be processed without
+ * latency. Each worker thread gets its own FFT buffers, letting disjoint
+ * sample ranges of one buffer be corrected in parallel.
+ */
+class iq_correction
+{
+private:
+      // Everything needed to correct at one frequency
+      struct state {
+          double frequency;
+          // Imbalance matrix, I' = I, Q' = c * I + d * Q
+          float c, d;
+          // Equalizer frequency response, 1/N scaling folded in
+          volk::vector<gr_complex> response;
+      };
+
+      struct cal_point {
+          double frequency;
+          float gain_db;
+          float phase_deg;
+          std::vector<gr_complex> taps;
+      };
+
+      std::vector<cal_point> _table;
+      int _ntaps;
+      int _fft_size;
+
+      gr::thread::mutex _cache_mutex;
+      std::map<double, std::shared_ptr<const state>> _cache;
+      std::shared_ptr<const state> _state;
+
+      // FFT buffers, one set per worker
+      struct workspace {
+          std::unique_ptr<gr::fft::fft_complex_fwd> fwd;
+          std::unique_ptr<gr::fft::fft_complex_rev> rev;
+      };
+      std::vector<workspace> _workspaces;
+
+      void load(const std::string &cal_file);
+      std::shared_ptr<const state> build(double frequency);
+      // Cached correction, built outside the cache lock when missing
+      std::shared_ptr<const state> lookup(double frequency);
+      void filter(const gr_complex *in, gr_complex *out, int n,
+                  const state &s, workspace &ws);
+
+public:
+    iq_correction(const std::string &cal_file, int nworkers = 1);
+    ~iq_correction();
+
+      bool enabled() const { return !_table.empty(); }
+      // Block history needed by process(), in GNU Radio set_history() terms
+      int history() const { return _ntaps > 0 ? _ntaps : 1; }
+
+      // Build and cache the correction for a frequency, off the streaming path
+      void prepare(double frequency);
+      // Switch to the correction for a frequency, building it if not cached
+      void set_frequency(double frequency);
+
+      // Correct n samples using the given worker's buffers. in must have
+      // history() - 1 valid samples before it and must not alias out.
+      void process(const gr_complex *in, gr_complex *out, int n, int worker = 0);
+};
+
+} // namespace vsg60
+} // namespace gr
+
+#endif /* INCLUDED_VSG60_IQ_CORRECTION_H */
@@ -7,58 +7,136 @@
 
 #include "iqin_impl.h"
 #include <gnuradio/io_signature.h>
+#ifdef GR_CTRLPORT
+#include <gnuradio/rpcregisterhelpers.h>
+#endif
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <pthread.h>
+#include <sched.h>
+#include <stdexcept>
+#include <thread>
+#include <time.h>
+#include <volk/volk.h>
 
 namespace gr {
 namespace vsg60 {
 
 using input_type = gr_complex;
-iqin::sptr iqin::make(double frequency, double level, double srate, bool repeat)
-{
-    return gnuradio::make_block_sptr<iqin_impl>(frequency, level, srate, repeat);
-}
 
-void ERROR_CHECK(VsgStatus status)
+// Samples per range handed to a preprocessing worker
+static const int PARALLEL_CHUNK = 16384;
+
+// Start concealing when the device is estimated to run dry within this time
+static const std::chrono::microseconds CONCEAL_MARGIN(1000);
+
+// Granularity of the silence scan used for gating
+static const int GATE_BLOCK = 512;
+
+// Timed transmissions are prefilled with zeros starting this early
+static const std::chrono::milliseconds PREFILL_LEAD(20);
+
+// How often the watchdog checks the USB connection
+static const std::chrono::milliseconds USB_POLL_INTERVAL(100);
+
+// Queued time needed before the health monitor may hold the device
+static const std::chrono::milliseconds HEALTH_HEADROOM(5);
+
+static const pmt::pmt_t TX_TIME_KEY = pmt::mp("tx_time");
+static const pmt::pmt_t TRIGGER_KEY = pmt::mp("trigger");
+static const pmt::pmt_t LEVEL_KEY = pmt::mp("level");
+static const pmt::pmt_t LATENCY_PORT = pmt::mp("latency");
+static const pmt::pmt_t HEALTH_PORT = pmt::mp("health");
+static const pmt::pmt_t SIGNAL_PORT = pmt::mp("signal");
+static const pmt::pmt_t ALIGN_PORT = pmt::mp("align");
+static const pmt::pmt_t LEVEL_PORT = pmt::mp("level");
+
+iqin::sptr iqin::make(double frequency, double level, double srate, bool repeat,
+                      const std::string &cal_file, int threads, int serial)
 {
-    if(status != vsgNoError) {
-        bool isWarning = status > vsgNoError;
-        std::cout << "** " << (isWarning ? "Warning: " : "Error: ") << vsgGetErrorString(status) << " **" << "\n";
-        if(!isWarning) abort();
-    }
+    return gnuradio::make_block_sptr<iqin_impl>(frequency, level, srate, repeat,
+                                                cal_file, threads, serial);
 }
 
-iqin_impl::iqin_impl(double frequency, double level, double srate, bool repeat)
+iqin_impl::iqin_impl(double frequency, double level, double srate, bool repeat,
+                     const std::string &cal_file, int threads, int serial)
     : gr::sync_block("iqin",
                      gr::io_signature::make(1, 1, sizeof(input_type)),
                      gr::io_signature::make(0, 0, 0)),
-    _handle(-1),
+    _arbiter(arbiter::get(d_logger, serial)),
+    _device(_arbiter->dev()),
+    _client(-1),
+    _active(true),
+    _owner(false),
     _frequency(frequency),
     _level(level),
     _srate(srate),
     _repeat(repeat),
     _param_changed(true),
     _buffer(0),
-    _len(0)
+    _len(0),
+    _correction(cal_file, std::max(threads, 1)),
+    _record_level(level),
+    _submit_priority(0),
+    _thread_changed(false),
+    _rt_applied(false),
+    _last_submit_len(0),
+    _device_mutex(_arbiter->mutex()),
+    _ring_pos(0),
+    _ring_full(false),
+    _concealing(false),
+    _conceal_count(0),
+    _conceal_time(0),
+    _watchdog_running(false),
+    _gate_threshold(0),
+    _gate_min_silence(0),
+    _gate_scratch(GATE_BLOCK),
+    _silent_run(0),
+    _gated(false),
+    _rf_off(false),
+    _gate_skipped(0),
+    _gate_spans(0),
+    _gated_samples(0),
+    _submitted_samples(0),
+    _dropped_samples(0),
+    _submit_cpu(0),
+    _next_event(0),
+    _start_pending(false),
+    _start_time(0),
+    _signal(),
+    _signal_interval(0),
+    _playing_file(false),
+    _marker_interval(0),
+    _marker_reset(false),
+    _marker_countdown(0),
+    _work_enter(0)
 {
-    std::cout << "\nAPI Version: " << vsgGetAPIVersion() << "\n";
+    message_port_register_out(LATENCY_PORT);
+    message_port_register_out(HEALTH_PORT);
+    message_port_register_out(SIGNAL_PORT);
+    message_port_register_in(ALIGN_PORT);
+    set_msg_handler(ALIGN_PORT, [this](const pmt::pmt_t &msg) { handle_alignment(msg); });
+    message_port_register_in(LEVEL_PORT);
+    set_msg_handler(LEVEL_PORT, [this](const pmt::pmt_t &msg) { handle_level(msg); });
 
-    // Open device
-    ERROR_CHECK(vsgOpenDevice(&_handle));
+    set_history(_correction.history());
+    if(threads > 1) _pool.reset(new worker_pool(threads));
 
-    int serial;
-    ERROR_CHECK(vsgGetSerialNumber(_handle, &serial));
-    std::cout << "Serial Number: "<< serial << "\n";
+    _client = _arbiter->add_client(alias(), 0);
 }
 
 iqin_impl::~iqin_impl() 
 {
-    vsgAbort(_handle);
-    vsgCloseDevice(_handle);
-
+    _arbiter->remove_client(_client);
     if(_buffer) delete [] _buffer;
 }
 
 void
 iqin_impl::set_frequency(double frequency) {
+    // Build the correction now so the retune in work() only swaps it in
+    _correction.prepare(frequency);
+
     gr::thread::scoped_lock lock(_mutex);
     _frequency = frequency;
     _param_changed = true;
@@ -66,6 +144,12 @@ iqin_impl::set_frequency(double frequency) {
 
 void
 iqin_impl::set_level(double level) {
+    // A digital step, the hardware only changes if it leaves the window
+    if(_envelope.enabled()) {
+        _envelope.schedule(0, level, 0);
+        return;
+    }
+
     gr::thread::scoped_lock lock(_mutex);
     _level = level;
     _param_changed = true;
@@ -85,26 +169,993 @@ iqin_impl::set_repeat(bool repeat) {
     _param_changed = true;
 }
 
+void
+iqin_impl::set_submit_affinity(const std::vector<int> &cpus) {
+    gr::thread::scoped_lock lock(_mutex);
+    _submit_affinity = cpus;
+    _thread_changed = true;
+}
+
+void
+iqin_impl::set_submit_priority(int priority) {
+    gr::thread::scoped_lock lock(_mutex);
+    _submit_priority = std::max(0, std::min(priority, sched_get_priority_max(SCHED_FIFO)));
+    _thread_changed = true;
+}
+
+void
+iqin_impl::set_power_saving(bool enabled) {
+    // Process wide, there is no device handle to check the status against
+    VSG_TRACE("vsgEnablePowerSavingCpuMode", vsgEnablePowerSavingCpuMode(enabled ? vsgTrue : vsgFalse));
+}
+
+std::map<std::string, double>
+iqin_impl::submit_stats() {
+    gr::thread::scoped_lock lock(_stats_mutex);
+    return {
+        {"count", (double)_call_stats.count()},
+        {"call_mean", _call_stats.mean()},
+        {"call_max", _call_stats.max()},
+        {"jitter_rms", _jitter_stats.rms()},
+        {"jitter_min", _jitter_stats.min()},
+        {"jitter_max", _jitter_stats.max()}
+    };
+}
+
+void
+iqin_impl::reset_submit_stats() {
+    gr::thread::scoped_lock lock(_stats_mutex);
+    _call_stats.reset();
+    _jitter_stats.reset();
+    _last_submit_len = 0;
+}
+
+void
+iqin_impl::apply_thread_settings() {
+    gr::thread::scoped_lock lock(_mutex);
+
+    // Runs on the thread calling work(), which is the one that submits.
+    // Defaults leave the scheduler's own affinity and priority alone.
+    if(!_submit_affinity.empty()) {
+        gr::thread::thread_bind_to_processor(_submit_affinity);
+    }
+
+    if(_submit_priority > 0 || _rt_applied) {
+        sched_param param;
+        param.sched_priority = _submit_priority;
+        int err = pthread_setschedparam(pthread_self(),
+                                        _submit_priority > 0 ? SCHED_FIFO : SCHED_OTHER, &param);
+        if(err) {
+            _device.queue_log(false, std::string("Unable to set submit thread priority: ") + strerror(err));
+        } else {
+            _rt_applied = _submit_priority > 0;
+        }
+    }
+}
+
+bool
+iqin_impl::is_silent(const gr_complex *iq, int len) {
+    uint32_t peak;
+    volk_32fc_magnitude_squared_32f(_gate_scratch.data(), iq, len);
+    volk_32f_index_max_32u(&peak, _gate_scratch.data(), len);
+    const float threshold = _gate_threshold;
+    return _gate_scratch[peak] <= threshold * threshold;
+}
+
+void
+iqin_impl::submit(const gr_complex *iq, int len) {
+    const int gate_min = (int)(_gate_min_silence * _srate);
+    if(gate_min <= 0 && !_gated) {
+        submit_stream(iq, len);
+        return;
+    }
+
+    // Silent blocks past the first gate_min samples of a run are not sent
+    int pending = 0, skipped = 0;
+    for(int pos = 0; pos < len; pos += GATE_BLOCK) {
+        int n = std::min(GATE_BLOCK, len - pos);
+        bool silent = gate_min > 0 && is_silent(iq + pos, n);
+        _silent_run = silent ? _silent_run + n : 0;
+
+        if(silent && _silent_run > gate_min) {
+            if(pending) submit_stream(iq + pos - pending, pending);
+            pending = 0;
+            if(!_gated) start_gate();
+            _gate_skipped += n;
+            skipped += n;
+        } else {
+            if(_gated) end_gate();
+            pending += n;
+        }
+    }
+    if(pending) submit_stream(iq + len - pending, pending);
+
+    gr::thread::scoped_lock lock(_stats_mutex);
+    _gated_samples += skipped;
+}
+
+void
+iqin_impl::start_gate() {
+    gr::thread::scoped_lock lock(_device_mutex);
+
+    // Push out what is queued, the watchdog turns RF off once it has played
+    if(_arbiter->owns(_client)) VSG_CALL(_device, vsgFlush);
+    _gated = true;
+    _gate_resume = std::max(_queue_end, std::chrono::steady_clock::now());
+    _gate_skipped = 0;
+
+    gr::thread::scoped_lock stats_lock(_stats_mutex);
+    _gate_spans++;
+}
+
+void
+iqin_impl::end_gate() {
+    // The next sample is due once the skipped span would have played out.
+    // Work runs ahead of real time while nothing is submitted, so this
+    // normally waits rather than starting late.
+    std::this_thread::sleep_until(_gate_resume +
+        std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::duration<double>(_gate_skipped / _srate)));
+
+    gr::thread::scoped_lock lock(_device_mutex);
+    if(_rf_off) {
+        if(_arbiter->owns(_client)) _device.set_rf_output(true);
+        _rf_off = false;
+    }
+    _gated = false;
+}
+
+void
+iqin_impl::submit_stream(const gr_complex *iq, int len) {
+    gr::thread::scoped_lock device_lock(_device_mutex);
+
+    // Preempted since work() checked, the rest of this call is not output
+    if(!_arbiter->owns(_client)) return;
+
+    // Submitting aborts the repeated waveform and resumes streaming
+    if(_concealing) end_concealment();
+
+    timespec cpu_start, cpu_end;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu_start);
+    auto start = std::chrono::steady_clock::now();
+    bool submitted = _device.submit(iq, len, _queue_end);
+    auto end = std::chrono::steady_clock::now();
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu_end);
+
+    if(!submitted) {
+        // A lost device takes whatever was still queued with it
+        uint64_t dropped = len;
+        if(_device.lost() && _queue_end > start) {
+            dropped += (uint64_t)(std::chrono::duration<double>(_queue_end - start).count() * _srate);
+        }
+        _queue_end = end;
+
+        gr::thread::scoped_lock lock(_stats_mutex);
+        _dropped_samples += dropped;
+        return;
+    }
+    _arbiter->output_started(_client);
+
+    // The device ran dry before this submit if the queue had already ended
+    std::shared_ptr<audit_recorder> recorder = std::atomic_load(&_recorder);
+    if(recorder) {
+        // Digital level changes are setting changes as much as hardware ones
+        double level = _envelope.enabled() ? _record_level : _device.level();
+        recorder->set_settings(_device.frequency(), level, _device.level(), _srate);
+        recorder->record(iq, len, start <= _queue_end);
+    }
+
+    _queue_end = std::max(_queue_end, start) +
+        std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::duration<double>(len / _srate));
+    if(!_ring.empty()) remember(iq, len);
+
+    gr::thread::scoped_lock lock(_stats_mutex);
+    _call_stats.add(std::chrono::duration<double, std::micro>(end - start).count());
+    if(_last_submit_len) {
+        // Ideally submits are spaced by the duration of the previous submit
+        double interval = std::chrono::duration<double, std::micro>(start - _last_submit).count();
+        _jitter_stats.add(interval - _last_submit_len / _srate * 1e6);
+    }
+    _last_submit = start;
+    _last_submit_len = len;
+    _submitted_samples += len;
+    _submit_cpu += (cpu_end.tv_sec - cpu_start.tv_sec) + (cpu_end.tv_nsec - cpu_start.tv_nsec) * 1e-9;
+}
+
+void
+iqin_impl::set_gating(float threshold, double min_silence) {
+    gr::thread::scoped_lock lock(_mutex);
+    _gate_threshold = std::max(threshold, 0.0f);
+    _gate_min_silence = std::max(min_silence, 0.0);
+}
+
+std::map<std::string, double>
+iqin_impl::gating_stats() {
+    gr::thread::scoped_lock lock(_stats_mutex);
+    double total = (double)(_submitted_samples + _gated_samples);
+    double cpu_per_sample = _submitted_samples ? _submit_cpu / _submitted_samples : 0;
+    return {
+        {"spans", (double)_gate_spans},
+        {"gated_samples", (double)_gated_samples},
+        {"usb_bytes_saved", _gated_samples * 2.0 * sizeof(float)},
+        {"usb_fraction_saved", total > 0 ? _gated_samples / total : 0},
+        {"cpu_seconds_saved", _gated_samples * cpu_per_sample}
+    };
+}
+
+void
+iqin_impl::set_underrun_concealment(int samples) {
+    gr::thread::scoped_lock lock(_device_mutex);
+    _ring.assign(std::max(samples, 0), gr_complex(0, 0));
+    _ring_pos = 0;
+    _ring_full = false;
+}
+
+void
+iqin_impl::set_underrun_filler(const std::vector<gr_complex> &filler) {
+    gr::thread::scoped_lock lock(_device_mutex);
+    _filler = filler;
+}
+
+std::map<std::string, double>
+iqin_impl::device_stats() {
+    std::map<std::string, double> stats;
+    {
+        gr::thread::scoped_lock lock(_device_mutex);
+        stats = _device.stats();
+    }
+
+    for(const auto &value : _arbiter->stats()) stats[value.first] = value.second;
+
+    gr::thread::scoped_lock lock(_stats_mutex);
+    stats["dropped_samples"] = (double)_dropped_samples;
+    return stats;
+}
+
+void
+iqin_impl::set_device_priority(int priority) {
+    _arbiter->set_priority(_client, priority);
+}
+
+void
+iqin_impl::set_active(bool active) {
+    {
+        gr::thread::scoped_lock lock(_mutex);
+        _active = active;
+    }
+    // Requests wait for start(), and stop() releases
+    if(_watchdog_running) _arbiter->request(_client, active);
+}
+
+void
+iqin_impl::lose_device() {
+    gr::thread::scoped_lock lock(_device_mutex);
+
+    // The new owner aborted or flushed whatever this block had queued
+    if(_concealing) end_concealment();
+    _playing_file = false;
+    _gated = false;
+    _rf_off = false;
+    _queue_end = std::chrono::steady_clock::now();
+}
+
+bool
+iqin_impl::device_idle() {
+    // Nothing queued and nothing being repeated, and no other block outputting
+    return _arbiter->owns(_client) && !_repeat && !_playing_file && !_concealing &&
+           std::chrono::steady_clock::now() > _queue_end + CONCEAL_MARGIN;
+}
+
+void
+iqin_impl::set_health_monitor(double interval, double recal_threshold) {
+    // Shared by the blocks on the device, the arbiter asks the owner
+    _arbiter->set_health_monitor(_client, interval, recal_threshold,
+        [this]() {
+            return _repeat || _playing_file || device_idle() ||
+                   _queue_end - std::chrono::steady_clock::now() > HEALTH_HEADROOM;
+        },
+        [this](double hold) {
+            // Output stopped at least as long ago as the recalibration
+            // takes, a stream pausing briefly between bursts is left alone
+            return device_idle() &&
+                   std::chrono::steady_clock::now() - _queue_end > std::chrono::duration<double>(hold);
+        },
+        [this](const std::map<std::string, double> &values) {
+            pmt::pmt_t msg = pmt::make_dict();
+            for(const auto &value : values) {
+                msg = pmt::dict_add(msg, pmt::mp(value.first), pmt::from_double(value.second));
+            }
+            message_port_pub(HEALTH_PORT, msg);
+        });
+}
+
+void
+iqin_impl::play_waveform_file(const std::string &path, bool repeat, bool verify) {
+    // Map before taking any lock, verifying reads the whole file
+    std::unique_ptr<waveform_file> waveform;
+    if(!path.empty()) waveform.reset(new waveform_file(path, verify));
+
+    gr::thread::scoped_lock lock(_mutex);
+    gr::thread::scoped_lock device_lock(_device_mutex);
+
+    if(!waveform) {
+        // Back to streaming the input at the block's settings
+        if(_playing_file && _arbiter->owns(_client)) VSG_CALL(_device, vsgAbort);
+        _playing_file = false;
+        _param_changed = true;
+        return;
+    }
+
+    if(!_arbiter->owns(_client)) {
+        throw std::runtime_error("vsg60: cannot play " + path + ", another block has the device");
+    }
+
+    if(_concealing) end_concealment();
+    if(!_device.set_srate(waveform->sample_rate()) && _device.srate() != waveform->sample_rate()) {
+        _device.flush_log();
+        throw std::runtime_error("vsg60: cannot play " + path + ", its sample rate is refused for the USB bus");
+    }
+    _device.set_frequency(waveform->frequency());
+    _device.set_level(waveform->level());
+
+    // Whatever was streaming is aborted by both calls
+    if(repeat) {
+        // The API copies the waveform, the mapping can go afterwards
+        _playing_file = VSG_CALL(_device, vsgRepeatWaveform,
+                                 (float *)waveform->samples(), waveform->length());
+        _arbiter->output_started(_client);
+        _queue_end = std::chrono::steady_clock::now();
+
+        // Streaming resumes at the block's own settings
+        if(!_playing_file) _param_changed = true;
+        return;
+    }
+
+    // Returns once the waveform has played. Only the device stays locked
+    // meanwhile, the block's setters are not held up.
+    _playing_file = false;
+    _param_changed = true;
+    lock.unlock();
+    VSG_CALL(_device, vsgOutputWaveform, (float *)waveform->samples(), waveform->length());
+    _arbiter->output_started(_client);
+    _queue_end = std::chrono::steady_clock::now();
+}
+
+void
+iqin_impl::set_signal_stats(double interval) {
+    gr::thread::scoped_lock lock(_mutex);
+    _signal_interval = std::max(interval, 0.0);
+}
+
+std::map<std::string, double>
+iqin_impl::signal_stats() {
+    gr::thread::scoped_lock lock(_stats_mutex);
+    return _signal_summary;
+}
+
+void
+iqin_impl::publish_signal_stats() {
+    std::vector<float> ccdf;
+    std::map<std::string, double> summary = _signal.summary(ccdf);
+    {
+        gr::thread::scoped_lock lock(_device_mutex);
+        summary["frequency"] = _device.frequency();
+        summary["level"] = _device.level();
+    }
+
+    pmt::pmt_t msg = pmt::make_dict();
+    for(const auto &value : summary) {
+        msg = pmt::dict_add(msg, pmt::mp(value.first), pmt::from_double(value.second));
+    }
+    msg = pmt::dict_add(msg, pmt::mp("ccdf_step"), pmt::from_double(power_stats::CCDF_STEP));
+    msg = pmt::dict_add(msg, pmt::mp("ccdf"), pmt::init_f32vector(ccdf.size(), ccdf));
+    message_port_pub(SIGNAL_PORT, msg);
+
+    gr::thread::scoped_lock lock(_stats_mutex);
+    _signal_summary = summary;
+}
+
+void
+iqin_impl::set_alignment(double delay, double phase) {
+    _alignment.set(delay, phase);
+}
+
+std::map<std::string, double>
+iqin_impl::alignment() {
+    return {
+        {"delay", _alignment.delay()},
+        {"phase", _alignment.phase()}
+    };
+}
+
+void
+iqin_impl::handle_alignment(const pmt::pmt_t &msg) {
+    if(!pmt::is_dict(msg)) {
+        GR_LOG_WARN(d_logger, "Alignment message is not a dict, ignored");
+        return;
+    }
+
+    // Either key may be left out to keep its current setting
+    auto value = [&msg](const char *key, double current) {
+        pmt::pmt_t v = pmt::dict_ref(msg, pmt::mp(key), pmt::PMT_NIL);
+        return pmt::is_real(v) || pmt::is_integer(v) ? pmt::to_double(v) : current;
+    };
+    _alignment.set(value("delay", _alignment.delay()), value("phase", _alignment.phase()));
+}
+
+void
+iqin_impl::set_level_automation(double range) {
+    gr::thread::scoped_lock lock(_mutex);
+    double level = _envelope.enable(_level, range);
+
+    // Turned off, the level reached digitally is set on the hardware
+    if(range <= 0 && level != _level) {
+        _level = level;
+        _param_changed = true;
+    }
+}
+
+void
+iqin_impl::set_level_ramp(double level, double seconds) {
+    if(!_envelope.enabled()) {
+        set_level(level);
+        return;
+    }
+    _envelope.schedule(0, level, (int64_t)std::llround(seconds * _srate));
+}
+
+void
+iqin_impl::set_level_profile(const std::vector<double> &levels, double interval, bool repeat) {
+    if(!_envelope.enabled()) {
+        GR_LOG_WARN(d_logger, "Level profile ignored, level automation is off");
+        return;
+    }
+    _envelope.set_profile(levels, (int64_t)std::llround(interval * _srate), repeat);
+}
+
+std::map<std::string, double>
+iqin_impl::level_stats() {
+    return _envelope.stats();
+}
+
+void
+iqin_impl::set_bus_capacity(double bytes_per_second, bool refuse) {
+    bus_governor::get().set_capacity(bytes_per_second, refuse);
+}
+
+std::map<std::string, double>
+iqin_impl::bus_stats() {
+    return bus_governor::get().stats();
+}
+
+void
+iqin_impl::handle_level(const pmt::pmt_t &msg) {
+    // A bare number steps, a dict may add a "ramp" in seconds
+    pmt::pmt_t level = msg, ramp = pmt::PMT_NIL;
+    if(pmt::is_dict(msg)) {
+        level = pmt::dict_ref(msg, pmt::mp("level"), pmt::PMT_NIL);
+        ramp = pmt::dict_ref(msg, pmt::mp("ramp"), pmt::PMT_NIL);
+    }
+    if(!pmt::is_real(level) && !pmt::is_integer(level)) {
+        GR_LOG_WARN(d_logger, "Level message has no level, ignored");
+        return;
+    }
+
+    double seconds = pmt::is_real(ramp) || pmt::is_integer(ramp) ? pmt::to_double(ramp) : 0;
+    set_level_ramp(pmt::to_double(level), seconds);
+}
+
+void
+iqin_impl::relevel(double level) {
+    {
+        gr::thread::scoped_lock lock(_device_mutex);
+        if(!_arbiter->owns(_client)) return;
+
+        // The API scales I/Q by this at the new level, the rest is headroom
+        double scale = 0;
+        if(!_device.set_level(level) || !VSG_CALL(_device, vsgGetIQScale, &scale)) return;
+        _envelope.set_hardware(level, scale > 0 ? -20 * std::log10(scale) : 0);
+    }
+
+    // Restored with the rest of the settings on a handover or reconnect
+    gr::thread::scoped_lock lock(_mutex);
+    _level = level;
+}
+
+void
+iqin_impl::set_audit_recording(const std::string &path, int queue_blocks) {
+    gr::thread::scoped_lock lock(_mutex);
+
+    // work() holds the recorder only with the device mutex held, so once
+    // swapped out under it the last reference is this one. The old
+    // recording is closed here, never on the submitting thread, and before
+    // a new one is opened.
+    std::shared_ptr<audit_recorder> old;
+    {
+        gr::thread::scoped_lock device_lock(_device_mutex);
+        old = std::atomic_exchange(&_recorder, std::shared_ptr<audit_recorder>());
+    }
+    old.reset();
+    if(path.empty()) return;
+
+    std::atomic_store(&_recorder, std::make_shared<audit_recorder>(path, queue_blocks));
+}
+
+std::map<std::string, double>
+iqin_impl::audit_stats() {
+    std::shared_ptr<audit_recorder> recorder = std::atomic_load(&_recorder);
+    if(!recorder) return std::map<std::string, double>();
+    return recorder->stats();
+}
+
+bool
+iqin_impl::dump_trace(const std::string &path) {
+#ifdef VSG60_TRACING
+    return trace::dump(path);
+#else
+    return false;
+#endif
+}
+
+std::map<std::string, double>
+iqin_impl::health() {
+    return _arbiter->health();
+}
+
+double
+iqin_impl::health_value(const std::string &key) {
+    std::map<std::string, double> values = health();
+    auto it = values.find(key);
+    return it == values.end() ? 0 : it->second;
+}
+
+double iqin_impl::temperature() { return health_value("temperature"); }
+double iqin_impl::usb_ok() { return health_value("usb_ok"); }
+double iqin_impl::cal_date() { return health_value("cal_date"); }
+double iqin_impl::rf_output() { return health_value("rf_output"); }
+
+void
+iqin_impl::setup_rpc() {
+#ifdef GR_CTRLPORT
+    add_rpc_variable(rpcbasic_sptr(new rpcbasic_register_get<iqin_impl, double>(
+        alias(), "temperature", &iqin_impl::temperature,
+        pmt::mp(-40.0), pmt::mp(125.0), pmt::mp(0.0),
+        "C", "Device temperature", RPC_PRIVLVL_MIN, DISPTIME | DISPOPTSTRIP)));
+    add_rpc_variable(rpcbasic_sptr(new rpcbasic_register_get<iqin_impl, double>(
+        alias(), "usb_ok", &iqin_impl::usb_ok,
+        pmt::mp(0.0), pmt::mp(1.0), pmt::mp(0.0),
+        "", "USB status good", RPC_PRIVLVL_MIN, DISPTIME | DISPOPTSTRIP)));
+    add_rpc_variable(rpcbasic_sptr(new rpcbasic_register_get<iqin_impl, double>(
+        alias(), "cal_date", &iqin_impl::cal_date,
+        pmt::mp(0.0), pmt::mp(4294967295.0), pmt::mp(0.0),
+        "s", "Calibration date, seconds since the epoch", RPC_PRIVLVL_MIN, DISPNULL)));
+    add_rpc_variable(rpcbasic_sptr(new rpcbasic_register_get<iqin_impl, double>(
+        alias(), "rf_output", &iqin_impl::rf_output,
+        pmt::mp(0.0), pmt::mp(1.0), pmt::mp(0.0),
+        "", "RF output enabled", RPC_PRIVLVL_MIN, DISPTIME | DISPOPTSTRIP)));
+#endif
+}
+
+std::map<std::string, double>
+iqin_impl::underrun_stats() {
+    gr::thread::scoped_lock lock(_device_mutex);
+    return {
+        {"count", (double)_conceal_count},
+        {"duration", _conceal_time}
+    };
+}
+
+void
+iqin_impl::remember(const gr_complex *iq, int len) {
+    // Only the newest samples can survive in the ring
+    const int size = (int)_ring.size();
+    if(len > size) {
+        iq += len - size;
+        len = size;
+    }
+
+    int first = std::min(len, size - _ring_pos);
+    std::copy(iq, iq + first, _ring.begin() + _ring_pos);
+    std::copy(iq + first, iq + len, _ring.begin());
+
+    if(_ring_pos + len >= size) _ring_full = true;
+    _ring_pos = (_ring_pos + len) % size;
+}
+
+void
+iqin_impl::end_concealment() {
+    std::chrono::duration<double> concealed = std::chrono::steady_clock::now() - _conceal_start;
+    _conceal_time += concealed.count();
+    _concealing = false;
+}
+
+void
+iqin_impl::watchdog() {
+    auto next_poll = std::chrono::steady_clock::now();
+
+    while(_watchdog_running) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+        // Messages from the streaming path are written here, off that thread
+        _device.flush_log();
+
+        // A busy device mutex means work() is submitting, so there is input
+        gr::thread::scoped_lock lock(_device_mutex, boost::try_to_lock);
+        if(!lock.owns_lock()) continue;
+
+        // Catch a lost device while no submit is failing, e.g. when gated
+        if(std::chrono::steady_clock::now() >= next_poll) {
+            next_poll = std::chrono::steady_clock::now() + USB_POLL_INTERVAL;
+            if(!_device.poll()) continue;
+        }
+
+        // Concealment and gating only apply to this block's own output
+        if(!_arbiter->owns(_client)) continue;
+
+        // Gated spans are silence by design, turn RF off once the queue drains
+        if(_gated) {
+            if(!_rf_off && std::chrono::steady_clock::now() > _queue_end + CONCEAL_MARGIN) {
+                _device.set_rf_output(false);
+                _rf_off = true;
+            }
+            continue;
+        }
+
+        if(_concealing || _repeat || _playing_file) continue;
+        if(_ring.empty() || (!_ring_full && _ring_pos == 0)) continue;
+
+        if(std::chrono::steady_clock::now() + CONCEAL_MARGIN < _queue_end) continue;
+
+        // Oldest to newest, so the loop plays the history in order
+        if(!_filler.empty()) {
+            _conceal_buffer = _filler;
+        } else if(_ring_full) {
+            _conceal_buffer.assign(_ring.begin() + _ring_pos, _ring.end());
+            _conceal_buffer.insert(_conceal_buffer.end(), _ring.begin(), _ring.begin() + _ring_pos);
+        } else {
+            _conceal_buffer.assign(_ring.begin(), _ring.begin() + _ring_pos);
+        }
+
+        if(!VSG_CALL(_device, vsgRepeatWaveform, (float *)_conceal_buffer.data(),
+                     (int)_conceal_buffer.size())) continue;
+        _concealing = true;
+        _conceal_start = std::chrono::steady_clock::now();
+        _conceal_count++;
+    }
+}
+
+bool
+iqin_impl::start() {
+    _watchdog_running = true;
+    _watchdog.reset(new gr::thread::thread([this]() { watchdog(); }));
+
+    bool active;
+    {
+        gr::thread::scoped_lock lock(_mutex);
+        active = _active;
+    }
+    if(active) _arbiter->request(_client, true);
+    return true;
+}
+
+bool
+iqin_impl::stop() {
+    _watchdog_running = false;
+    if(_watchdog) {
+        _watchdog->join();
+        _watchdog.reset();
+    }
+
+    {
+        gr::thread::scoped_lock lock(_device_mutex);
+        if(_concealing) end_concealment();
+        if(_rf_off) {
+            if(_arbiter->owns(_client)) _device.set_rf_output(true);
+            _rf_off = false;
+        }
+        _gated = false;
+    }
+    // Another block waiting for the device takes over once this one's queue plays
+    _arbiter->request(_client, false);
+    _owner = false;
+    _device.flush_log();
+
+    if(_gate_spans) {
+        std::map<std::string, double> gating = gating_stats();
+        GR_LOG_INFO(d_logger, "Gated spans: " << _gate_spans
+                    << ", USB traffic saved " << 100 * gating["usb_fraction_saved"] << "%"
+                    << ", submit CPU saved " << gating["cpu_seconds_saved"] << " s");
+    }
+    if(_conceal_count) {
+        GR_LOG_INFO(d_logger, "Underruns concealed: " << _conceal_count
+                    << ", " << _conceal_time << " s");
+    }
+
+    std::map<std::string, double> device = device_stats();
+    if(device["errors"] > 0) {
+        GR_LOG_WARN(d_logger, "Device errors: " << device["errors"]
+                    << ", reconnects " << device["reconnects"]
+                    << ", downtime " << device["downtime"] << " s"
+                    << ", dropped samples " << device["dropped_samples"]);
+    }
+    if(device["handovers"] > 0) {
+        GR_LOG_INFO(d_logger, "Device handovers: " << device["handovers"]
+                    << ", preemptions " << device["preemptions"]
+                    << ", gap mean " << device["gap_mean"] << " s"
+                    << ", max " << device["gap_max"] << " s");
+    }
+
+    std::map<std::string, double> stats = submit_stats();
+    if(stats["count"] > 0) {
+        GR_LOG_INFO(d_logger, "Submit calls: " << stats["count"]
+                    << ", mean " << stats["call_mean"] << " us"
+                    << ", max " << stats["call_max"] << " us"
+                    << ", jitter rms " << stats["jitter_rms"] << " us");
+    }
+    return true;
+}
+
 void
 iqin_impl::configure() {
     gr::thread::scoped_lock lock(_mutex);
+    gr::thread::scoped_lock device_lock(_device_mutex);
+
+    // Configure, once this block has the device
+    if(_arbiter->owns(_client)) {
+        _device.set_frequency(_frequency);
+        _device.set_level(_level);
+        if(!_device.set_srate(_srate) && _device.srate() != _srate) {
+            // Refused for the USB bus, pace and measure at the rate the
+            // device still runs at
+            double srate = _device.srate();
+            if(std::isnan(srate)) VSG_CALL(_device, vsgGetSampleRate, &srate);
+            if(!std::isnan(srate)) {
+                _device.queue_log(true, "Sample rate " + std::to_string(_srate / 1e6) +
+                                  " MS/s refused, staying at " + std::to_string(srate / 1e6) + " MS/s");
+                _srate = srate;
+            }
+        }
+    }
+
+    _correction.set_frequency(_frequency);
+}
+
+void
+iqin_impl::set_start_time(double seconds) {
+    gr::thread::scoped_lock lock(_mutex);
+    _start_pending = seconds > 0;
+    _start_time = seconds;
+}
+
+void
+iqin_impl::set_trigger_length(double seconds) {
+    gr::thread::scoped_lock lock(_device_mutex);
+    _device.set_trigger_length(seconds);
+}
 
-    // Configure
-    ERROR_CHECK(vsgSetFrequency(_handle, _frequency));
-    ERROR_CHECK(vsgSetLevel(_handle, _level));
-    ERROR_CHECK(vsgSetSampleRate(_handle, _srate));
+std::chrono::steady_clock::time_point
+iqin_impl::host_deadline(double seconds) {
+    // Deadlines are wall clock, waiting is done on the steady clock
+    std::chrono::duration<double> until = std::chrono::duration<double>(seconds) -
+        std::chrono::system_clock::now().time_since_epoch();
+    return std::chrono::steady_clock::now() +
+        std::chrono::duration_cast<std::chrono::steady_clock::duration>(until);
+}
+
+void
+iqin_impl::collect_events(int noutput_items) {
+    _events.clear();
+
+    if(_start_pending) {
+        gr::thread::scoped_lock lock(_mutex);
+        _events.push_back({0, false, host_deadline(_start_time), false});
+        _start_pending = false;
+    }
+
+    std::vector<gr::tag_t> tags;
+    get_tags_in_range(tags, 0, nitems_read(0), nitems_read(0) + noutput_items);
+    for(const gr::tag_t &tag : tags) {
+        int offset = (int)(tag.offset - nitems_read(0));
+
+        if(pmt::eq(tag.key, TX_TIME_KEY) && pmt::is_tuple(tag.value)) {
+            double seconds = pmt::to_uint64(pmt::tuple_ref(tag.value, 0)) +
+                             pmt::to_double(pmt::tuple_ref(tag.value, 1));
+            _events.push_back({offset, false, host_deadline(seconds), false});
+        } else if(pmt::eq(tag.key, TRIGGER_KEY)) {
+            _events.push_back({offset, true, std::chrono::steady_clock::time_point(), false});
+        } else if(pmt::eq(tag.key, LEVEL_KEY)) {
+            // A level, or a pair of level and ramp seconds
+            pmt::pmt_t level = tag.value, ramp = pmt::PMT_NIL;
+            if(pmt::is_pair(tag.value)) {
+                level = pmt::car(tag.value);
+                ramp = pmt::cdr(tag.value);
+            } else if(pmt::is_tuple(tag.value) && pmt::length(tag.value) == 2) {
+                level = pmt::tuple_ref(tag.value, 0);
+                ramp = pmt::tuple_ref(tag.value, 1);
+            }
+            if(pmt::is_real(level) || pmt::is_integer(level)) {
+                double seconds = pmt::is_real(ramp) || pmt::is_integer(ramp) ? pmt::to_double(ramp) : 0;
+                _envelope.schedule(tag.offset, pmt::to_double(level),
+                                   (int64_t)std::llround(seconds * _srate));
+            }
+        }
+    }
+
+    // Periodic latency markers
+    if(std::atomic_load(&_probe)) {
+        if(_marker_reset.exchange(false)) _marker_countdown = 0;
+        while(_marker_countdown < noutput_items) {
+            _events.push_back({(int)_marker_countdown, true,
+                               std::chrono::steady_clock::time_point(), true});
+            _marker_countdown += std::max<int64_t>(1, (int64_t)(_marker_interval * _srate));
+        }
+        _marker_countdown -= noutput_items;
+    }
+
+    std::stable_sort(_events.begin(), _events.end(), [](const tx_event &l, const tx_event &r) {
+        return l.offset < r.offset;
+    });
+    _next_event = 0;
+}
+
+void
+iqin_impl::deliver(int start, int len) {
+    // Split the range at each event so it lands on the exact sample
+    const uint64_t base = nitems_read(0);
+    const int end = start + len;
+    while(start < end) {
+        int split = end;
+        if(_next_event < _events.size()) {
+            split = std::min(end, std::max(start, _events[_next_event].offset));
+        }
+
+        // And at each digital level change, which starts a recorded capture
+        if(_envelope.enabled()) {
+            uint64_t change = _envelope.level_at(base + start, _record_level);
+            if(change < base + split) split = (int)(change - base);
+        }
+
+        if(split > start) {
+            submit(_buffer + start, split - start);
+            start = split;
+            continue;
+        }
+
+        const tx_event &event = _events[_next_event++];
+        if(event.trigger) {
+            {
+                gr::thread::scoped_lock lock(_device_mutex);
+                if(_arbiter->owns(_client)) VSG_CALL(_device, vsgSubmitTrigger);
+            }
+            if(event.marker) mark_latency();
+        } else {
+            hold_until(event.deadline);
+        }
+    }
+}
+
+void
+iqin_impl::hold_until(std::chrono::steady_clock::time_point deadline) {
+    // A timed start always leaves any gated span immediately
+    if(_gated) {
+        _gate_skipped = 0;
+        end_gate();
+    }
+
+    // Wait until shortly before the deadline, then pad the queue with zeros
+    // so the next sample plays when it is due
+    std::this_thread::sleep_until(deadline - PREFILL_LEAD);
+
+    auto queue_start = std::max(_queue_end, std::chrono::steady_clock::now());
+    int64_t pad = (int64_t)(std::chrono::duration<double>(deadline - queue_start).count() * _srate);
+    if(pad < 0) {
+        _device.queue_log(false, "Timed transmission late by " + std::to_string(-pad / _srate) + " s");
+        return;
+    }
+
+    if(_zeros.empty()) _zeros.assign(PARALLEL_CHUNK, gr_complex(0, 0));
+    while(pad > 0) {
+        int n = (int)std::min<int64_t>(pad, _zeros.size());
+        submit_stream(_zeros.data(), n);
+        pad -= n;
+    }
+}
+
+void
+iqin_impl::set_latency_probe(double interval, int udp_port, double max_latency, int bins) {
+    gr::thread::scoped_lock lock(_mutex);
+
+    if(interval <= 0) {
+        std::atomic_store(&_probe, std::shared_ptr<latency_probe>());
+        return;
+    }
+
+    // Built first, a rejected setting leaves the current probe running
+    std::shared_ptr<latency_probe> probe = std::make_shared<latency_probe>(udp_port, max_latency, bins,
+        [this](uint64_t seq, double latency) {
+            pmt::pmt_t msg = pmt::make_dict();
+            msg = pmt::dict_add(msg, pmt::mp("seq"), pmt::from_uint64(seq));
+            msg = pmt::dict_add(msg, pmt::mp("latency"), pmt::from_double(latency));
+            message_port_pub(LATENCY_PORT, msg);
+        });
+    _marker_interval = interval;
+    _marker_reset = true;
+    std::atomic_store(&_probe, probe);
+}
+
+std::vector<uint64_t>
+iqin_impl::latency_histogram(bool measured) {
+    std::shared_ptr<latency_probe> probe = std::atomic_load(&_probe);
+    if(!probe) return std::vector<uint64_t>();
+    return measured ? probe->measured_histogram() : probe->estimated_histogram();
+}
+
+std::map<std::string, double>
+iqin_impl::latency_stats() {
+    std::shared_ptr<latency_probe> probe = std::atomic_load(&_probe);
+    if(!probe) return std::map<std::string, double>();
+    return probe->stats();
+}
+
+void
+iqin_impl::mark_latency() {
+    std::shared_ptr<latency_probe> probe = std::atomic_load(&_probe);
+    if(!probe) return;
+
+    // The marker plays once everything queued ahead of it has played
+    std::chrono::duration<double> depth =
+        std::max(_queue_end, std::chrono::steady_clock::now()) - std::chrono::steady_clock::now();
+    double wall = std::chrono::duration<double>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+
+    uint64_t seq = probe->mark(_work_enter, wall + depth.count(), depth.count() * _srate);
+
+    pmt::pmt_t msg = pmt::make_dict();
+    msg = pmt::dict_add(msg, pmt::mp("seq"), pmt::from_uint64(seq));
+    msg = pmt::dict_add(msg, pmt::mp("estimated"), pmt::from_double(wall + depth.count() - _work_enter));
+    msg = pmt::dict_add(msg, pmt::mp("queue_depth"), pmt::from_double(depth.count() * _srate));
+    message_port_pub(LATENCY_PORT, msg);
 }
 
 int iqin_impl::work(int noutput_items,
                     gr_vector_const_void_star& input_items,
                     gr_vector_void_star& output_items)
 {
-    auto in = static_cast<const input_type*>(input_items[0]);
+    // Skip the history kept for the correction filter
+    auto in = static_cast<const input_type*>(input_items[0]) + (history() - 1);
+
+    _work_enter = std::chrono::duration<double>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+
+    if(_thread_changed.exchange(false)) {
+        apply_thread_settings();
+    }
 
-    // Initiate new configuration if necessary
-    if(_param_changed) {
+    // Another block has the device, keep pace with real time without output
+    if(!_arbiter->owns(_client)) {
+        if(_owner) lose_device();
+        _owner = false;
+        std::this_thread::sleep_for(std::chrono::duration<double>(noutput_items / _srate));
+        return noutput_items;
+    }
+    if(!_owner) {
+        // The previous owner left its own settings on the device
+        _owner = true;
+        _param_changed = true;
+    }
+
+    // Initiate new configuration if necessary, summaries never span a retune
+    if(_param_changed.exchange(false)) {
+        if(_signal.samples()) publish_signal_stats();
         configure();
-        _param_changed = false;
+    }
+
+    // A repeating waveform file replaces the input, which keeps pace with
+    // real time as it is discarded
+    if(_playing_file) {
+        std::this_thread::sleep_for(std::chrono::duration<double>(noutput_items / _srate));
+        return noutput_items;
     }
 
     // Allocate memory if necessary
@@ -114,16 +1165,64 @@ int iqin_impl::work(int noutput_items,
         _len = noutput_items;
     }
 
-    // Move data to input buffer
-    for(int i = 0; i < noutput_items; i++) {
-        _buffer[i] = in[i];
+    // One mode for the whole call, set_repeat() takes effect on the next
+    const bool repeat = _repeat;
+    if(!repeat) {
+        collect_events(noutput_items);
+
+        // Before the samples that need it, queued ones play at the new level
+        double level;
+        if(_envelope.hardware_needed(level)) relevel(level);
     }
+    const double signal_interval = _signal_interval;
+    const bool measure = signal_interval > 0;
 
-    // Generate signal from I/Q waveform
-    if(_repeat) {
-        ERROR_CHECK(vsgRepeatWaveform(_handle, (float *)_buffer, noutput_items));
+    // Move data to input buffer, applying calibration corrections. Large
+    // chunks are split across the pool and streamed out as ranges complete.
+    if(_pool && noutput_items >= 2 * PARALLEL_CHUNK) {
+        _pool->run_ordered(noutput_items, PARALLEL_CHUNK,
+            [this, in](int start, int len, int worker) {
+                _correction.process(in + start, _buffer + start, len, worker);
+            },
+            [this, repeat, measure](int start, int len) {
+                // Measured as transmitted, after the level and alignment
+                if(!repeat) {
+                    _envelope.process(_buffer + start, len, nitems_read(0) + start);
+                    _alignment.process(_buffer + start, len);
+                }
+                if(measure) _signal.add(_buffer + start, len);
+                if(!repeat) deliver(start, len);
+            });
     } else {
-        ERROR_CHECK(vsgSubmitIQ(_handle, (float *)_buffer, noutput_items));
+        _correction.process(in, _buffer, noutput_items);
+        if(!repeat) {
+            _envelope.process(_buffer, noutput_items, nitems_read(0));
+            _alignment.process(_buffer, noutput_items);
+        }
+        if(measure) _signal.add(_buffer, noutput_items);
+        if(!repeat) deliver(0, noutput_items);
+    }
+
+    if(measure) {
+        _signal.collect();
+        if(_signal.samples() >= signal_interval * _srate) publish_signal_stats();
+    }
+
+    // Generate signal from I/Q waveform
+    if(repeat) {
+        gr::thread::scoped_lock lock(_device_mutex);
+        if(!_arbiter->owns(_client) ||
+           !VSG_CALL(_device, vsgRepeatWaveform, (float *)_buffer, noutput_items)) {
+            return noutput_items;
+        }
+        _arbiter->output_started(_client);
+
+        // Each new repeated waveform is its own capture
+        std::shared_ptr<audit_recorder> recorder = std::atomic_load(&_recorder);
+        if(recorder) {
+            recorder->set_settings(_device.frequency(), _device.level(), _device.level(), _srate);
+            recorder->record(_buffer, noutput_items, false);
+        }
     }
 
     return noutput_items;
@@ -9,7 +9,22 @@
 #define INCLUDED_VSG60_IQIN_IMPL_H
 
 #include <vsg60/iqin.h>
-#include <vsg60/vsg_api.h>
+#include "arbiter.h"
+#include "audit_recorder.h"
+#include "bus_governor.h"
+#include "fractional_delay.h"
+#include "iq_correction.h"
+#include "latency_probe.h"
+#include "level_envelope.h"
+#include "waveform_file.h"
+#include "running_stats.h"
+#include "power_stats.h"
+#include "worker_pool.h"
+
+#include <volk/volk_alloc.hh>
+
+#include <atomic>
+#include <chrono>
 
 namespace gr {
 namespace vsg60 {
@@ -17,21 +32,139 @@ namespace vsg60 {
 class iqin_impl : public iqin
 {
 private:
-      int _handle;
+      // Shared with other blocks on the same device
+      std::shared_ptr<arbiter> _arbiter;
+      device &_device;
+      int _client;
+      bool _active;
+      // Owned the device in the last work() call
+      bool _owner;
 
       double _frequency;
       double _level;
-      double _srate;
-      bool _repeat;
+      // Set under _mutex, read by work() and the watchdog
+      std::atomic<double> _srate;
+      std::atomic<bool> _repeat;
 
       gr::thread::mutex _mutex;
-      bool _param_changed;
+      std::atomic<bool> _param_changed;
 
       std::complex<float> *_buffer;
       int _len;
 
+      iq_correction _correction;
+      // Inter-device alignment trim, applied in delivery order
+      fractional_delay _alignment;
+      // Digital level automation, applied with the alignment
+      level_envelope _envelope;
+      // Level in effect at the sample being delivered, for the recorder
+      double _record_level;
+      std::unique_ptr<worker_pool> _pool;
+
+      // Submit thread settings, applied from work()
+      std::vector<int> _submit_affinity;
+      int _submit_priority;
+      std::atomic<bool> _thread_changed;
+      bool _rt_applied;
+
+      gr::thread::mutex _stats_mutex;
+      running_stats _call_stats;
+      running_stats _jitter_stats;
+      std::chrono::steady_clock::time_point _last_submit;
+      int _last_submit_len;
+
+      // Serializes API calls between work(), the watchdog and other blocks
+      gr::thread::mutex &_device_mutex;
+      // Host estimate of when the device will have played everything submitted
+      std::chrono::steady_clock::time_point _queue_end;
+
+      // Underrun concealment
+      std::vector<gr_complex> _ring;
+      int _ring_pos;
+      bool _ring_full;
+      std::vector<gr_complex> _filler;
+      std::vector<gr_complex> _conceal_buffer;
+      bool _concealing;
+      std::chrono::steady_clock::time_point _conceal_start;
+      uint64_t _conceal_count;
+      double _conceal_time;
+      std::unique_ptr<gr::thread::thread> _watchdog;
+      std::atomic<bool> _watchdog_running;
+
+      // Silence gating, settings set under _mutex and read by work()
+      std::atomic<float> _gate_threshold;
+      std::atomic<double> _gate_min_silence;
+      volk::vector<float> _gate_scratch;
+      int _silent_run;
+      bool _gated;
+      bool _rf_off;
+      std::chrono::steady_clock::time_point _gate_resume;
+      uint64_t _gate_skipped;
+      uint64_t _gate_spans;
+      uint64_t _gated_samples;
+      uint64_t _submitted_samples;
+      // Lost to failed submits and reconnects
+      uint64_t _dropped_samples;
+      double _submit_cpu;
+
+      // Timed transmission and trigger events in the current work() call
+      struct tx_event {
+          int offset;
+          bool trigger;
+          std::chrono::steady_clock::time_point deadline;
+          // Trigger inserted by the latency probe
+          bool marker;
+      };
+      std::vector<tx_event> _events;
+      size_t _next_event;
+      std::atomic<bool> _start_pending;
+      double _start_time;
+      std::vector<gr_complex> _zeros;
+
+      // Transmitted signal statistics
+      power_stats _signal;
+      std::atomic<double> _signal_interval;
+      std::map<std::string, double> _signal_summary;
+
+      // Transmit audit recording, work() holds it only under _device_mutex
+      std::shared_ptr<audit_recorder> _recorder;
+
+      // A waveform file is repeating and input is discarded
+      std::atomic<bool> _playing_file;
+
+      // Latency measurement
+      std::shared_ptr<latency_probe> _probe;
+      // Set under _mutex, read by work()
+      std::atomic<double> _marker_interval;
+      std::atomic<bool> _marker_reset;
+      int64_t _marker_countdown;
+      double _work_enter;
+
+      void apply_thread_settings();
+      void submit(const gr_complex *iq, int len);
+      void submit_stream(const gr_complex *iq, int len);
+      bool is_silent(const gr_complex *iq, int len);
+      void start_gate();
+      void end_gate();
+      std::chrono::steady_clock::time_point host_deadline(double seconds);
+      void collect_events(int noutput_items);
+      void deliver(int start, int len);
+      void hold_until(std::chrono::steady_clock::time_point deadline);
+      void mark_latency();
+      void publish_signal_stats();
+      void remember(const gr_complex *iq, int len);
+      void end_concealment();
+      void lose_device();
+      void watchdog();
+      bool device_idle();
+      double health_value(const std::string &key);
+      void handle_alignment(const pmt::pmt_t &msg);
+      void handle_level(const pmt::pmt_t &msg);
+      void relevel(double level);
+
 public:
-    iqin_impl(double frequency, double level, double srate, bool repeat);
+    iqin_impl(double frequency, double level, double srate, bool repeat,
+              const std::string &cal_file, int threads, int serial);
     ~iqin_impl();
 
       void set_frequency(double frequency);
@@ -39,8 +172,68 @@ public:
       void set_srate(double srate);
       void set_repeat(bool repeat);
 
+      void set_submit_affinity(const std::vector<int> &cpus);
+      void set_submit_priority(int priority);
+      void set_power_saving(bool enabled);
+
+      std::map<std::string, double> submit_stats();
+      void reset_submit_stats();
+
+      void set_underrun_concealment(int samples);
+      void set_underrun_filler(const std::vector<gr_complex> &filler);
+      std::map<std::string, double> underrun_stats();
+
+      void set_gating(float threshold, double min_silence);
+      std::map<std::string, double> gating_stats();
+
+      void set_start_time(double seconds);
+      void set_trigger_length(double seconds);
+
+      void set_latency_probe(double interval, int udp_port, double max_latency, int bins);
+      std::vector<uint64_t> latency_histogram(bool measured);
+      std::map<std::string, double> latency_stats();
+
+      std::map<std::string, double> device_stats();
+
+      void set_device_priority(int priority);
+      void set_active(bool active);
+
+      void set_health_monitor(double interval, double recal_threshold);
+      std::map<std::string, double> health();
+
+      bool dump_trace(const std::string &path);
+
+      void play_waveform_file(const std::string &path, bool repeat, bool verify);
+
+      void set_signal_stats(double interval);
+      std::map<std::string, double> signal_stats();
+
+      void set_alignment(double delay, double phase);
+      std::map<std::string, double> alignment();
+
+      void set_level_automation(double range);
+      void set_level_ramp(double level, double seconds);
+      void set_level_profile(const std::vector<double> &levels, double interval, bool repeat);
+      std::map<std::string, double> level_stats();
+
+      void set_bus_capacity(double bytes_per_second, bool refuse);
+      std::map<std::string, double> bus_stats();
+
+      void set_audit_recording(const std::string &path, int queue_blocks);
+      std::map<std::string, double> audit_stats();
+
+      // ControlPort getters
+      double temperature();
+      double usb_ok();
+      double cal_date();
+      double rf_output();
+      void setup_rpc();
+
       void configure();
 
+      bool start();
+      bool stop();
+
     int work(int noutput_items,
              gr_vector_const_void_star& input_items,
              gr_vector_void_star& output_items);
@@ -0,0 +1,152 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2022 Signal Hound.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "latency_probe.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+
+namespace gr {
+namespace vsg60 {
+
+// Markers older than this many sequence numbers are given up on
+static const uint64_t MAX_PENDING = 1024;
+
+latency_probe::latency_probe(int udp_port, double max_latency, int bins,
+                             const measured_fn &measured)
+    : _socket(-1),
+    _max_latency(max_latency),
+    _measured(measured),
+    _next_seq(0),
+    _running(false)
+{
+    if(!(max_latency > 0) || bins <= 0) {
+        throw std::invalid_argument("vsg60: latency histogram needs a positive range and bin count");
+    }
+    _measured_hist.assign(bins, 0);
+    _estimated_hist.assign(bins, 0);
+
+    if(udp_port <= 0) return;
+
+    _socket = socket(AF_INET, SOCK_DGRAM, 0);
+    if(_socket < 0) {
+        throw std::runtime_error("vsg60: unable to create latency probe socket");
+    }
+
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(udp_port);
+    if(bind(_socket, (sockaddr *)&addr, sizeof(addr)) < 0) {
+        close(_socket);
+        throw std::runtime_error("vsg60: unable to bind latency probe port " + std::to_string(udp_port));
+    }
+
+    // Wake periodically so the thread notices shutdown
+    timeval timeout = {0, 100000};
+    setsockopt(_socket, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    _running = true;
+    _thread.reset(new gr::thread::thread([this]() { receive(); }));
+}
+
+latency_probe::~latency_probe()
+{
+    _running = false;
+    if(_thread) _thread->join();
+    if(_socket >= 0) close(_socket);
+}
+
+void
+latency_probe::add(std::vector<uint64_t> &hist, double latency) {
+    int bin = (int)(latency / _max_latency * hist.size());
+    hist[std::max(0, std::min(bin, (int)hist.size() - 1))]++;
+}
+
+uint64_t
+latency_probe::mark(double enter_time, double play_time, double queue_depth) {
+    gr::thread::scoped_lock lock(_mutex);
+
+    uint64_t seq = _next_seq++;
+    if(_socket >= 0) {
+        _pending[seq] = enter_time;
+        while(_pending.size() > MAX_PENDING) _pending.erase(_pending.begin());
+    }
+
+    add(_estimated_hist, play_time - enter_time);
+    _estimated_stats.add(play_time - enter_time);
+    _queue_stats.add(queue_depth);
+    return seq;
+}
+
+void
+latency_probe::receive() {
+    char datagram[128];
+
+    while(_running) {
+        ssize_t n = recv(_socket, datagram, sizeof(datagram) - 1, 0);
+        if(n <= 0) continue;
+        datagram[n] = 0;
+
+        unsigned long long seq;
+        double external;
+        if(sscanf(datagram, "%llu %lf", &seq, &external) != 2) continue;
+
+        double latency;
+        {
+            gr::thread::scoped_lock lock(_mutex);
+            auto it = _pending.find(seq);
+            if(it == _pending.end()) continue;
+
+            latency = external - it->second;
+            _pending.erase(it);
+            add(_measured_hist, latency);
+            _measured_stats.add(latency);
+        }
+
+        if(_measured) _measured(seq, latency);
+    }
+}
+
+std::vector<uint64_t>
+latency_probe::measured_histogram() {
+    gr::thread::scoped_lock lock(_mutex);
+    return _measured_hist;
+}
+
+std::vector<uint64_t>
+latency_probe::estimated_histogram() {
+    gr::thread::scoped_lock lock(_mutex);
+    return _estimated_hist;
+}
+
+std::map<std::string, double>
+latency_probe::stats() {
+    gr::thread::scoped_lock lock(_mutex);
+    return {
+        {"markers", (double)_next_seq},
+        {"measured", (double)_measured_stats.count()},
+        {"measured_mean", _measured_stats.mean()},
+        {"measured_min", _measured_stats.min()},
+        {"measured_max", _measured_stats.max()},
+        {"estimated_mean", _estimated_stats.mean()},
+        {"estimated_max", _estimated_stats.max()},
+        {"queue_depth_mean", _queue_stats.mean()},
+        {"queue_depth_max", _queue_stats.max()}
+    };
+}
+
+} /* namespace vsg60 */
+} /* namespace gr */
@@ -0,0 +1,81 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2022 Signal Hound.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#ifndef INCLUDED_VSG60_LATENCY_PROBE_H
+#define INCLUDED_VSG60_LATENCY_PROBE_H
+
+#include "running_stats.h"
+#include <gnuradio/thread/thread.h>
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace gr {
+namespace vsg60 {
+
+/*!
+ * \brief Correlates trigger markers with external timestamps to measure TX latency.
+ *
+ * Each marker records the host time its sample entered work() and the time
+ * the host expects the device to play it, based on the estimated queue
+ * depth at submission. Markers are numbered from 0 in submission order.
+ *
+ * External timestamps of the trigger output arrive as UDP datagrams of the
+ * form "seq seconds", with seconds since the epoch on the host clock. A
+ * stand-in sender on localhost is enough for testing. Measured latency is
+ * external time minus entry time. All times are seconds.
+ */
+class latency_probe
+{
+public:
+    // Called from the receive thread for each correlated marker
+    typedef std::function<void(uint64_t seq, double latency)> measured_fn;
+
+private:
+      int _socket;
+      double _max_latency;
+      measured_fn _measured;
+
+      gr::thread::mutex _mutex;
+      uint64_t _next_seq;
+      // Entry time of markers awaiting an external timestamp
+      std::map<uint64_t, double> _pending;
+      std::vector<uint64_t> _measured_hist;
+      std::vector<uint64_t> _estimated_hist;
+      running_stats _measured_stats;
+      running_stats _estimated_stats;
+      running_stats _queue_stats;
+
+      std::unique_ptr<gr::thread::thread> _thread;
+      std::atomic<bool> _running;
+
+      void add(std::vector<uint64_t> &hist, double latency);
+      void receive();
+
+public:
+    latency_probe(int udp_port, double max_latency, int bins,
+                  const measured_fn &measured = measured_fn());
+    ~latency_probe();
+
+      // Record a marker, returns its sequence number
+      uint64_t mark(double enter_time, double play_time, double queue_depth);
+
+      // Histogram counts over [0, max_latency), the last bin includes overflow
+      std::vector<uint64_t> measured_histogram();
+      std::vector<uint64_t> estimated_histogram();
+      std::map<std::string, double> stats();
+};
+
+} // namespace vsg60
+} // namespace gr
+
+#endif /* INCLUDED_VSG60_LATENCY_PROBE_H */
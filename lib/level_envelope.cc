@@ -0,0 +1,277 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2022 Signal Hound.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "level_envelope.h"
+#include <volk/volk.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace gr {
+namespace vsg60 {
+
+// Gains computed at a time during a ramp
+static const int BLOCK = 4096;
+
+// Level changes kept for a consumer that falls behind
+static const size_t MAX_MARKS = 1024;
+
+static double db_to_amplitude(double db)
+{
+    return std::pow(10.0, db / 20);
+}
+
+level_envelope::level_envelope()
+    : _enabled(false),
+    _range(0),
+    _hardware(0),
+    _headroom(std::numeric_limits<double>::quiet_NaN()),
+    _hardware_changes(0),
+    _limited(0),
+    _spacing(1),
+    _profile_repeat(false),
+    _profile_active(false),
+    _profile_next(0),
+    _profile_at(0),
+    _level(0),
+    _target(0),
+    _step(0),
+    _remaining(0),
+    _gains(BLOCK),
+    _noted(std::numeric_limits<double>::quiet_NaN())
+{
+}
+
+level_envelope::~level_envelope()
+{
+}
+
+double
+level_envelope::enable(double level, double range) {
+    gr::thread::scoped_lock lock(_mutex);
+    if(range <= 0) {
+        // Whatever was reached digitally becomes the caller's hardware level
+        double current = _enabled ? _level : level;
+        _enabled = false;
+        return current;
+    }
+
+    if(!_enabled) {
+        // The hardware is at level already, its headroom is read on the
+        // first hardware_needed()
+        _level = _target = _hardware = level;
+        _headroom = std::numeric_limits<double>::quiet_NaN();
+        _remaining = 0;
+        _changes.clear();
+        _profile_active = false;
+        _marks.clear();
+        _noted = std::numeric_limits<double>::quiet_NaN();
+        note(0);
+    }
+    _range = range;
+    _enabled = true;
+    return level;
+}
+
+void
+level_envelope::schedule(uint64_t at, double level, int64_t ramp) {
+    gr::thread::scoped_lock lock(_mutex);
+    if(!_enabled) return;
+
+    // After any change already due at the same sample
+    auto it = std::upper_bound(_changes.begin(), _changes.end(), at,
+        [](uint64_t pos, const change &c) { return pos < c.at; });
+    _changes.insert(it, {at, level, ramp});
+}
+
+void
+level_envelope::set_profile(const std::vector<double> &levels, int64_t spacing, bool repeat) {
+    gr::thread::scoped_lock lock(_mutex);
+    if(!_enabled) return;
+
+    _profile = levels;
+    _spacing = std::max<int64_t>(1, spacing);
+    _profile_repeat = repeat;
+    _profile_active = !levels.empty();
+    _profile_next = 0;
+    _profile_at = 0;
+    _changes.clear();
+}
+
+bool
+level_envelope::hardware_needed(double &level) {
+    gr::thread::scoped_lock lock(_mutex);
+    if(!_enabled) return false;
+
+    // Highest level the pending changes reach
+    double high = std::max(_level, _target);
+    for(const change &c : _changes) high = std::max(high, c.level);
+    if(_profile_active) high = std::max(high, *std::max_element(_profile.begin(), _profile.end()));
+
+    if(std::isnan(_headroom) || high > _hardware + _headroom + 1e-9) {
+        level = high;
+        return true;
+    }
+
+    // Settled too far below the hardware, digital scaling costs resolution
+    if(_remaining == 0 && _changes.empty() && !_profile_active && _level < _hardware - _range) {
+        level = _level;
+        return true;
+    }
+    return false;
+}
+
+void
+level_envelope::set_hardware(double level, double headroom) {
+    gr::thread::scoped_lock lock(_mutex);
+    _hardware = level;
+    _headroom = std::max(0.0, headroom);
+    _hardware_changes++;
+}
+
+void
+level_envelope::start_ramp(double level, int64_t ramp) {
+    _target = level;
+    if(ramp <= 0) {
+        _level = level;
+        _remaining = 0;
+    } else {
+        _remaining = ramp;
+        _step = (level - _level) / ramp;
+    }
+}
+
+void
+level_envelope::note(uint64_t at) {
+    if(_level == _noted) return;
+    _noted = _level;
+    if(_marks.size() == MAX_MARKS) _marks.pop_front();
+    _marks.push_back({at, _level});
+}
+
+void
+level_envelope::next_profile_point() {
+    // Each point is reached exactly, then ramped away from
+    _level = _profile[_profile_next];
+    _profile_next++;
+    if(_profile_next == _profile.size()) {
+        if(!_profile_repeat) {
+            start_ramp(_level, 0);
+            _profile_active = false;
+            return;
+        }
+        _profile_next = 0;
+    }
+    start_ramp(_profile[_profile_next], _spacing);
+}
+
+void
+level_envelope::apply(gr_complex *iq, int n) {
+    const double headroom = std::isnan(_headroom) ? 0 : _headroom;
+    const float limit = (float)db_to_amplitude(headroom);
+
+    if(_remaining == 0) {
+        double gain_db = _level - _hardware;
+        if(gain_db > headroom) {
+            gain_db = headroom;
+            _limited += n;
+        }
+        // Interleaved I/Q scale as one float array
+        if(gain_db != 0) {
+            volk_32f_s32f_multiply_32f((float *)iq, (const float *)iq,
+                                       (float)db_to_amplitude(gain_db), 2 * n);
+        }
+        return;
+    }
+
+    for(int pos = 0; pos < n; pos += BLOCK) {
+        const int len = std::min(BLOCK, n - pos);
+
+        // Geometric steps are linear in dB, restarted each block so
+        // rounding does not accumulate
+        float gain = (float)db_to_amplitude(_level - _hardware);
+        const float ratio = (float)db_to_amplitude(_step);
+        for(int k = 0; k < len; k++) {
+            if(gain > limit) {
+                _gains[k] = limit;
+                _limited++;
+            } else {
+                _gains[k] = gain;
+            }
+            gain *= ratio;
+        }
+        volk_32fc_32f_multiply_32fc(iq + pos, iq + pos, _gains.data(), len);
+
+        _remaining -= len;
+        _level = _remaining == 0 ? _target : _level + _step * len;
+    }
+}
+
+void
+level_envelope::process(gr_complex *iq, int n, uint64_t pos) {
+    if(!_enabled) return;
+    gr::thread::scoped_lock lock(_mutex);
+
+    int done = 0;
+    while(done < n) {
+        const uint64_t now = pos + done;
+
+        // Explicit changes cancel a profile
+        while(!_changes.empty() && _changes.front().at <= now) {
+            start_ramp(_changes.front().level, _changes.front().ramp);
+            _changes.pop_front();
+            _profile_active = false;
+        }
+        if(_profile_active && _profile_at <= now) {
+            next_profile_point();
+            _profile_at = now + _spacing;
+        }
+        note(now);
+
+        // Run to whichever comes first, the next change, profile point or
+        // the end of the ramp
+        uint64_t end = pos + n;
+        if(!_changes.empty()) end = std::min(end, _changes.front().at);
+        if(_profile_active) end = std::min(end, _profile_at);
+        if(_remaining > 0) end = std::min(end, now + _remaining);
+
+        const int len = (int)(end - now);
+        apply(iq + done, len);
+        done += len;
+    }
+}
+
+uint64_t
+level_envelope::level_at(uint64_t pos, double &level) {
+    gr::thread::scoped_lock lock(_mutex);
+    while(!_marks.empty() && _marks.front().at <= pos) {
+        level = _marks.front().level;
+        _marks.pop_front();
+    }
+    return _marks.empty() ? UINT64_MAX : _marks.front().at;
+}
+
+std::map<std::string, double>
+level_envelope::stats() {
+    gr::thread::scoped_lock lock(_mutex);
+    if(!_enabled) return std::map<std::string, double>();
+
+    const double headroom = std::isnan(_headroom) ? 0 : _headroom;
+    return {
+        {"level", _level},
+        {"target", _target},
+        {"hardware_level", _hardware},
+        {"headroom", headroom},
+        {"digital_gain", std::min(_level - _hardware, headroom)},
+        {"hardware_changes", (double)_hardware_changes},
+        {"limited_samples", (double)_limited}
+    };
+}
+
+} /* namespace vsg60 */
+} /* namespace gr */
@@ -0,0 +1,128 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2022 Signal Hound.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#ifndef INCLUDED_VSG60_LEVEL_ENVELOPE_H
+#define INCLUDED_VSG60_LEVEL_ENVELOPE_H
+
+#include <gnuradio/gr_complex.h>
+#include <gnuradio/thread/thread.h>
+#include <volk/volk_alloc.hh>
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace gr {
+namespace vsg60 {
+
+/*!
+ * \brief Output level automation applied digitally to the samples.
+ *
+ * Levels are absolute, in dBm. The hardware is set to one level and the
+ * samples are scaled by the difference, so ramps and steps take effect on
+ * the exact sample with no settling. Scaling up is limited by the headroom
+ * the API leaves above its own digital scale, scaling down by range, the
+ * dynamic range given up to reach a level digitally.
+ *
+ * Changes are scheduled at absolute sample positions, from tags, or at
+ * position 0 for the next sample processed. A profile of levels at a fixed
+ * spacing is ramped through point to point, and replaces any scheduled
+ * change. Ramps are linear in dB.
+ *
+ * The points the level changed at, as processed, are kept for level_at(),
+ * so a consumer can follow the effective level along the stream.
+ *
+ * hardware_needed() reports when pending levels no longer fit the window
+ * around the hardware level. The caller then sets the hardware to the level
+ * it returns and passes it to set_hardware() with the headroom now
+ * available. Until then gains above the headroom are limited.
+ *
+ * Scheduling may be done from any thread, process() from one thread at a time.
+ */
+class level_envelope
+{
+private:
+      struct change {
+          uint64_t at;
+          double level;
+          int64_t ramp;
+      };
+
+      struct mark {
+          uint64_t at;
+          double level;
+      };
+
+      gr::thread::mutex _mutex;
+      std::atomic<bool> _enabled;
+      double _range;
+
+      // Hardware level in dBm, NaN until set, and dB of digital gain allowed
+      double _hardware;
+      double _headroom;
+      uint64_t _hardware_changes;
+      uint64_t _limited;
+
+      std::deque<change> _changes;
+      std::vector<double> _profile;
+      int64_t _spacing;
+      bool _profile_repeat;
+      bool _profile_active;
+      size_t _profile_next;
+      uint64_t _profile_at;
+
+      // Current level, and the per-sample step of the ramp towards the target
+      double _level;
+      double _target;
+      double _step;
+      int64_t _remaining;
+
+      volk::vector<float> _gains;
+      // Level from each processed position on, until level_at() passes it
+      std::deque<mark> _marks;
+      double _noted;
+
+      void start_ramp(double level, int64_t ramp);
+      void note(uint64_t at);
+      void next_profile_point();
+      void apply(gr_complex *iq, int n);
+
+public:
+    level_envelope();
+    ~level_envelope();
+
+      // Start from level, reaching down to range dB below the hardware
+      // digitally. A range of 0 disables and returns the current level.
+      double enable(double level, double range);
+      bool enabled() const { return _enabled; }
+
+      // Ramp to level over ramp samples from position at, 0 for now
+      void schedule(uint64_t at, double level, int64_t ramp);
+      // Levels spacing samples apart, starting with the next sample
+      void set_profile(const std::vector<double> &levels, int64_t spacing, bool repeat);
+
+      bool hardware_needed(double &level);
+      void set_hardware(double level, double headroom);
+
+      // Scale n samples in place, the first at absolute position pos
+      void process(gr_complex *iq, int n, uint64_t pos);
+      // Update level to the one in effect at pos, and return where it next
+      // changes, UINT64_MAX if not yet processed
+      uint64_t level_at(uint64_t pos, double &level);
+
+      // level, target, hardware_level, headroom (dB), digital_gain (dB),
+      // hardware_changes and limited_samples
+      std::map<std::string, double> stats();
+};
+
+} // namespace vsg60
+} // namespace gr
+
+#endif /* INCLUDED_VSG60_LEVEL_ENVELOPE_H */
@@ -0,0 +1,148 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2022 Signal Hound.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "power_stats.h"
+
+#include <volk/volk.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace gr {
+namespace vsg60 {
+
+// Every this many samples is added to the CCDF histogram
+static const int CCDF_DECIMATION = 4;
+
+// Samples per VOLK pass, keeps the float sums accurate
+static const int BLOCK = 4096;
+
+// Histogram bin of a non-negative float: exponent and 3 mantissa bits
+static const int BIN_SHIFT = 20;
+static const int BINS = 1 << (31 - BIN_SHIFT);
+
+constexpr double power_stats::CCDF_STEP;
+
+static int bin_of(float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return (int)(bits >> BIN_SHIFT);
+}
+
+// Lower edge of a histogram bin
+static float bin_start(int bin)
+{
+    uint32_t bits = (uint32_t)bin << BIN_SHIFT;
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+power_stats::accumulator::accumulator()
+    : hist(BINS, 0),
+    power(BLOCK)
+{
+    reset();
+}
+
+void
+power_stats::accumulator::reset() {
+    sum = 0;
+    peak = 0;
+    count = 0;
+    hist_count = 0;
+    phase = 0;
+    std::fill(hist.begin(), hist.end(), 0);
+}
+
+void
+power_stats::accumulator::add(const gr_complex *iq, int len) {
+    for(int pos = 0; pos < len; pos += BLOCK) {
+        const int n = std::min(BLOCK, len - pos);
+        float total;
+        uint32_t max;
+
+        volk_32fc_magnitude_squared_32f(power.data(), iq + pos, n);
+        volk_32f_accumulator_s32f(&total, power.data(), n);
+        volk_32f_index_max_32u(&max, power.data(), n);
+        sum += total;
+        peak = std::max(peak, power[max]);
+
+        int i = phase;
+        for(; i < n; i += CCDF_DECIMATION) {
+            hist[bin_of(power[i])]++;
+            hist_count++;
+        }
+        phase = i - n;
+    }
+    count += len;
+}
+
+void
+power_stats::accumulator::merge(accumulator &other) {
+    sum += other.sum;
+    peak = std::max(peak, other.peak);
+    count += other.count;
+    hist_count += other.hist_count;
+    for(int b = 0; b < BINS; b++) hist[b] += other.hist[b];
+    other.reset();
+}
+
+power_stats::power_stats(int workers)
+    : _workers(std::max(workers, 1))
+{
+}
+
+void
+power_stats::add(const gr_complex *iq, int len, int worker) {
+    _workers[worker].add(iq, len);
+}
+
+void
+power_stats::collect() {
+    for(accumulator &worker : _workers) {
+        if(worker.count) _interval.merge(worker);
+    }
+}
+
+std::map<std::string, double>
+power_stats::summary(std::vector<float> &ccdf) {
+    const double mean = _interval.count ? _interval.sum / _interval.count : 0;
+    const double peak = _interval.peak;
+
+    // Samples in and above each bin
+    std::vector<uint64_t> tail(BINS + 1, 0);
+    for(int b = BINS - 1; b >= 0; b--) tail[b] = tail[b + 1] + _interval.hist[b];
+
+    ccdf.assign(CCDF_POINTS, 0);
+    for(int k = 0; k < CCDF_POINTS && _interval.hist_count && mean > 0; k++) {
+        float threshold = (float)(mean * std::pow(10.0, k * CCDF_STEP / 10));
+        int b = bin_of(threshold);
+        if(b >= BINS - 1) break;
+
+        // Bins above the threshold, plus the part of its own bin above it
+        // assuming samples are spread evenly within the bin
+        float lo = bin_start(b), hi = bin_start(b + 1);
+        double above = tail[b + 1] + _interval.hist[b] * (hi - threshold) / (hi - lo);
+        ccdf[k] = (float)(above / _interval.hist_count);
+    }
+
+    std::map<std::string, double> result = {
+        {"samples", (double)_interval.count},
+        {"power_dbfs", mean > 0 ? 10 * std::log10(mean) : -INFINITY},
+        {"rms", std::sqrt(mean)},
+        {"peak", std::sqrt(peak)},
+        {"crest_db", mean > 0 ? 10 * std::log10(peak / mean) : 0}
+    };
+    _interval.reset();
+    return result;
+}
+
+} /* namespace vsg60 */
+} /* namespace gr */
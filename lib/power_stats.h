@@ -0,0 +1,78 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2022 Signal Hound.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#ifndef INCLUDED_VSG60_POWER_STATS_H
+#define INCLUDED_VSG60_POWER_STATS_H
+
+#include <gnuradio/gr_complex.h>
+#include <volk/volk_alloc.hh>
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace gr {
+namespace vsg60 {
+
+/*!
+ * \brief Power, peak and CCDF of transmitted samples, per interval.
+ *
+ * Instantaneous power is computed with VOLK over every sample, and every
+ * CCDF_DECIMATION'th sample goes into a histogram binned on the float's
+ * exponent and top three mantissa bits. Bins span at most 0.52 dB, no
+ * logarithm is taken per sample, and the CCDF interpolates within a bin.
+ * Workers accumulate separately and are merged by collect().
+ */
+class power_stats
+{
+public:
+    // Points in the CCDF, spaced CCDF_STEP dB above the mean power
+    static const int CCDF_POINTS = 41;
+    static constexpr double CCDF_STEP = 0.5;
+
+private:
+      struct accumulator {
+          double sum;
+          float peak;
+          uint64_t count;
+          uint64_t hist_count;
+          std::vector<uint64_t> hist;
+          volk::vector<float> power;
+          int phase;
+
+          accumulator();
+          void add(const gr_complex *iq, int len);
+          void merge(accumulator &other);
+          void reset();
+      };
+
+      std::vector<accumulator> _workers;
+      accumulator _interval;
+
+public:
+    power_stats(int workers = 1);
+
+      // Accumulate samples on the given worker, thread safe across workers
+      void add(const gr_complex *iq, int len, int worker = 0);
+      // Merge the workers' accumulations into the current interval
+      void collect();
+
+      uint64_t samples() const { return _interval.count; }
+
+      /*!
+       * Summarize and reset the interval: samples, power_dbfs, rms, peak
+       * and crest_db. ccdf receives the fraction of samples more than
+       * k * CCDF_STEP dB above the mean power.
+       */
+      std::map<std::string, double> summary(std::vector<float> &ccdf);
+};
+
+} // namespace vsg60
+} // namespace gr
+
+#endif /* INCLUDED_VSG60_POWER_STATS_H */
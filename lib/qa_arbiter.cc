@@ -0,0 +1,337 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2022 Signal Hound.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "arbiter.h"
+#include <gnuradio/attributes.h>
+#include <boost/test/unit_test.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// A stand-in for the VSG60 API, the test's definitions take the place of the
+// library's. Devices open as serial 100 + handle, calls that matter to the
+// arbiter are recorded.
+static std::mutex api_mutex;
+static std::vector<std::string> api_calls;
+static int api_handles = 0;
+static bool api_repeating = false;
+// Unplugged, submits fail and the device cannot be reopened
+static std::atomic<bool> api_unplugged(false);
+static std::atomic<int> api_submits(0);
+static std::atomic<int> api_temperature_reads(0);
+static std::atomic<float> api_temperature(40);
+
+static VsgStatus api_record(const char *call)
+{
+    std::lock_guard<std::mutex> lock(api_mutex);
+    api_calls.push_back(call);
+    return vsgNoError;
+}
+
+const char *vsgGetAPIVersion() { return "test"; }
+const char *vsgGetErrorString(VsgStatus status) { return "test status"; }
+VsgStatus vsgOpenDevice(int *handle) { *handle = api_handles++; return vsgNoError; }
+VsgStatus vsgOpenDeviceBySerial(int *handle, int serial)
+{
+    if(api_unplugged) return vsgDeviceNotFoundErr;
+    *handle = serial - 100;
+    return vsgNoError;
+}
+VsgStatus vsgCloseDevice(int handle) { return vsgNoError; }
+VsgStatus vsgGetSerialNumber(int handle, int *serial) { *serial = 100 + handle; return vsgNoError; }
+VsgStatus vsgGetUSBStatus(int handle) { return vsgNoError; }
+VsgStatus vsgSetFrequency(int handle, double frequency) { return vsgNoError; }
+VsgStatus vsgSetLevel(int handle, double level) { return vsgNoError; }
+VsgStatus vsgSetSampleRate(int handle, double sampleRate) { return vsgNoError; }
+VsgStatus vsgSetTriggerLength(int handle, double seconds) { return vsgNoError; }
+VsgStatus vsgSetRFOutputState(int handle, VsgBool enabled) { return api_record("vsgSetRFOutputState"); }
+VsgStatus vsgSubmitIQ(int handle, float *iq, int len)
+{
+    api_submits++;
+    return api_unplugged ? vsgUsbXferErr : vsgNoError;
+}
+VsgStatus vsgAbort(int handle) { return api_record("vsgAbort"); }
+VsgStatus vsgFlushAndWait(int handle) { return api_record("vsgFlushAndWait"); }
+VsgStatus vsgIsWaveformActive(int handle, VsgBool *active)
+{
+    *active = api_repeating ? vsgTrue : vsgFalse;
+    return api_record("vsgIsWaveformActive");
+}
+VsgStatus vsgReadTemperature(int handle, float *temp)
+{
+    api_temperature_reads++;
+    *temp = api_temperature;
+    return vsgNoError;
+}
+VsgStatus vsgGetCalDate(int handle, uint32_t *lastCalDate) { *lastCalDate = 0; return vsgNoError; }
+VsgStatus vsgGetRFOutputState(int handle, VsgBool *enabled) { *enabled = vsgTrue; return vsgNoError; }
+VsgStatus vsgRecal(int handle) { return api_record("vsgRecal"); }
+
+namespace gr {
+namespace vsg60 {
+
+// An arbiter on a device of its own, with the calls it made and the
+// notifications its clients got since the last take
+struct test_arbiter {
+    gr::logger_ptr logger, debug_logger;
+    std::shared_ptr<arbiter> arb;
+    std::vector<std::string> events;
+
+    test_arbiter() {
+        gr::configure_default_loggers(logger, debug_logger, "qa_arbiter");
+        arb = arbiter::get(logger);
+        take();
+        api_repeating = false;
+    }
+
+    int add(const std::string &name, int priority) {
+        return arb->add_client(name, priority,
+                               [this, name]() { events.push_back("granted " + name); },
+                               [this, name]() { events.push_back("preempted " + name); });
+    }
+
+    std::vector<std::string> take() {
+        std::vector<std::string> taken;
+        {
+            std::lock_guard<std::mutex> lock(api_mutex);
+            taken.swap(api_calls);
+        }
+        taken.insert(taken.end(), events.begin(), events.end());
+        events.clear();
+        return taken;
+    }
+};
+
+typedef std::vector<std::string> calls;
+
+BOOST_AUTO_TEST_CASE(test_arbiter_priority)
+{
+    test_arbiter t;
+    int low = t.add("low", 0), high = t.add("high", 1);
+
+    t.arb->request(low, true);
+    BOOST_CHECK(t.arb->owns(low));
+    BOOST_CHECK(t.take() == calls({"granted low"}));
+
+    // Outranked while still wanting the device, its output is aborted
+    t.arb->request(high, true);
+    BOOST_CHECK(t.arb->owns(high));
+    BOOST_CHECK_EQUAL(t.arb->owner(), "high");
+    BOOST_CHECK(t.take() == calls({"vsgAbort", "preempted low", "granted high"}));
+
+    // Released, what it queued plays out before the device goes back
+    t.arb->request(high, false);
+    BOOST_CHECK(t.arb->owns(low));
+    BOOST_CHECK(t.take() == calls({"vsgIsWaveformActive", "vsgFlushAndWait", "granted low"}));
+
+    // A lower priority request changes nothing
+    int lower = t.add("lower", -1);
+    t.arb->request(lower, true);
+    BOOST_CHECK(t.arb->owns(low));
+    BOOST_CHECK(t.take().empty());
+
+    std::map<std::string, double> stats = t.arb->stats();
+    BOOST_CHECK_EQUAL(stats["handovers"], 2.0);
+    BOOST_CHECK_EQUAL(stats["preemptions"], 1.0);
+}
+
+BOOST_AUTO_TEST_CASE(test_arbiter_latest_wins_tie)
+{
+    test_arbiter t;
+    int a = t.add("a", 0), b = t.add("b", 0);
+
+    t.arb->request(a, true);
+    t.arb->request(b, true);
+    BOOST_CHECK(t.arb->owns(b));
+
+    // Asking again while wanting it is not a new request
+    t.arb->request(a, true);
+    BOOST_CHECK(t.arb->owns(b));
+    t.arb->request(a, false);
+    t.arb->request(a, true);
+    BOOST_CHECK(t.arb->owns(a));
+}
+
+BOOST_AUTO_TEST_CASE(test_arbiter_release)
+{
+    test_arbiter t;
+    int a = t.add("a", 0), b = t.add("b", 0);
+
+    // With no one waiting the queue is left to play, there is no owner
+    t.arb->request(a, true);
+    t.arb->request(a, false);
+    BOOST_CHECK(!t.arb->owns(a));
+    BOOST_CHECK_EQUAL(t.arb->owner(), "");
+    t.take();
+
+    // A repeating waveform never ends, it is aborted for the next owner
+    api_repeating = true;
+    t.arb->request(a, true);
+    t.arb->request(b, true);
+    t.take();
+    t.arb->request(b, false);
+    BOOST_CHECK(t.arb->owns(a));
+    BOOST_CHECK(t.take() == calls({"vsgIsWaveformActive", "vsgAbort", "granted a"}));
+
+    // Removing the owner releases it
+    t.arb->request(b, true);
+    t.arb->remove_client(b);
+    BOOST_CHECK(t.arb->owns(a));
+}
+
+BOOST_AUTO_TEST_CASE(test_arbiter_gap)
+{
+    test_arbiter t;
+    int a = t.add("a", 0), b = t.add("b", 1);
+
+    // The first owner's output is no switchover
+    t.arb->request(a, true);
+    t.arb->output_started(a);
+    BOOST_CHECK_EQUAL(t.arb->stats()["gap_count"], 0.0);
+
+    // Measured once, at the new owner's first output
+    t.arb->request(b, true);
+    t.arb->output_started(a);
+    BOOST_CHECK_EQUAL(t.arb->stats()["gap_count"], 0.0);
+    t.arb->output_started(b);
+    t.arb->output_started(b);
+    std::map<std::string, double> stats = t.arb->stats();
+    BOOST_CHECK_EQUAL(stats["gap_count"], 1.0);
+    BOOST_CHECK(stats["gap_max"] >= 0);
+}
+
+BOOST_AUTO_TEST_CASE(test_arbiter_reconnect)
+{
+    typedef std::chrono::steady_clock clock;
+    test_arbiter t;
+    device &dev = t.arb->dev();
+    std::vector<gr_complex> iq(1000);
+
+    // A lost connection fails the submit at once, later ones never reach
+    // the API
+    api_unplugged = true;
+    api_submits = 0;
+    clock::time_point start = clock::now();
+    {
+        gr::thread::scoped_lock lock(t.arb->mutex());
+        BOOST_CHECK(!dev.submit(iq.data(), iq.size(), start));
+        BOOST_CHECK(dev.lost());
+        BOOST_CHECK(!dev.submit(iq.data(), iq.size(), start));
+    }
+    BOOST_CHECK(clock::now() - start < std::chrono::milliseconds(100));
+    BOOST_CHECK_EQUAL(api_submits.load(), 1);
+
+    // Reopened by the arbiter once it is back
+    std::this_thread::sleep_for(std::chrono::milliseconds(600));
+    BOOST_CHECK(dev.lost());
+    api_unplugged = false;
+    for(int n = 0; n < 100 && dev.lost(); n++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+    BOOST_REQUIRE(!dev.lost());
+
+    gr::thread::scoped_lock lock(t.arb->mutex());
+    BOOST_CHECK(dev.submit(iq.data(), iq.size(), clock::now()));
+    std::map<std::string, double> stats = dev.stats();
+    BOOST_CHECK_EQUAL(stats["reconnects"], 1.0);
+    BOOST_CHECK(stats["downtime"] >= 0.6);
+}
+
+BOOST_AUTO_TEST_CASE(test_arbiter_health_monitor)
+{
+    test_arbiter t;
+    int a = t.add("a", 0), b = t.add("b", 0);
+    t.arb->request(a, true);
+
+    std::atomic<bool> a_quiet(true);
+    std::atomic<int> a_published(0), b_published(0);
+    auto never = [](double) { return false; };
+    t.arb->set_health_monitor(a, 0.02, 0, [&]() { return a_quiet.load(); }, never,
+                              [&](const std::map<std::string, double> &) { a_published++; });
+    t.arb->set_health_monitor(b, 0.05, 0, []() { return true; }, never,
+                              [&](const std::map<std::string, double> &) { b_published++; });
+
+    // One monitor for the device, each sample published to both
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    BOOST_CHECK_EQUAL(t.arb->health()["temperature"], 40.0);
+    t.arb->remove_client(b);
+    BOOST_CHECK(b_published > 0);
+    BOOST_CHECK(a_published >= b_published);
+
+    // Sampling waits for the owner to allow it
+    a_quiet = false;
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    const int reads = api_temperature_reads;
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    BOOST_CHECK_EQUAL(api_temperature_reads.load(), reads);
+
+    // Stopped once no client monitors
+    t.arb->set_health_monitor(a, 0, 0, nullptr, nullptr, nullptr);
+    BOOST_CHECK(t.arb->health().empty());
+}
+
+BOOST_AUTO_TEST_CASE(test_arbiter_recal)
+{
+    test_arbiter t;
+    int a = t.add("a", 0);
+    t.arb->request(a, true);
+    t.take();
+
+    std::atomic<bool> idle(false);
+    std::atomic<double> asked(0);
+    api_temperature = 40;
+    t.arb->set_health_monitor(a, 0.01, 2, []() { return true; },
+                              [&](double hold) { asked = hold; return idle.load(); },
+                              nullptr);
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+    // Drifted, but the owner cannot pause for as long as a recal takes
+    api_temperature = 43;
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    BOOST_CHECK(asked > 0);
+    BOOST_CHECK(t.take().empty());
+
+    idle = true;
+    for(int n = 0; n < 50 && t.arb->health()["recals"] < 1; n++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    BOOST_CHECK(t.take() == calls({"vsgRecal"}));
+    BOOST_CHECK_EQUAL(t.arb->health()["recals"], 1.0);
+    t.arb->set_health_monitor(a, 0, 0, nullptr, nullptr, nullptr);
+    api_temperature = 40;
+}
+
+BOOST_AUTO_TEST_CASE(test_arbiter_registry)
+{
+    gr::logger_ptr logger, debug_logger;
+    gr::configure_default_loggers(logger, debug_logger, "qa_arbiter");
+
+    // Serial 0 opens another device, a serial number shares it
+    std::shared_ptr<arbiter> first = arbiter::get(logger);
+    std::shared_ptr<arbiter> second = arbiter::get(logger);
+    BOOST_CHECK(first != second);
+    BOOST_CHECK(arbiter::get(logger, first->dev().serial()) == first);
+}
+
+BOOST_AUTO_TEST_CASE(test_arbiter_active_message)
+{
+    bool wants = false;
+    BOOST_CHECK(arbiter::active_message(pmt::from_bool(true), wants));
+    BOOST_CHECK(wants);
+    BOOST_CHECK(arbiter::active_message(pmt::from_long(0), wants));
+    BOOST_CHECK(!wants);
+    BOOST_CHECK(arbiter::active_message(pmt::cons(pmt::mp("active"), pmt::from_double(1)), wants));
+    BOOST_CHECK(wants);
+    BOOST_CHECK(!arbiter::active_message(pmt::mp("on"), wants));
+}
+
+} /* namespace vsg60 */
+} /* namespace gr */
@@ -0,0 +1,130 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2022 Signal Hound.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "audit_recorder.h"
+#include <gnuradio/attributes.h>
+#include <boost/test/unit_test.hpp>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+namespace gr {
+namespace vsg60 {
+
+static const int BLOCK_SAMPLES = 131072;
+
+// A recording whose data file is a FIFO, so the writer blocks until the
+// test starts draining it
+struct test_recording {
+    std::string base;
+    int fd;
+    std::thread reader;
+    size_t bytes;
+
+    test_recording() : bytes(0) {
+        char name[] = "/tmp/qa_vsg60_audit_XXXXXX";
+        close(mkstemp(name));
+        unlink(name);
+        base = name;
+        mkfifo((base + ".sigmf-data").c_str(), 0600);
+        fd = open((base + ".sigmf-data").c_str(), O_RDONLY | O_NONBLOCK);
+    }
+    ~test_recording() {
+        if(reader.joinable()) reader.join();
+        close(fd);
+        unlink((base + ".sigmf-data").c_str());
+        unlink((base + ".sigmf-meta").c_str());
+    }
+
+    // Reads until the recorder closes the file
+    void drain() {
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_NONBLOCK);
+        reader = std::thread([this]() {
+            std::vector<char> buffer(65536);
+            ssize_t n;
+            while((n = read(fd, buffer.data(), buffer.size())) > 0) bytes += n;
+        });
+    }
+
+    std::string meta() {
+        std::ifstream file(base + ".sigmf-meta");
+        std::stringstream text;
+        text << file.rdbuf();
+        return text.str();
+    }
+};
+
+BOOST_AUTO_TEST_CASE(test_audit_recorder_drops_when_full)
+{
+    test_recording r;
+    std::vector<gr_complex> iq(BLOCK_SAMPLES, gr_complex(1, -1));
+    {
+        audit_recorder recorder(r.base, 1);
+        recorder.set_settings(1e9, -10, -10, 10e6);
+
+        // The first block is queued and stalls the writer, with one block
+        // queued there is none free for the second, it is dropped rather
+        // than waited for
+        recorder.record(iq.data(), BLOCK_SAMPLES, true);
+        recorder.record(iq.data(), BLOCK_SAMPLES, true);
+        std::map<std::string, double> stats = recorder.stats();
+        BOOST_CHECK_EQUAL(stats["dropped_blocks"], 1.0);
+        BOOST_CHECK_EQUAL(stats["dropped_samples"], (double)BLOCK_SAMPLES);
+
+        // A new capture follows the gap in the recording
+        recorder.record(iq.data(), 1000, true);
+        BOOST_CHECK_EQUAL(recorder.stats()["captures"], 2.0);
+
+        r.drain();
+    }
+
+    // The queued block and the partial one, nothing of the dropped one
+    r.reader.join();
+    BOOST_CHECK_EQUAL(r.bytes, (BLOCK_SAMPLES + 1000) * sizeof(gr_complex));
+
+    const std::string meta = r.meta();
+    BOOST_CHECK(meta.find("\"core:sample_start\": 0, \"core:global_index\": 0,") != std::string::npos);
+    std::ostringstream second;
+    second << "\"core:sample_start\": " << BLOCK_SAMPLES
+           << ", \"core:global_index\": " << 2 * BLOCK_SAMPLES << ",";
+    BOOST_CHECK(meta.find(second.str()) != std::string::npos);
+}
+
+BOOST_AUTO_TEST_CASE(test_audit_recorder_captures)
+{
+    test_recording r;
+    r.drain();
+    {
+        audit_recorder recorder(r.base, 4);
+        std::vector<gr_complex> iq(100);
+        recorder.set_settings(1e9, -10, -10, 10e6);
+        recorder.record(iq.data(), 100, true);
+
+        // Unchanged settings continue the capture, a change or a break in
+        // transmission starts one
+        recorder.set_settings(1e9, -10, -10, 10e6);
+        recorder.record(iq.data(), 100, true);
+        BOOST_CHECK_EQUAL(recorder.stats()["captures"], 1.0);
+        recorder.set_settings(2e9, -10, -10, 10e6);
+        recorder.record(iq.data(), 100, true);
+        recorder.record(iq.data(), 100, false);
+        BOOST_CHECK_EQUAL(recorder.stats()["captures"], 3.0);
+    }
+    r.reader.join();
+    BOOST_CHECK_EQUAL(r.bytes, 400 * sizeof(gr_complex));
+    BOOST_CHECK(r.meta().find("\"core:sample_rate\": 10000000,") != std::string::npos);
+}
+
+} /* namespace vsg60 */
+} /* namespace gr */
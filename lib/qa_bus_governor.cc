@@ -0,0 +1,183 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2022 Signal Hound.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "bus_governor.h"
+#include <gnuradio/attributes.h>
+#include <boost/test/unit_test.hpp>
+
+#include <chrono>
+#include <climits>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace gr {
+namespace vsg60 {
+
+typedef bus_governor::clock clock_type;
+
+BOOST_AUTO_TEST_CASE(test_bus_governor_admission)
+{
+    bus_governor bus;
+    bus.set_capacity(100e6, true);
+    int a = bus.add_device("a"), b = bus.add_device("b");
+    std::string warning;
+
+    // 4 bytes per sample, 80 MB/s fits
+    BOOST_CHECK(bus.set_rate(a, 20e6, warning));
+    BOOST_CHECK(warning.empty());
+    // Together 120 MB/s, refused and the rate left unset
+    BOOST_CHECK(!bus.set_rate(b, 10e6, warning));
+    BOOST_CHECK(!warning.empty());
+    BOOST_CHECK_EQUAL(bus.stats()["demand"], 80e6);
+
+    // Warned but set without refuse
+    bus.set_capacity(100e6, false);
+    BOOST_CHECK(bus.set_rate(b, 10e6, warning));
+    BOOST_CHECK(!warning.empty());
+    BOOST_CHECK_EQUAL(bus.stats()["demand"], 120e6);
+
+    // Demand follows the devices open
+    bus.remove_device(b);
+    BOOST_CHECK_EQUAL(bus.stats()["demand"], 80e6);
+}
+
+BOOST_AUTO_TEST_CASE(test_bus_governor_chunk)
+{
+    bus_governor bus;
+    std::string warning;
+    int a = bus.add_device("a");
+    bus.set_rate(a, 50e6, warning);
+
+    // Alone a device submits whole
+    BOOST_CHECK_EQUAL(bus.chunk(a), INT_MAX);
+
+    // Shared, capped, and at low rates at most half the queue kept ahead
+    int b = bus.add_device("b");
+    bus.set_rate(b, 100e3, warning);
+    BOOST_CHECK_EQUAL(bus.chunk(a), 16384);
+    BOOST_CHECK_EQUAL(bus.chunk(b), 2500);
+    bus.set_rate(b, 1e3, warning);
+    BOOST_CHECK_EQUAL(bus.chunk(b), 256);
+}
+
+// Devices queue for the bus while the first holds it, grants are recorded in
+// order. A deadline within 2 ms makes a device urgent.
+static std::vector<int> grant_order(const std::vector<int> &deadlines_ms)
+{
+    bus_governor bus;
+    const int holder = bus.add_device("holder");
+    std::vector<int> ids;
+    for(size_t n = 0; n < deadlines_ms.size(); n++) {
+        ids.push_back(bus.add_device("device " + std::to_string(n)));
+    }
+
+    const clock_type::duration length = std::chrono::milliseconds(5);
+    bus.acquire(holder, clock_type::now(), length);
+
+    std::mutex mutex;
+    std::vector<int> order;
+    std::vector<std::thread> threads;
+    for(size_t n = 0; n < ids.size(); n++) {
+        clock_type::time_point deadline = clock_type::now() + std::chrono::milliseconds(deadlines_ms[n]);
+        threads.emplace_back([&, n, deadline]() {
+            bus.acquire(ids[n], deadline, length);
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                order.push_back((int)n);
+            }
+            bus.release(ids[n], 1000);
+        });
+    }
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    bus.release(holder, 1000);
+    for(std::thread &t : threads) t.join();
+
+    BOOST_CHECK_EQUAL(bus.stats()["grants"], (double)(ids.size() + 1));
+    return order;
+}
+
+BOOST_AUTO_TEST_CASE(test_bus_governor_round_robin)
+{
+    // None urgent, served in turn after the holder
+    std::vector<int> order = grant_order({40, 40, 40});
+    BOOST_CHECK_EQUAL(order.size(), 3u);
+    BOOST_CHECK_EQUAL(order[0], 0);
+    BOOST_CHECK_EQUAL(order[1], 1);
+    BOOST_CHECK_EQUAL(order[2], 2);
+}
+
+BOOST_AUTO_TEST_CASE(test_bus_governor_urgent_first)
+{
+    // The device about to run dry goes ahead of its turn
+    std::vector<int> order = grant_order({40, 40, 0});
+    BOOST_CHECK_EQUAL(order.size(), 3u);
+    BOOST_CHECK_EQUAL(order[0], 2);
+    BOOST_CHECK_EQUAL(order[1], 0);
+    BOOST_CHECK_EQUAL(order[2], 1);
+}
+
+BOOST_AUTO_TEST_CASE(test_bus_governor_urgent_crossing)
+{
+    // Both come within the margin while the holder has the bus, the
+    // earliest deadline goes first though the round robin favours the other
+    std::vector<int> order = grant_order({6, 4});
+    BOOST_CHECK_EQUAL(order.size(), 2u);
+    BOOST_CHECK_EQUAL(order[0], 1);
+    BOOST_CHECK_EQUAL(order[1], 0);
+
+    // One device coming within the margin just as the bus is released, as
+    // the waiters wake and pick, must not leave the bus free with both
+    // asleep. The other is next in the round robin.
+    std::promise<void> done;
+    std::future<void> finished = done.get_future();
+    std::thread([&done]() {
+        for(int n = 0; n < 1000; n++) {
+            bus_governor bus;
+            const int holder = bus.add_device("holder");
+            const int a = bus.add_device("a"), b = bus.add_device("b");
+            const clock_type::duration length = std::chrono::microseconds(100);
+            const clock_type::duration hold = std::chrono::microseconds(500);
+            const clock_type::time_point start = clock_type::now();
+            bus.acquire(holder, start, length);
+
+            std::thread later([&]() {
+                bus.acquire(a, start + std::chrono::milliseconds(40), length);
+                bus.release(a, 100);
+            });
+            std::thread urgent([&]() {
+                bus.acquire(b, start + hold + std::chrono::milliseconds(2) +
+                               std::chrono::microseconds(10 * (n % 20)), length);
+                bus.release(b, 100);
+            });
+            std::this_thread::sleep_until(start + hold);
+            bus.release(holder, 100);
+            later.join();
+            urgent.join();
+        }
+        done.set_value();
+    }).detach();
+    BOOST_REQUIRE(finished.wait_for(std::chrono::seconds(30)) == std::future_status::ready);
+}
+
+BOOST_AUTO_TEST_CASE(test_bus_governor_paces_queue)
+{
+    bus_governor bus;
+    int a = bus.add_device("a");
+    bus.add_device("b");
+
+    // A queue running dry in 100 ms takes 10 ms more once 50 ms are left
+    clock_type::time_point start = clock_type::now();
+    bus.acquire(a, start + std::chrono::milliseconds(100), std::chrono::milliseconds(10));
+    bus.release(a, 1000);
+    BOOST_CHECK(clock_type::now() - start >= std::chrono::milliseconds(60));
+}
+
+} /* namespace vsg60 */
+} /* namespace gr */
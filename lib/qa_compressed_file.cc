@@ -0,0 +1,190 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2022 Signal Hound.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "compressed_file.h"
+#include <gnuradio/attributes.h>
+#include <boost/test/unit_test.hpp>
+
+#include <unistd.h>
+#include <zstd.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <vector>
+
+namespace gr {
+namespace vsg60 {
+
+// A .vsgz file in the temporary directory, removed afterwards, laid out as
+// apps/vsgz_write.py writes it. Frames, index and header can be altered
+// before writing.
+struct test_file {
+    std::string path;
+    vsgz_header header;
+    std::vector<std::vector<char>> frames;
+    std::vector<vsgz_frame> index;
+
+    // frame_samples per frame of 16 or 8-bit I/Q counting up
+    test_file(int frame_samples, int frame_count, uint32_t format = VSGZ_SC16) {
+        char name[] = "/tmp/qa_vsg60_vsgz_XXXXXX";
+        close(mkstemp(name));
+        path = name;
+
+        const int sample_size = format == VSGZ_SC16 ? 4 : 2;
+        uint64_t offset = sizeof(header);
+        for(int f = 0; f < frame_count; f++) {
+            std::vector<char> packed(frame_samples * sample_size);
+            for(int n = 0; n < 2 * frame_samples; n++) {
+                const int value = (f * 2 * frame_samples + n) % 100;
+                if(format == VSGZ_SC16) {
+                    ((int16_t *)packed.data())[n] = (int16_t)(value * 256);
+                } else {
+                    packed[n] = (char)value;
+                }
+            }
+            std::vector<char> frame(ZSTD_compressBound(packed.size()));
+            frame.resize(ZSTD_compress(frame.data(), frame.size(), packed.data(), packed.size(), 1));
+            index.push_back({offset, (uint32_t)frame.size(), (uint32_t)frame_samples});
+            offset += frame.size();
+            frames.push_back(frame);
+        }
+
+        memcpy(header.magic, "VSGZ", 4);
+        header.version = 1;
+        header.format = format;
+        header.frame_samples = frame_samples;
+        header.length = (uint64_t)frame_samples * frame_count;
+        header.frame_count = frame_count;
+        header.index_offset = (offset + 7) / 8 * 8;
+        header.sample_rate = 20e6;
+        header.frequency = 1e9;
+        header.level = -30;
+    }
+    ~test_file() { unlink(path.c_str()); }
+
+    void write() {
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        file.write((const char *)&header, sizeof(header));
+        uint64_t offset = sizeof(header);
+        for(const std::vector<char> &frame : frames) {
+            file.write(frame.data(), frame.size());
+            offset += frame.size();
+        }
+        std::vector<char> pad((offset + 7) / 8 * 8 - offset, 0);
+        file.write(pad.data(), pad.size());
+        file.write((const char *)index.data(), index.size() * sizeof(vsgz_frame));
+    }
+};
+
+BOOST_AUTO_TEST_CASE(test_compressed_file_valid)
+{
+    test_file f(1000, 3);
+    f.write();
+
+    compressed_file cf(f.path);
+    BOOST_CHECK_EQUAL(cf.length(), 3000u);
+    BOOST_CHECK_EQUAL(cf.frame_count(), 3u);
+    BOOST_CHECK_EQUAL(cf.frame_samples(), 1000);
+    BOOST_CHECK_EQUAL(cf.sample_size(), 4);
+    BOOST_CHECK_EQUAL(cf.sample_rate(), 20e6);
+    BOOST_CHECK_EQUAL(cf.frequency(), 1e9);
+    BOOST_CHECK_EQUAL(cf.level(), -30.0);
+
+    // Full scale maps to 1
+    compressed_file::decoder decoder;
+    std::vector<gr_complex> out(1000);
+    BOOST_CHECK_EQUAL(decoder.decode(cf, 2, out.data()), 1000);
+    for(int n = 0; n < 1000; n++) {
+        BOOST_CHECK_EQUAL(out[n].real(), ((4000 + 2 * n) % 100) / 128.0f);
+        BOOST_CHECK_EQUAL(out[n].imag(), ((4000 + 2 * n + 1) % 100) / 128.0f);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_compressed_file_sc8)
+{
+    test_file f(500, 2, VSGZ_SC8);
+    f.write();
+
+    compressed_file cf(f.path);
+    BOOST_CHECK_EQUAL(cf.sample_size(), 2);
+
+    compressed_file::decoder decoder;
+    std::vector<gr_complex> out(500);
+    BOOST_CHECK_EQUAL(decoder.decode(cf, 0, out.data()), 500);
+    BOOST_CHECK_EQUAL(out[10], gr_complex(20 / 128.0f, 21 / 128.0f));
+}
+
+BOOST_AUTO_TEST_CASE(test_compressed_file_rejects_bad_headers)
+{
+    BOOST_CHECK_THROW(compressed_file("/nonexistent/file.vsgz"), std::runtime_error);
+
+    {
+        test_file f(100, 2);
+        f.header.version = 2;
+        f.write();
+        BOOST_CHECK_THROW(compressed_file(f.path), std::runtime_error);
+    }
+    {
+        test_file f(100, 2);
+        f.header.format = 7;
+        f.write();
+        BOOST_CHECK_THROW(compressed_file(f.path), std::runtime_error);
+    }
+    {
+        // Index past the end of the file
+        test_file f(100, 2);
+        f.header.frame_count = 1000;
+        f.write();
+        BOOST_CHECK_THROW(compressed_file(f.path), std::runtime_error);
+    }
+    {
+        test_file f(100, 2);
+        f.header.index_offset += 4;
+        f.write();
+        BOOST_CHECK_THROW(compressed_file(f.path), std::runtime_error);
+    }
+    {
+        // Frames not adding up to the length
+        test_file f(100, 2);
+        f.header.length = 150;
+        f.write();
+        BOOST_CHECK_THROW(compressed_file(f.path), std::runtime_error);
+    }
+    {
+        // A frame larger than the header allows
+        test_file f(100, 2);
+        f.index[1].samples = 101;
+        f.header.length = 201;
+        f.write();
+        BOOST_CHECK_THROW(compressed_file(f.path), std::runtime_error);
+    }
+    {
+        test_file f(100, 2);
+        f.index[0].offset = 1 << 30;
+        f.write();
+        BOOST_CHECK_THROW(compressed_file(f.path), std::runtime_error);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_compressed_file_corrupt_frame)
+{
+    // The index is sound, the frame data is not
+    test_file f(1000, 2);
+    f.frames[1].assign(f.frames[1].size(), 0x55);
+    f.write();
+
+    compressed_file cf(f.path);
+    compressed_file::decoder decoder;
+    std::vector<gr_complex> out(1000);
+    BOOST_CHECK_EQUAL(decoder.decode(cf, 0, out.data()), 1000);
+    BOOST_CHECK_THROW(decoder.decode(cf, 1, out.data()), std::runtime_error);
+}
+
+} /* namespace vsg60 */
+} /* namespace gr */
@@ -0,0 +1,106 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2022 Signal Hound.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "fractional_delay.h"
+#include <gnuradio/attributes.h>
+#include <boost/test/unit_test.hpp>
+
+#include <cmath>
+#include <vector>
+
+namespace gr {
+namespace vsg60 {
+
+// Samples counting up, which the cubic interpolator delays exactly
+static std::vector<gr_complex> ramp(int n, int first = 0)
+{
+    std::vector<gr_complex> iq(n);
+    for(int k = 0; k < n; k++) iq[k] = gr_complex(first + k, 0);
+    return iq;
+}
+
+BOOST_AUTO_TEST_CASE(test_fractional_delay_bypassed)
+{
+    fractional_delay fd;
+    fd.set(0, 0);
+    BOOST_CHECK(!fd.enabled());
+
+    std::vector<gr_complex> iq = ramp(100);
+    fd.process(iq.data(), iq.size());
+    for(int k = 0; k < 100; k++) BOOST_CHECK_EQUAL(iq[k], gr_complex(k, 0));
+}
+
+BOOST_AUTO_TEST_CASE(test_fractional_delay_settles)
+{
+    fractional_delay fd;
+    fd.set(2.5, 0);
+    BOOST_CHECK(fd.enabled());
+    BOOST_CHECK_EQUAL(fd.delay(), 2.5);
+
+    // The ramp to 2.5 samples takes 2500, processed in uneven pieces
+    std::vector<gr_complex> iq = ramp(10000);
+    for(int pos = 0; pos < 10000; pos += 3001) {
+        fd.process(iq.data() + pos, std::min(3001, 10000 - pos));
+    }
+    // Delayed by the interpolator's sample plus the setting
+    for(int k = 5000; k < 10000; k += 97) {
+        BOOST_CHECK_SMALL(iq[k].real() - (k - 3.5f), 1e-2f);
+        BOOST_CHECK_SMALL(iq[k].imag(), 1e-2f);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_fractional_delay_ramp_is_continuous)
+{
+    fractional_delay fd;
+    fd.set(4, 0);
+
+    std::vector<gr_complex> iq = ramp(8000);
+    fd.process(iq.data(), iq.size());
+    // The delay grows by at most the slew per sample, so no step or repeat
+    for(int k = 5; k < 8000; k++) {
+        float step = iq[k].real() - iq[k - 1].real();
+        BOOST_CHECK(step > 0.99f && step < 1.01f);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_fractional_delay_phase)
+{
+    fractional_delay fd;
+    fd.set(0, M_PI / 2);
+
+    std::vector<gr_complex> iq(4000, gr_complex(1, 0));
+    fd.process(iq.data(), iq.size());
+    BOOST_CHECK_EQUAL(fd.phase(), M_PI / 2);
+    BOOST_CHECK_SMALL(iq.back().real(), 1e-4f);
+    BOOST_CHECK_CLOSE(iq.back().imag(), 1.0f, 1e-2);
+}
+
+BOOST_AUTO_TEST_CASE(test_fractional_delay_keeps_history_while_bypassed)
+{
+    fractional_delay fd;
+    std::vector<gr_complex> iq = ramp(100);
+    fd.process(iq.data(), iq.size());
+
+    // Switching in repeats the last sample played, not zeros
+    fd.set(1e-6, 0);
+    iq = ramp(100, 100);
+    fd.process(iq.data(), iq.size());
+    BOOST_CHECK_CLOSE(iq[0].real(), 99.0f, 1e-3);
+    BOOST_CHECK_CLOSE(iq[1].real(), 100.0f, 1e-3);
+}
+
+BOOST_AUTO_TEST_CASE(test_fractional_delay_clamps)
+{
+    fractional_delay fd;
+    fd.set(100, 0);
+    BOOST_CHECK_EQUAL(fd.delay(), (double)fractional_delay::MAX_DELAY);
+    fd.set(-1, 0.5);
+    BOOST_CHECK_EQUAL(fd.delay(), 0.0);
+}
+
+} /* namespace vsg60 */
+} /* namespace gr */
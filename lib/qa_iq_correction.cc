@@ -0,0 +1,111 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2022 Signal Hound.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "iq_correction.h"
+#include <gnuradio/attributes.h>
+#include <boost/test/unit_test.hpp>
+
+#include <unistd.h>
+
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <stdexcept>
+#include <vector>
+
+namespace gr {
+namespace vsg60 {
+
+// A calibration table in the temporary directory, removed afterwards
+struct cal_table {
+    std::string path;
+
+    cal_table(const std::string &contents) {
+        char name[] = "/tmp/qa_vsg60_cal_XXXXXX";
+        close(mkstemp(name));
+        path = name;
+        std::ofstream(path) << contents;
+    }
+    ~cal_table() { unlink(path.c_str()); }
+};
+
+// The imbalance the table describes, I_o = I, Q_o = g * (Q * cos(phi) - I * sin(phi))
+static gr_complex impair(gr_complex x, double gain_db, double phase_deg)
+{
+    const double g = std::pow(10.0, gain_db / 20), phi = phase_deg * M_PI / 180;
+    return gr_complex(x.real(), g * (x.imag() * std::cos(phi) - x.real() * std::sin(phi)));
+}
+
+BOOST_AUTO_TEST_CASE(test_iq_correction_disabled)
+{
+    iq_correction corr("");
+    BOOST_CHECK(!corr.enabled());
+    BOOST_CHECK_EQUAL(corr.history(), 1);
+
+    std::vector<gr_complex> in = {{1, 2}, {3, 4}}, out(2);
+    corr.set_frequency(1e9);
+    corr.process(in.data(), out.data(), 2);
+    BOOST_CHECK(in == out);
+}
+
+BOOST_AUTO_TEST_CASE(test_iq_correction_inverts_imbalance)
+{
+    cal_table table("# frequency gain phase\n"
+                    "2e9 2 10\n"
+                    "1e9 0 0\n");
+    iq_correction corr(table.path);
+    BOOST_CHECK(corr.enabled());
+    BOOST_CHECK_EQUAL(corr.history(), 1);
+
+    // Halfway between the points, interpolated in dB and degrees
+    corr.set_frequency(1.5e9);
+    std::vector<gr_complex> x = {{1, 0}, {0, 1}, {0.3f, -0.7f}}, in, out(3);
+    for(gr_complex s : x) in.push_back(impair(s, 1, 5));
+    corr.process(in.data(), out.data(), 3);
+    for(int k = 0; k < 3; k++) {
+        BOOST_CHECK_SMALL(std::abs(out[k] - x[k]), 1e-5f);
+    }
+
+    // Clamped to the last point above the table
+    corr.set_frequency(3e9);
+    in.clear();
+    for(gr_complex s : x) in.push_back(impair(s, 2, 10));
+    corr.process(in.data(), out.data(), 3);
+    for(int k = 0; k < 3; k++) {
+        BOOST_CHECK_SMALL(std::abs(out[k] - x[k]), 1e-5f);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_iq_correction_equalizer)
+{
+    // Taps 0 and 1, a one sample delay
+    cal_table table("1e9 0 0 0 0 1 0\n");
+    iq_correction corr(table.path, 2);
+    BOOST_CHECK_EQUAL(corr.history(), 2);
+
+    corr.prepare(1e9);
+    corr.set_frequency(1e9);
+
+    // Longer than one FFT block, from the second worker
+    const int n = 3000;
+    std::vector<gr_complex> in(n + 1), out(n);
+    for(int k = 0; k <= n; k++) in[k] = gr_complex(std::cos(0.01f * k), std::sin(0.02f * k));
+    corr.process(in.data() + 1, out.data(), n, 1);
+    for(int k = 0; k < n; k++) {
+        BOOST_CHECK_SMALL(std::abs(out[k] - in[k]), 1e-4f);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_iq_correction_rejects_empty_table)
+{
+    cal_table table("# no points\n\n");
+    BOOST_CHECK_THROW(iq_correction corr(table.path), std::runtime_error);
+    BOOST_CHECK_THROW(iq_correction corr("/nonexistent/cal.txt"), std::runtime_error);
+}
+
+} /* namespace vsg60 */
+} /* namespace gr */
@@ -0,0 +1,144 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2022 Signal Hound.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "level_envelope.h"
+#include <gnuradio/attributes.h>
+#include <boost/test/unit_test.hpp>
+
+#include <cmath>
+#include <vector>
+
+namespace gr {
+namespace vsg60 {
+
+static double gain_db(gr_complex sample)
+{
+    return 20 * std::log10(std::abs(sample));
+}
+
+// Enabled at -10 dBm with the hardware there and 3 dB of headroom
+static void start(level_envelope &env)
+{
+    double level;
+    env.enable(-10, 20);
+    BOOST_CHECK(env.hardware_needed(level));
+    env.set_hardware(-10, 3);
+    BOOST_CHECK(!env.hardware_needed(level));
+}
+
+BOOST_AUTO_TEST_CASE(test_level_envelope_disabled)
+{
+    level_envelope env;
+    BOOST_CHECK(!env.enabled());
+
+    std::vector<gr_complex> iq(10, gr_complex(0.5f, 0));
+    env.process(iq.data(), iq.size(), 0);
+    for(gr_complex s : iq) BOOST_CHECK_EQUAL(s, gr_complex(0.5f, 0));
+    BOOST_CHECK(env.stats().empty());
+}
+
+BOOST_AUTO_TEST_CASE(test_level_envelope_step)
+{
+    level_envelope env;
+    start(env);
+
+    // Lands on the exact sample
+    env.schedule(100, -16, 0);
+    std::vector<gr_complex> iq(200, gr_complex(1, 0));
+    env.process(iq.data(), iq.size(), 0);
+    BOOST_CHECK_SMALL(gain_db(iq[99]), 1e-4);
+    BOOST_CHECK_CLOSE(gain_db(iq[100]), -6.0, 1e-3);
+    BOOST_CHECK_CLOSE(gain_db(iq[199]), -6.0, 1e-3);
+    BOOST_CHECK_EQUAL(env.stats()["level"], -16.0);
+}
+
+BOOST_AUTO_TEST_CASE(test_level_envelope_ramp)
+{
+    level_envelope env;
+    start(env);
+
+    // Linear in dB
+    env.schedule(0, -20, 1000);
+    std::vector<gr_complex> iq(1500, gr_complex(1, 0));
+    env.process(iq.data(), 700, 0);
+    env.process(iq.data() + 700, 800, 700);
+    BOOST_CHECK_CLOSE(gain_db(iq[500]), -5.0, 1e-2);
+    BOOST_CHECK_CLOSE(gain_db(iq[1000]), -10.0, 1e-3);
+    BOOST_CHECK_CLOSE(gain_db(iq[1499]), -10.0, 1e-3);
+}
+
+BOOST_AUTO_TEST_CASE(test_level_envelope_headroom)
+{
+    level_envelope env;
+    start(env);
+
+    // Past the headroom the hardware has to move, until then the gain is held
+    env.schedule(0, -5, 0);
+    double level;
+    BOOST_CHECK(env.hardware_needed(level));
+    BOOST_CHECK_EQUAL(level, -5.0);
+
+    std::vector<gr_complex> iq(50, gr_complex(1, 0));
+    env.process(iq.data(), iq.size(), 0);
+    BOOST_CHECK_CLOSE(gain_db(iq[0]), 3.0, 1e-3);
+    BOOST_CHECK_EQUAL(env.stats()["limited_samples"], 50.0);
+
+    env.set_hardware(-5, 3);
+    env.process(iq.data(), iq.size(), 50);
+    BOOST_CHECK_CLOSE(gain_db(iq[0]), 3.0, 1e-3);
+    BOOST_CHECK_EQUAL(env.stats()["hardware_changes"], 2.0);
+}
+
+BOOST_AUTO_TEST_CASE(test_level_envelope_profile)
+{
+    level_envelope env;
+    start(env);
+
+    // Each point reached exactly, then held once the profile ends
+    env.set_profile({-10, -20}, 100, false);
+    std::vector<gr_complex> iq(300, gr_complex(1, 0));
+    env.process(iq.data(), iq.size(), 0);
+    BOOST_CHECK_SMALL(gain_db(iq[0]), 1e-4);
+    BOOST_CHECK_CLOSE(gain_db(iq[50]), -5.0, 1e-2);
+    BOOST_CHECK_CLOSE(gain_db(iq[100]), -10.0, 1e-3);
+    BOOST_CHECK_CLOSE(gain_db(iq[299]), -10.0, 1e-3);
+}
+
+BOOST_AUTO_TEST_CASE(test_level_envelope_level_at)
+{
+    level_envelope env;
+    start(env);
+
+    env.schedule(100, -20, 0);
+    env.schedule(400, -15, 0);
+    std::vector<gr_complex> iq(1000, gr_complex(1, 0));
+    env.process(iq.data(), iq.size(), 0);
+
+    // Each call gives the level at a position and where it next changes
+    double level = 0;
+    BOOST_CHECK_EQUAL(env.level_at(0, level), 100u);
+    BOOST_CHECK_EQUAL(level, -10.0);
+    BOOST_CHECK_EQUAL(env.level_at(150, level), 400u);
+    BOOST_CHECK_EQUAL(level, -20.0);
+    BOOST_CHECK_EQUAL(env.level_at(999, level), UINT64_MAX);
+    BOOST_CHECK_EQUAL(level, -15.0);
+}
+
+BOOST_AUTO_TEST_CASE(test_level_envelope_disable_returns_level)
+{
+    level_envelope env;
+    start(env);
+
+    env.schedule(0, -14, 0);
+    std::vector<gr_complex> iq(10, gr_complex(1, 0));
+    env.process(iq.data(), iq.size(), 0);
+    BOOST_CHECK_EQUAL(env.enable(-10, 0), -14.0);
+    BOOST_CHECK(!env.enabled());
+}
+
+} /* namespace vsg60 */
+} /* namespace gr */
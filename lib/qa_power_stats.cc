@@ -0,0 +1,82 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2022 Signal Hound.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "power_stats.h"
+#include <gnuradio/attributes.h>
+#include <boost/test/unit_test.hpp>
+
+#include <cmath>
+#include <vector>
+
+namespace gr {
+namespace vsg60 {
+
+BOOST_AUTO_TEST_CASE(test_power_stats_constant)
+{
+    power_stats stats;
+    std::vector<gr_complex> iq(10000, gr_complex(0.3f, 0.4f));
+    stats.add(iq.data(), iq.size());
+    stats.collect();
+    BOOST_CHECK_EQUAL(stats.samples(), 10000u);
+
+    std::vector<float> ccdf;
+    std::map<std::string, double> s = stats.summary(ccdf);
+    BOOST_CHECK_EQUAL(s["samples"], 10000.0);
+    BOOST_CHECK_CLOSE(s["power_dbfs"], 20 * std::log10(0.5), 1e-3);
+    BOOST_CHECK_CLOSE(s["rms"], 0.5, 1e-3);
+    BOOST_CHECK_CLOSE(s["peak"], 0.5, 1e-3);
+    BOOST_CHECK_SMALL(s["crest_db"], 1e-4);
+
+    // Nothing above the mean, beyond the histogram's bin width of 0.5 dB
+    BOOST_REQUIRE_EQUAL(ccdf.size(), (size_t)power_stats::CCDF_POINTS);
+    for(int k = 2; k < power_stats::CCDF_POINTS; k++) BOOST_CHECK_EQUAL(ccdf[k], 0.0f);
+}
+
+BOOST_AUTO_TEST_CASE(test_power_stats_ccdf)
+{
+    // Full scale one sample in three, mean power 1/3 and crest 4.77 dB
+    power_stats stats;
+    std::vector<gr_complex> iq(12000);
+    for(size_t n = 0; n < iq.size(); n++) iq[n] = n % 3 ? gr_complex(0, 0) : gr_complex(0, 1);
+    stats.add(iq.data(), iq.size());
+    stats.collect();
+
+    std::vector<float> ccdf;
+    std::map<std::string, double> s = stats.summary(ccdf);
+    BOOST_CHECK_CLOSE(s["power_dbfs"], 10 * std::log10(1 / 3.0), 1e-3);
+    BOOST_CHECK_CLOSE(s["peak"], 1.0, 1e-3);
+    BOOST_CHECK_CLOSE(s["crest_db"], 10 * std::log10(3.0), 1e-3);
+
+    // A third of the samples up to the peak, none well past it
+    for(int k = 0; k * power_stats::CCDF_STEP < 4.5; k++) {
+        BOOST_CHECK_CLOSE(ccdf[k], 1 / 3.0f, 1e-2);
+    }
+    BOOST_CHECK_EQUAL(ccdf[(int)(6 / power_stats::CCDF_STEP)], 0.0f);
+}
+
+BOOST_AUTO_TEST_CASE(test_power_stats_workers)
+{
+    // Ranges accumulated on separate workers merge into one interval
+    power_stats stats(3);
+    std::vector<gr_complex> iq(9000, gr_complex(1, 0));
+    for(int w = 0; w < 3; w++) stats.add(iq.data() + 3000 * w, 3000, w);
+    stats.collect();
+    BOOST_CHECK_EQUAL(stats.samples(), 9000u);
+
+    std::vector<float> ccdf;
+    std::map<std::string, double> s = stats.summary(ccdf);
+    BOOST_CHECK_SMALL(s["power_dbfs"], 1e-4);
+
+    // The summary starts a new interval
+    BOOST_CHECK_EQUAL(stats.samples(), 0u);
+    s = stats.summary(ccdf);
+    BOOST_CHECK_EQUAL(s["samples"], 0.0);
+    BOOST_CHECK(std::isinf(s["power_dbfs"]));
+}
+
+} /* namespace vsg60 */
+} /* namespace gr */
@@ -0,0 +1,131 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2022 Signal Hound.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include <vsg60/shm_ring.h>
+#include <gnuradio/attributes.h>
+#include <boost/test/unit_test.hpp>
+
+#include <unistd.h>
+
+#include <cerrno>
+#include <string>
+#include <vector>
+
+namespace gr {
+namespace vsg60 {
+
+// A ring created as the block does, and opened again as a producer would
+struct test_ring {
+    std::string name;
+    vsg60_ring consumer;
+    vsg60_ring producer;
+
+    test_ring(uint64_t capacity) : name("/qa_vsg60_ring_" + std::to_string(getpid())) {
+        BOOST_REQUIRE_EQUAL(vsg60_ring_create(&consumer, name.c_str(), capacity), 0);
+        BOOST_REQUIRE_EQUAL(vsg60_ring_open(&producer, name.c_str()), 0);
+    }
+    ~test_ring() {
+        vsg60_ring_close(&producer);
+        vsg60_ring_close(&consumer);
+        shm_unlink(name.c_str());
+    }
+};
+
+// Samples first to first + len, I counting up and Q down
+static std::vector<float> samples(int first, int len)
+{
+    std::vector<float> iq;
+    for(int n = first; n < first + len; n++) {
+        iq.push_back((float)n);
+        iq.push_back((float)-n);
+    }
+    return iq;
+}
+
+// Reads everything published, span by span, releasing as it goes
+static std::vector<float> read_all(vsg60_ring *ring, std::vector<uint64_t> &spans)
+{
+    std::vector<float> iq;
+    const float *span;
+    uint64_t n;
+    while((n = vsg60_ring_read_span(ring, &span)) > 0) {
+        iq.insert(iq.end(), span, span + 2 * n);
+        spans.push_back(n);
+        vsg60_ring_release(ring, n);
+    }
+    return iq;
+}
+
+BOOST_AUTO_TEST_CASE(test_shm_ring_open)
+{
+    test_ring r(6);
+    BOOST_CHECK_EQUAL(r.producer.header->capacity, 8u);
+
+    // Only rings of this version are opened
+    vsg60_ring other = {};
+    r.consumer.header->version = VSG60_RING_VERSION + 1;
+    BOOST_CHECK_EQUAL(vsg60_ring_open(&other, r.name.c_str()), -1);
+    BOOST_CHECK_EQUAL(errno, EINVAL);
+    BOOST_CHECK_EQUAL(vsg60_ring_open(&other, "/qa_vsg60_no_ring"), -1);
+}
+
+BOOST_AUTO_TEST_CASE(test_shm_ring_wraparound)
+{
+    test_ring r(8);
+    std::vector<uint64_t> spans;
+    BOOST_CHECK_EQUAL(vsg60_ring_write(&r.producer, samples(0, 6).data(), 6), 6u);
+    BOOST_CHECK(read_all(&r.consumer, spans) == samples(0, 6));
+
+    // Written across the end of the data, read back as two spans
+    BOOST_CHECK_EQUAL(vsg60_ring_write(&r.producer, samples(6, 6).data(), 6), 6u);
+    spans.clear();
+    BOOST_CHECK(read_all(&r.consumer, spans) == samples(6, 6));
+    BOOST_REQUIRE_EQUAL(spans.size(), 2u);
+    BOOST_CHECK_EQUAL(spans[0], 2u);
+    BOOST_CHECK_EQUAL(spans[1], 4u);
+
+    // Positions keep counting
+    BOOST_CHECK_EQUAL(r.consumer.header->head, 12u);
+    BOOST_CHECK_EQUAL(r.consumer.header->tail, 12u);
+}
+
+BOOST_AUTO_TEST_CASE(test_shm_ring_overrun)
+{
+    test_ring r(8);
+    std::vector<uint64_t> spans;
+
+    // A full ring takes no more, unread samples are never overwritten
+    BOOST_CHECK_EQUAL(vsg60_ring_write(&r.producer, samples(0, 5).data(), 5), 5u);
+    BOOST_CHECK_EQUAL(vsg60_ring_write(&r.producer, samples(5, 10).data(), 10), 3u);
+    float *span;
+    BOOST_CHECK_EQUAL(vsg60_ring_write_span(&r.producer, &span), 0u);
+
+    // Space comes back only as the consumer releases it
+    const float *read;
+    BOOST_CHECK_EQUAL(vsg60_ring_read_span(&r.consumer, &read), 8u);
+    vsg60_ring_release(&r.consumer, 3);
+    BOOST_CHECK_EQUAL(vsg60_ring_write(&r.producer, samples(8, 10).data(), 10), 3u);
+    std::vector<float> iq = read_all(&r.consumer, spans);
+    BOOST_CHECK(iq == samples(3, 8));
+}
+
+BOOST_AUTO_TEST_CASE(test_shm_ring_finish)
+{
+    test_ring r(8);
+    BOOST_CHECK_EQUAL(r.consumer.header->closed, 0u);
+    vsg60_ring_finish(&r.producer);
+    BOOST_CHECK_EQUAL(r.consumer.header->closed, 1u);
+
+    // A producer opening the ring again reopens it
+    vsg60_ring again = {};
+    BOOST_REQUIRE_EQUAL(vsg60_ring_open(&again, r.name.c_str()), 0);
+    BOOST_CHECK_EQUAL(r.consumer.header->closed, 0u);
+    vsg60_ring_close(&again);
+}
+
+} /* namespace vsg60 */
+} /* namespace gr */
@@ -0,0 +1,140 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2022 Signal Hound.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "waveform_file.h"
+#include <gnuradio/attributes.h>
+#include <boost/crc.hpp>
+#include <boost/test/unit_test.hpp>
+
+#include <unistd.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <vector>
+
+namespace gr {
+namespace vsg60 {
+
+// As apps/vsgw_write.py places the body
+static const uint32_t DATA_OFFSET = 65536;
+
+// A .vsgw file in the temporary directory, removed afterwards. The header
+// is filled in for the samples and can be altered before writing.
+struct test_file {
+    std::string path;
+    vsgw_header header;
+    std::vector<gr_complex> samples;
+
+    test_file(int length) : samples(length) {
+        char name[] = "/tmp/qa_vsg60_vsgw_XXXXXX";
+        close(mkstemp(name));
+        path = name;
+
+        for(int n = 0; n < length; n++) samples[n] = gr_complex(n, -n);
+        boost::crc_32_type crc;
+        crc.process_bytes(samples.data(), samples.size() * sizeof(gr_complex));
+
+        memcpy(header.magic, "VSGW", 4);
+        header.version = 1;
+        header.data_offset = DATA_OFFSET;
+        header.checksum = crc.checksum();
+        header.length = length;
+        header.sample_rate = 10e6;
+        header.frequency = 2.4e9;
+        header.level = -20;
+    }
+    ~test_file() { unlink(path.c_str()); }
+
+    // Writes the body short by missing samples
+    void write(int missing = 0) {
+        std::vector<char> pad(header.data_offset > sizeof(header) ? header.data_offset - sizeof(header) : 0, 0);
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        file.write((const char *)&header, sizeof(header));
+        file.write(pad.data(), pad.size());
+        file.write((const char *)samples.data(), (samples.size() - missing) * sizeof(gr_complex));
+    }
+};
+
+BOOST_AUTO_TEST_CASE(test_waveform_file_valid)
+{
+    test_file f(1000);
+    f.write();
+
+    waveform_file wf(f.path, true);
+    BOOST_CHECK_EQUAL(wf.length(), 1000);
+    BOOST_CHECK_EQUAL(wf.sample_rate(), 10e6);
+    BOOST_CHECK_EQUAL(wf.frequency(), 2.4e9);
+    BOOST_CHECK_EQUAL(wf.level(), -20.0);
+    BOOST_CHECK(memcmp(wf.samples(), f.samples.data(), 1000 * sizeof(gr_complex)) == 0);
+}
+
+BOOST_AUTO_TEST_CASE(test_waveform_file_checksum)
+{
+    test_file f(1000);
+    f.header.checksum ^= 1;
+    f.write();
+
+    // Only checked when asked for
+    BOOST_CHECK_THROW(waveform_file(f.path, true), std::runtime_error);
+    waveform_file wf(f.path, false);
+    BOOST_CHECK_EQUAL(wf.length(), 1000);
+}
+
+BOOST_AUTO_TEST_CASE(test_waveform_file_rejects_bad_headers)
+{
+    BOOST_CHECK_THROW(waveform_file("/nonexistent/file.vsgw"), std::runtime_error);
+
+    {
+        test_file f(10);
+        memcpy(f.header.magic, "VSGZ", 4);
+        f.write();
+        BOOST_CHECK_THROW(waveform_file(f.path), std::runtime_error);
+    }
+    {
+        test_file f(10);
+        f.header.version = 2;
+        f.write();
+        BOOST_CHECK_THROW(waveform_file(f.path), std::runtime_error);
+    }
+    {
+        // The body must start on a page boundary to be mapped as is
+        test_file f(10);
+        f.header.data_offset = 100;
+        f.write();
+        BOOST_CHECK_THROW(waveform_file(f.path), std::runtime_error);
+    }
+    {
+        // Page aligned, but the body would overlap the header
+        test_file f(10);
+        f.header.data_offset = 0;
+        f.write();
+        BOOST_CHECK_THROW(waveform_file(f.path), std::runtime_error);
+    }
+    {
+        test_file f(10);
+        f.header.length = 0;
+        f.write();
+        BOOST_CHECK_THROW(waveform_file(f.path), std::runtime_error);
+    }
+    {
+        // Header promising more samples than the file holds
+        test_file f(10);
+        f.write(1);
+        BOOST_CHECK_THROW(waveform_file(f.path), std::runtime_error);
+    }
+    {
+        // Shorter than a header
+        test_file f(10);
+        std::ofstream(f.path) << "VSGW";
+        BOOST_CHECK_THROW(waveform_file(f.path), std::runtime_error);
+    }
+}
+
+} /* namespace vsg60 */
+} /* namespace gr */
@@ -0,0 +1,73 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2022 Signal Hound.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "worker_pool.h"
+#include <gnuradio/attributes.h>
+#include <boost/test/unit_test.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+
+namespace gr {
+namespace vsg60 {
+
+BOOST_AUTO_TEST_CASE(test_worker_pool_ordered)
+{
+    worker_pool pool(4);
+    BOOST_CHECK_EQUAL(pool.size(), 4);
+
+    // Early ranges take longest, so later ones finish first
+    std::vector<int> processed(1050, 0);
+    std::set<int> workers;
+    std::mutex mutex;
+    worker_pool::work_fn work = [&](int start, int len, int worker) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20 - 2 * start / 100));
+        for(int n = start; n < start + len; n++) processed[n]++;
+        std::lock_guard<std::mutex> lock(mutex);
+        workers.insert(worker);
+    };
+
+    // Each range passed on the calling thread, in order and once processed
+    const std::thread::id caller = std::this_thread::get_id();
+    int expected = 0;
+    worker_pool::ready_fn ready = [&](int start, int len) {
+        BOOST_CHECK(std::this_thread::get_id() == caller);
+        BOOST_CHECK_EQUAL(start, expected);
+        BOOST_CHECK_EQUAL(len, std::min(100, 1050 - start));
+        for(int n = start; n < start + len; n++) BOOST_CHECK_EQUAL(processed[n], 1);
+        expected += len;
+    };
+    pool.run_ordered(1050, 100, work, ready);
+    BOOST_CHECK_EQUAL(expected, 1050);
+    for(int w : workers) BOOST_CHECK(w >= 0 && w < 4);
+}
+
+BOOST_AUTO_TEST_CASE(test_worker_pool_reuse)
+{
+    worker_pool pool(2);
+    std::atomic<int> total(0);
+    worker_pool::work_fn work = [&](int start, int len, int worker) { total += len; };
+
+    // Jobs run back to back, an empty one returns at once
+    for(int job = 0; job < 50; job++) {
+        int ranges = 0;
+        pool.run_ordered(300, 64, work, [&](int start, int len) { ranges++; });
+        BOOST_CHECK_EQUAL(ranges, 5);
+    }
+    BOOST_CHECK_EQUAL(total.load(), 50 * 300);
+
+    bool called = false;
+    pool.run_ordered(0, 64, work, [&](int start, int len) { called = true; });
+    BOOST_CHECK(!called);
+}
+
+} /* namespace vsg60 */
+} /* namespace gr */
@@ -0,0 +1,57 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2022 Signal Hound.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#ifndef INCLUDED_VSG60_RUNNING_STATS_H
+#define INCLUDED_VSG60_RUNNING_STATS_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+namespace gr {
+namespace vsg60 {
+
+/*!
+ * \brief Running count, mean, RMS and extremes of a series of values.
+ */
+class running_stats
+{
+private:
+      uint64_t _count;
+      double _sum;
+      double _sum_sq;
+      double _min;
+      double _max;
+
+public:
+    running_stats() { reset(); }
+
+      void reset() {
+          _count = 0;
+          _sum = _sum_sq = 0;
+          _min = _max = 0;
+      }
+
+      void add(double value) {
+          _min = _count ? std::min(_min, value) : value;
+          _max = _count ? std::max(_max, value) : value;
+          _sum += value;
+          _sum_sq += value * value;
+          _count++;
+      }
+
+      uint64_t count() const { return _count; }
+      double mean() const { return _count ? _sum / _count : 0; }
+      double rms() const { return _count ? std::sqrt(_sum_sq / _count) : 0; }
+      double min() const { return _min; }
+      double max() const { return _max; }
+};
+
+} // namespace vsg60
+} // namespace gr
+
+#endif /* INCLUDED_VSG60_RUNNING_STATS_H */
@@ -0,0 +1,358 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2022 Signal Hound.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "sequencer_impl.h"
+#include <gnuradio/io_signature.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+namespace gr {
+namespace vsg60 {
+
+// Largest single submission, and the size short segments are tiled up to
+static const int SUBMIT_CHUNK = 65536;
+
+sequencer::sptr sequencer::make(double srate, int loops, const std::string &playlist, int serial)
+{
+    return gnuradio::make_block_sptr<sequencer_impl>(srate, loops, playlist, serial);
+}
+
+sequencer_impl::sequencer_impl(double srate, int loops, const std::string &playlist, int serial)
+    : gr::block("sequencer",
+                gr::io_signature::make(0, 0, 0),
+                gr::io_signature::make(0, 0, 0)),
+    _arbiter(arbiter::get(d_logger, serial)),
+    _device(_arbiter->dev()),
+    _client(-1),
+    _srate(srate),
+    _loops(loops),
+    _active(true),
+    _running(false)
+{
+    message_port_register_out(pmt::mp("transitions"));
+
+    if(!playlist.empty()) load_playlist(playlist);
+
+    _client = _arbiter->add_client(alias(), 0);
+}
+
+sequencer_impl::~sequencer_impl()
+{
+    _arbiter->remove_client(_client);
+}
+
+void
+sequencer_impl::add_segment(const std::string &name, const std::vector<gr_complex> &samples) {
+    if(samples.empty()) {
+        throw std::invalid_argument("vsg60: segment " + name + " is empty");
+    }
+
+    gr::thread::scoped_lock lock(_mutex);
+    // The running schedule points into segment memory
+    if(_running && _segments.count(name)) {
+        throw std::runtime_error("vsg60: cannot replace segment " + name + " while playing");
+    }
+    _segments[name] = samples;
+}
+
+void
+sequencer_impl::load_segment(const std::string &name, const std::string &path) {
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if(!file) {
+        throw std::runtime_error("vsg60: unable to open segment file " + path);
+    }
+
+    std::vector<gr_complex> samples(file.tellg() / sizeof(gr_complex));
+    file.seekg(0);
+    file.read((char *)samples.data(), samples.size() * sizeof(gr_complex));
+
+    add_segment(name, samples);
+}
+
+void
+sequencer_impl::add_entry(const std::string &segment,
+                          double frequency,
+                          double level,
+                          double duration,
+                          int repeat) {
+    gr::thread::scoped_lock lock(_mutex);
+    if(!_segments.count(segment)) {
+        throw std::invalid_argument("vsg60: unknown segment " + segment);
+    }
+    _playlist.push_back({segment, frequency, level, duration, std::max(repeat, 1)});
+}
+
+void
+sequencer_impl::load_playlist(const std::string &path) {
+    std::ifstream file(path);
+    if(!file) {
+        throw std::runtime_error("vsg60: unable to open playlist " + path);
+    }
+
+    std::string line;
+    while(std::getline(file, line)) {
+        if(line.empty() || line[0] == '#') continue;
+
+        std::istringstream fields(line);
+        std::string segment;
+        double frequency, level, duration = 0;
+        int repeat = 1;
+        if(!(fields >> segment >> frequency >> level)) continue;
+        fields >> duration >> repeat;
+
+        bool loaded;
+        {
+            gr::thread::scoped_lock lock(_mutex);
+            loaded = _segments.count(segment);
+        }
+        if(!loaded) load_segment(segment, segment);
+        add_entry(segment, frequency, level, duration, repeat);
+    }
+}
+
+void
+sequencer_impl::clear() {
+    gr::thread::scoped_lock lock(_mutex);
+    if(_running) {
+        throw std::runtime_error("vsg60: cannot clear the playlist while playing");
+    }
+    _playlist.clear();
+    _segments.clear();
+}
+
+void
+sequencer_impl::set_srate(double srate) {
+    gr::thread::scoped_lock lock(_mutex);
+    _srate = srate;
+}
+
+void
+sequencer_impl::set_loops(int loops) {
+    gr::thread::scoped_lock lock(_mutex);
+    _loops = loops;
+}
+
+void
+sequencer_impl::set_device_priority(int priority) {
+    _arbiter->set_priority(_client, priority);
+}
+
+void
+sequencer_impl::set_active(bool active) {
+    {
+        gr::thread::scoped_lock lock(_mutex);
+        _active = active;
+    }
+    // Requests wait for start(), and stop() releases
+    if(_running) _arbiter->request(_client, active);
+}
+
+std::vector<double>
+sequencer_impl::transition_errors() {
+    gr::thread::scoped_lock lock(_mutex);
+    return _errors;
+}
+
+void
+sequencer_impl::build_schedule() {
+    _schedule.clear();
+
+    for(size_t e = 0; e < _playlist.size(); e++) {
+        const entry &ent = _playlist[e];
+        std::vector<gr_complex> &segment = _segments[ent.segment];
+        const int period = (int)segment.size();
+
+        uint64_t total = ent.duration > 0 ?
+            (uint64_t)std::llround(ent.duration * _srate) :
+            (uint64_t)period * ent.repeat;
+
+        // Short segments are submitted from a tiled copy so no submission
+        // is smaller than a chunk. Any window of SUBMIT_CHUNK samples
+        // starting within the first period fits in the tile.
+        gr_complex *source = segment.data();
+        int source_len = period;
+        if(period < SUBMIT_CHUNK && total > (uint64_t)period) {
+            std::vector<gr_complex> tile;
+            int copies = SUBMIT_CHUNK / period + 2;
+            for(int i = 0; i < copies; i++) {
+                tile.insert(tile.end(), segment.begin(), segment.end());
+            }
+            _tiles.push_back(std::move(tile));
+            source = _tiles.back().data();
+            source_len = (int)_tiles.back().size();
+        }
+
+        int pos = 0;
+        bool first = true;
+        while(total > 0) {
+            int len = (int)std::min<uint64_t>({(uint64_t)SUBMIT_CHUNK, total,
+                                               (uint64_t)(source_len - pos)});
+            _schedule.push_back({source + pos, len, first, (int)e, ent.frequency, ent.level});
+            first = false;
+            total -= len;
+            pos = (pos + len) % period;
+        }
+    }
+}
+
+void
+sequencer_impl::run() {
+    typedef std::chrono::steady_clock clock;
+    auto seconds = [](double s) {
+        return std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(s));
+    };
+
+    double frequency = -1, level = 1000;
+    // Host estimate of when the device finishes what has been submitted
+    clock::time_point queue_end;
+    // When the current entry should have started, and its length
+    clock::time_point entry_start, first_start;
+    uint64_t entry_len = 0, played = 0;
+    bool started = false, owned = false;
+
+    // The setters' values, read under the lock once per step
+    double srate = 0, device_srate = 0;
+    int loops = 0;
+    auto snapshot = [&]() {
+        gr::thread::scoped_lock lock(_mutex);
+        srate = _srate;
+        loops = _loops;
+    };
+
+    for(int loop = 0; _running; loop++) {
+        snapshot();
+        if(loops > 0 && loop >= loops) break;
+
+        for(const step &st : _schedule) {
+            if(!_running) break;
+            snapshot();
+
+            gr::thread::scoped_lock device_lock(_arbiter->mutex());
+            const bool owner = _arbiter->owns(_client);
+            if(owner && !owned) {
+                // The previous owner left its own settings on the device
+                device_srate = 0;
+                frequency = -1;
+            }
+            if(owner && srate != device_srate) {
+                _device.set_srate(srate);
+                device_srate = srate;
+            }
+            owned = owner;
+
+            if(owner && (st.frequency != frequency || st.level != level)) {
+                _device.set_frequency(st.frequency);
+                _device.set_level(st.level);
+                frequency = st.frequency;
+                level = st.level;
+            }
+
+            clock::time_point now = clock::now();
+            if(!started) {
+                queue_end = first_start = entry_start = now;
+                started = true;
+            }
+
+            if(st.transition) {
+                // Due right after the previous entry, versus when the device
+                // can actually start it
+                clock::time_point due = entry_start + seconds(entry_len / srate);
+                clock::time_point actual = std::max(queue_end, now);
+                double error = std::chrono::duration<double>(actual - due).count();
+                double drift = std::chrono::duration<double>(
+                    actual - (first_start + seconds(played / srate))).count();
+
+                if(loop > 0 || st.entry > 0) {
+                    {
+                        gr::thread::scoped_lock lock(_mutex);
+                        _errors.push_back(error);
+                    }
+
+                    pmt::pmt_t msg = pmt::make_dict();
+                    msg = pmt::dict_add(msg, pmt::mp("entry"), pmt::from_long(st.entry));
+                    msg = pmt::dict_add(msg, pmt::mp("error"), pmt::from_double(error));
+                    msg = pmt::dict_add(msg, pmt::mp("drift"), pmt::from_double(drift));
+                    message_port_pub(pmt::mp("transitions"), msg);
+                }
+
+                entry_start = actual;
+                entry_len = 0;
+            }
+
+            if(owner) {
+                if(_device.submit(st.iq, st.len, queue_end)) {
+                    _arbiter->output_started(_client);
+                } else {
+                    // A lost device takes its queue with it
+                    queue_end = clock::now();
+                }
+            }
+            device_lock.unlock();
+
+            _device.flush_log();
+            queue_end = std::max(queue_end, now) + seconds(st.len / srate);
+            entry_len += st.len;
+            played += st.len;
+
+            // Without the device the schedule keeps time on its own
+            if(!owner) std::this_thread::sleep_until(queue_end);
+        }
+    }
+
+    {
+        gr::thread::scoped_lock device_lock(_arbiter->mutex());
+        if(_arbiter->owns(_client)) VSG_CALL(_device, vsgFlush);
+    }
+    _device.flush_log();
+}
+
+bool
+sequencer_impl::start() {
+    {
+        gr::thread::scoped_lock lock(_mutex);
+        _errors.clear();
+        _tiles.clear();
+        build_schedule();
+    }
+
+    _running = true;
+    bool active;
+    {
+        gr::thread::scoped_lock lock(_mutex);
+        active = _active;
+    }
+    if(active) _arbiter->request(_client, true);
+
+    _thread.reset(new gr::thread::thread([this]() { run(); }));
+    return true;
+}
+
+bool
+sequencer_impl::stop() {
+    _running = false;
+    if(_thread) {
+        _thread->join();
+        _thread.reset();
+    }
+
+    {
+        gr::thread::scoped_lock device_lock(_arbiter->mutex());
+        if(_arbiter->owns(_client)) VSG_CALL(_device, vsgAbort);
+    }
+    _arbiter->request(_client, false);
+    _device.flush_log();
+    return true;
+}
+
+} /* namespace vsg60 */
+} /* namespace gr */
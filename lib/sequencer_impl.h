@@ -0,0 +1,95 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2022 Signal Hound.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#ifndef INCLUDED_VSG60_SEQUENCER_IMPL_H
+#define INCLUDED_VSG60_SEQUENCER_IMPL_H
+
+#include <vsg60/sequencer.h>
+#include "arbiter.h"
+
+#include <atomic>
+#include <map>
+#include <memory>
+
+namespace gr {
+namespace vsg60 {
+
+class sequencer_impl : public sequencer
+{
+private:
+      struct entry {
+          std::string segment;
+          double frequency;
+          double level;
+          double duration;
+          int repeat;
+      };
+
+      // One submission in the precomputed schedule
+      struct step {
+          gr_complex *iq;
+          int len;
+          // First step of a playlist entry
+          bool transition;
+          int entry;
+          double frequency;
+          double level;
+      };
+
+      // Shared with other blocks on the same device
+      std::shared_ptr<arbiter> _arbiter;
+      device &_device;
+      int _client;
+
+      double _srate;
+      int _loops;
+      bool _active;
+
+      gr::thread::mutex _mutex;
+      std::map<std::string, std::vector<gr_complex>> _segments;
+      std::vector<entry> _playlist;
+      std::vector<step> _schedule;
+      // Tiled copies of short segments referenced by the schedule
+      std::vector<std::vector<gr_complex>> _tiles;
+      std::vector<double> _errors;
+
+      std::unique_ptr<gr::thread::thread> _thread;
+      std::atomic<bool> _running;
+
+      void build_schedule();
+      void run();
+
+public:
+    sequencer_impl(double srate, int loops, const std::string &playlist, int serial);
+    ~sequencer_impl();
+
+      void add_segment(const std::string &name, const std::vector<gr_complex> &samples);
+      void load_segment(const std::string &name, const std::string &path);
+      void add_entry(const std::string &segment,
+                     double frequency,
+                     double level,
+                     double duration,
+                     int repeat);
+      void load_playlist(const std::string &path);
+      void clear();
+
+      void set_srate(double srate);
+      void set_loops(int loops);
+
+      void set_device_priority(int priority);
+      void set_active(bool active);
+
+      std::vector<double> transition_errors();
+
+      bool start();
+      bool stop();
+};
+
+} // namespace vsg60
+} // namespace gr
+
+#endif /* INCLUDED_VSG60_SEQUENCER_IMPL_H */
@@ -0,0 +1,272 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2022 Signal Hound.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "shm_ingest_impl.h"
+#include <gnuradio/io_signature.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+#include <thread>
+
+namespace gr {
+namespace vsg60 {
+
+// Largest single submission
+static const uint64_t SUBMIT_CHUNK = 65536;
+
+// Shorter runs wait for more while the device has at least this queued
+static const uint64_t MIN_CHUNK = 4096;
+static const std::chrono::milliseconds MIN_QUEUED(2);
+
+// How long to sleep when there is nothing to submit
+static const std::chrono::microseconds POLL_INTERVAL(100);
+
+static const pmt::pmt_t ACTIVE_PORT = pmt::mp("active");
+
+shm_ingest::sptr shm_ingest::make(const std::string &name, int capacity,
+                                  double frequency, double level, double srate, int serial)
+{
+    return gnuradio::make_block_sptr<shm_ingest_impl>(name, capacity, frequency, level, srate, serial);
+}
+
+shm_ingest_impl::shm_ingest_impl(const std::string &name, int capacity,
+                                 double frequency, double level, double srate, int serial)
+    : gr::block("shm_ingest",
+                gr::io_signature::make(0, 0, 0),
+                gr::io_signature::make(0, 0, 0)),
+    _arbiter(arbiter::get(d_logger, serial)),
+    _device(_arbiter->dev()),
+    _client(-1),
+    _name(name),
+    _frequency(frequency),
+    _level(level),
+    _srate(srate),
+    _active(true),
+    _param_changed(true),
+    _submitted(0),
+    _submits(0),
+    _underruns(0),
+    _running(false)
+{
+    if(capacity < (int)SUBMIT_CHUNK) {
+        throw std::invalid_argument("vsg60: shared memory ring needs at least " +
+                                    std::to_string(SUBMIT_CHUNK) + " samples");
+    }
+
+    // Created here so producers can attach before the flowgraph starts
+    if(vsg60_ring_create(&_ring, _name.c_str(), capacity) < 0) {
+        throw std::runtime_error("vsg60: unable to create shared memory ring " + _name +
+                                 ": " + strerror(errno));
+    }
+    GR_LOG_INFO(d_logger, "Shared memory ring " << _name << ", "
+                << _ring.header->capacity << " samples");
+
+    message_port_register_in(ACTIVE_PORT);
+    set_msg_handler(ACTIVE_PORT, [this](const pmt::pmt_t &msg) { handle_active(msg); });
+
+    _client = _arbiter->add_client(alias(), 0);
+}
+
+shm_ingest_impl::~shm_ingest_impl()
+{
+    _arbiter->remove_client(_client);
+    vsg60_ring_close(&_ring);
+    shm_unlink(_name.c_str());
+}
+
+void
+shm_ingest_impl::set_frequency(double frequency) {
+    gr::thread::scoped_lock lock(_mutex);
+    _frequency = frequency;
+    _param_changed = true;
+}
+
+void
+shm_ingest_impl::set_level(double level) {
+    gr::thread::scoped_lock lock(_mutex);
+    _level = level;
+    _param_changed = true;
+}
+
+void
+shm_ingest_impl::set_srate(double srate) {
+    gr::thread::scoped_lock lock(_mutex);
+    _srate = srate;
+    _param_changed = true;
+}
+
+void
+shm_ingest_impl::set_device_priority(int priority) {
+    _arbiter->set_priority(_client, priority);
+}
+
+void
+shm_ingest_impl::set_active(bool active) {
+    {
+        gr::thread::scoped_lock lock(_mutex);
+        _active = active;
+    }
+    // Requests wait for start(), and stop() releases
+    if(_running) _arbiter->request(_client, active);
+}
+
+void
+shm_ingest_impl::handle_active(const pmt::pmt_t &msg) {
+    bool active;
+    if(!arbiter::active_message(msg, active)) {
+        GR_LOG_WARN(d_logger, "Active message is not a bool, ignored");
+        return;
+    }
+    set_active(active);
+}
+
+std::map<std::string, double>
+shm_ingest_impl::stats() {
+    const vsg60_ring_header *h = _ring.header;
+    uint64_t fill = __atomic_load_n(&h->head, __ATOMIC_ACQUIRE) -
+                    __atomic_load_n(&h->tail, __ATOMIC_ACQUIRE);
+
+    gr::thread::scoped_lock lock(_stats_mutex);
+    return {
+        {"submitted_samples", (double)_submitted},
+        {"submits", (double)_submits},
+        {"underruns", (double)_underruns},
+        {"ring_fill", (double)fill},
+        {"ring_capacity", (double)h->capacity}
+    };
+}
+
+void
+shm_ingest_impl::configure() {
+    gr::thread::scoped_lock lock(_mutex);
+    _device.set_frequency(_frequency);
+    _device.set_level(_level);
+    _device.set_srate(_srate);
+    _param_changed = false;
+}
+
+void
+shm_ingest_impl::run() {
+    typedef std::chrono::steady_clock clock;
+
+    // Host estimate of when the device finishes what has been submitted
+    clock::time_point queue_end = clock::now();
+    bool owned = false, starved = true, flushed = true;
+
+    while(_running) {
+        const float *iq;
+        uint64_t len = std::min(vsg60_ring_read_span(&_ring, &iq), SUBMIT_CHUNK);
+        clock::time_point now = clock::now();
+
+        if(len == 0) {
+            if(__atomic_load_n(&_ring.header->closed, __ATOMIC_ACQUIRE)) {
+                // The producer is done, push out the partial queue once
+                if(!flushed) {
+                    gr::thread::scoped_lock lock(_arbiter->mutex());
+                    if(_arbiter->owns(_client)) VSG_CALL(_device, vsgFlush);
+                    flushed = true;
+                }
+                starved = true;
+            } else if(!starved && now > queue_end) {
+                // Ran dry waiting for a producer that is still attached
+                starved = true;
+                gr::thread::scoped_lock lock(_stats_mutex);
+                _underruns++;
+            }
+            _device.flush_log();
+            std::this_thread::sleep_for(POLL_INTERVAL);
+            continue;
+        }
+
+        // Wait for the wrap, or for more, rather than submit a short run
+        if(len < MIN_CHUNK && now + MIN_QUEUED < queue_end &&
+           (_ring.header->tail + len) % _ring.header->capacity != 0) {
+            std::this_thread::sleep_for(POLL_INTERVAL);
+            continue;
+        }
+
+        bool owner;
+        double srate;
+        {
+            gr::thread::scoped_lock lock(_arbiter->mutex());
+            owner = _arbiter->owns(_client);
+            if(owner && (!owned || _param_changed)) configure();
+            owned = owner;
+
+            // Straight from the mapping, the API copies before returning
+            if(owner) {
+                if(_device.submit((const gr_complex *)iq, (int)len, queue_end)) {
+                    _arbiter->output_started(_client);
+                } else {
+                    // A lost device takes its queue with it
+                    queue_end = clock::now();
+                }
+            }
+
+            gr::thread::scoped_lock param_lock(_mutex);
+            srate = _srate;
+        }
+        vsg60_ring_release(&_ring, len);
+
+        queue_end = std::max(queue_end, now) +
+            std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(len / srate));
+        starved = false;
+        flushed = false;
+
+        if(owner) {
+            gr::thread::scoped_lock lock(_stats_mutex);
+            _submitted += len;
+            _submits++;
+        } else {
+            // Without the device, keep the producer to real time
+            std::this_thread::sleep_until(queue_end);
+        }
+    }
+
+    gr::thread::scoped_lock lock(_arbiter->mutex());
+    if(_arbiter->owns(_client)) VSG_CALL(_device, vsgFlush);
+}
+
+bool
+shm_ingest_impl::start() {
+    bool active;
+    {
+        gr::thread::scoped_lock lock(_mutex);
+        active = _active;
+    }
+    _running = true;
+    if(active) _arbiter->request(_client, true);
+
+    _thread.reset(new gr::thread::thread([this]() { run(); }));
+    return true;
+}
+
+bool
+shm_ingest_impl::stop() {
+    _running = false;
+    if(_thread) {
+        _thread->join();
+        _thread.reset();
+    }
+
+    _arbiter->request(_client, false);
+    _device.flush_log();
+
+    std::map<std::string, double> counters = stats();
+    if(counters["submits"] > 0) {
+        GR_LOG_INFO(d_logger, "Ingested " << counters["submitted_samples"] << " samples in "
+                    << counters["submits"] << " submits, "
+                    << counters["underruns"] << " underruns");
+    }
+    return true;
+}
+
+} /* namespace vsg60 */
+} /* namespace gr */
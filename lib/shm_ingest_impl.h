@@ -0,0 +1,72 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2022 Signal Hound.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#ifndef INCLUDED_VSG60_SHM_INGEST_IMPL_H
+#define INCLUDED_VSG60_SHM_INGEST_IMPL_H
+
+#include <vsg60/shm_ingest.h>
+#include <vsg60/shm_ring.h>
+#include "arbiter.h"
+
+#include <atomic>
+#include <memory>
+
+namespace gr {
+namespace vsg60 {
+
+class shm_ingest_impl : public shm_ingest
+{
+private:
+      // Shared with other blocks on the same device
+      std::shared_ptr<arbiter> _arbiter;
+      device &_device;
+      int _client;
+
+      std::string _name;
+      vsg60_ring _ring;
+
+      gr::thread::mutex _mutex;
+      double _frequency;
+      double _level;
+      double _srate;
+      bool _active;
+      std::atomic<bool> _param_changed;
+
+      gr::thread::mutex _stats_mutex;
+      uint64_t _submitted;
+      uint64_t _submits;
+      uint64_t _underruns;
+
+      std::unique_ptr<gr::thread::thread> _thread;
+      std::atomic<bool> _running;
+
+      void configure();
+      void run();
+      void handle_active(const pmt::pmt_t &msg);
+
+public:
+    shm_ingest_impl(const std::string &name, int capacity,
+                    double frequency, double level, double srate, int serial);
+    ~shm_ingest_impl();
+
+      void set_frequency(double frequency);
+      void set_level(double level);
+      void set_srate(double srate);
+
+      void set_device_priority(int priority);
+      void set_active(bool active);
+
+      std::map<std::string, double> stats();
+
+      bool start();
+      bool stop();
+};
+
+} // namespace vsg60
+} // namespace gr
+
+#endif /* INCLUDED_VSG60_SHM_INGEST_IMPL_H */
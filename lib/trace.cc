@@ -0,0 +1,159 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2022 Signal Hound.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "trace.h"
+
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace gr {
+namespace vsg60 {
+namespace trace {
+
+// Calls kept per thread, older calls are overwritten
+static const uint64_t BUFFER_SIZE = 65536;
+
+namespace {
+
+struct event {
+    const char *name;
+    long tid;
+    uint64_t start;
+    uint64_t end;
+};
+
+// Written only by the thread holding it. The count is published after each
+// event so a dump from another thread sees complete events.
+struct buffer {
+    std::vector<event> events;
+    std::atomic<uint64_t> count;
+    bool held;
+
+    buffer() : events(BUFFER_SIZE), count(0), held(true) {}
+};
+
+struct registry;
+bool write(registry &reg, const std::string &path);
+
+// Buffers outlive their threads so calls can be dumped at shutdown. A
+// thread that exits gives its buffer to the next new thread, which keeps
+// memory bounded by the threads alive at once as watchdogs are restarted.
+struct registry {
+    std::mutex mutex;
+    std::vector<std::unique_ptr<buffer>> buffers;
+
+    // Dump at exit when VSG60_TRACE_FILE names the output
+    ~registry() {
+        const char *path = getenv("VSG60_TRACE_FILE");
+        if(path && *path) write(*this, path);
+    }
+};
+
+registry &get_registry()
+{
+    static registry reg;
+    return reg;
+}
+
+// Returns the buffer to the registry when its thread exits
+struct holder {
+    buffer *buf;
+    long tid;
+
+    holder() : buf(nullptr), tid(syscall(SYS_gettid)) {}
+    ~holder() {
+        if(!buf) return;
+        registry &reg = get_registry();
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        buf->held = false;
+    }
+};
+
+thread_local holder thread_holder;
+
+holder &thread_buffer()
+{
+    holder &h = thread_holder;
+    if(!h.buf) {
+        registry &reg = get_registry();
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        for(const auto &buf : reg.buffers) {
+            if(!buf->held) {
+                buf->held = true;
+                h.buf = buf.get();
+                break;
+            }
+        }
+        if(!h.buf) {
+            reg.buffers.emplace_back(new buffer());
+            h.buf = reg.buffers.back().get();
+        }
+    }
+    return h;
+}
+
+bool write(registry &reg, const std::string &path)
+{
+    FILE *file = fopen(path.c_str(), "w");
+    if(!file) return false;
+
+    std::lock_guard<std::mutex> lock(reg.mutex);
+
+    const int pid = getpid();
+    bool first = true;
+    fprintf(file, "{\"traceEvents\":[");
+    for(const auto &buf : reg.buffers) {
+        uint64_t count = buf->count.load(std::memory_order_acquire);
+        uint64_t begin = count > BUFFER_SIZE ? count - BUFFER_SIZE : 0;
+        for(uint64_t i = begin; i < count; i++) {
+            const event &ev = buf->events[i % BUFFER_SIZE];
+            // Complete events, times in microseconds
+            fprintf(file, "%s\n{\"name\":\"%s\",\"cat\":\"vsg\",\"ph\":\"X\","
+                          "\"ts\":%.3f,\"dur\":%.3f,\"pid\":%d,\"tid\":%ld}",
+                    first ? "" : ",", ev.name, ev.start * 1e-3,
+                    (ev.end - ev.start) * 1e-3, pid, ev.tid);
+            first = false;
+        }
+    }
+    fprintf(file, "\n],\"displayTimeUnit\":\"ns\"}\n");
+
+    return fclose(file) == 0;
+}
+
+} // namespace
+
+uint64_t now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void record(const char *name, uint64_t start, uint64_t end)
+{
+    holder &h = thread_buffer();
+    buffer *buf = h.buf;
+    uint64_t n = buf->count.load(std::memory_order_relaxed);
+    buf->events[n % BUFFER_SIZE] = {name, h.tid, start, end};
+    buf->count.store(n + 1, std::memory_order_release);
+}
+
+bool dump(const std::string &path)
+{
+    return write(get_registry(), path);
+}
+
+} // namespace trace
+} /* namespace vsg60 */
+} /* namespace gr */
@@ -0,0 +1,69 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2022 Signal Hound.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#ifndef INCLUDED_VSG60_TRACE_H
+#define INCLUDED_VSG60_TRACE_H
+
+#include <string>
+
+/*
+ * Tracing of VSG API calls, enabled with the ENABLE_TRACING CMake option.
+ * When disabled VSG_TRACE evaluates the call directly and nothing else is
+ * compiled in.
+ */
+#ifdef VSG60_TRACING
+
+#include <cstdint>
+
+namespace gr {
+namespace vsg60 {
+namespace trace {
+
+// Monotonic time in nanoseconds
+uint64_t now();
+
+// Record a completed call on the calling thread's buffer
+void record(const char *name, uint64_t start, uint64_t end);
+
+/*!
+ * Write every thread's recorded calls to path as Chrome trace event JSON,
+ * which Perfetto also loads. Returns false if the file cannot be written.
+ * Calls still being recorded while dumping may be missing or, if a buffer
+ * wraps, replaced by newer ones.
+ */
+bool dump(const std::string &path);
+
+// Records a call from construction to destruction
+struct span {
+    const char *name;
+    uint64_t start;
+
+    ~span() { record(name, start, now()); }
+};
+
+// Time fn() and record it under name, which must be a string literal. Calls
+// returning void are traced too.
+template <typename F>
+inline auto call(const char *name, F fn) -> decltype(fn())
+{
+    span s = {name, now()};
+    return fn();
+}
+
+} // namespace trace
+} // namespace vsg60
+} // namespace gr
+
+#define VSG_TRACE(name, expr) gr::vsg60::trace::call(name, [&]() { return (expr); })
+
+#else
+
+#define VSG_TRACE(name, expr) (expr)
+
+#endif
+
+#endif /* INCLUDED_VSG60_TRACE_H */
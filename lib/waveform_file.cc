@@ -0,0 +1,82 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2022 Signal Hound.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "waveform_file.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <boost/crc.hpp>
+
+#include <climits>
+#include <cstring>
+#include <stdexcept>
+
+namespace gr {
+namespace vsg60 {
+
+static const uint32_t VSGW_VERSION = 1;
+
+waveform_file::waveform_file(const std::string &path, bool verify)
+    : _map(MAP_FAILED),
+    _map_size(0)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    if(fd < 0) {
+        throw std::runtime_error("vsg60: unable to open waveform file " + path);
+    }
+
+    struct stat st;
+    if(fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(vsgw_header)) {
+        close(fd);
+        throw std::runtime_error("vsg60: " + path + " is not a waveform file");
+    }
+    _map_size = st.st_size;
+
+    // Private and writable, the API takes a non-const pointer
+    _map = mmap(nullptr, _map_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+    close(fd);
+    if(_map == MAP_FAILED) {
+        throw std::runtime_error("vsg60: unable to map waveform file " + path);
+    }
+
+    memcpy(&_header, _map, sizeof(_header));
+
+    std::string error;
+    if(memcmp(_header.magic, "VSGW", 4) || _header.version != VSGW_VERSION) {
+        error = " is not a version 1 waveform file";
+    } else if(_header.data_offset < sizeof(vsgw_header) ||
+              _header.data_offset % sysconf(_SC_PAGESIZE) ||
+              _header.length == 0 || _header.length > INT_MAX ||
+              _header.data_offset + _header.length * sizeof(gr_complex) > _map_size) {
+        error = " has an invalid header";
+    } else if(verify) {
+        boost::crc_32_type crc;
+        crc.process_bytes(samples(), _header.length * sizeof(gr_complex));
+        if(crc.checksum() != _header.checksum) error = " failed its checksum";
+    }
+
+    if(!error.empty()) {
+        munmap(_map, _map_size);
+        throw std::runtime_error("vsg60: " + path + error);
+    }
+}
+
+waveform_file::~waveform_file()
+{
+    munmap(_map, _map_size);
+}
+
+gr_complex *
+waveform_file::samples() const {
+    return (gr_complex *)((char *)_map + _header.data_offset);
+}
+
+} /* namespace vsg60 */
+} /* namespace gr */
@@ -0,0 +1,69 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2022 Signal Hound.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#ifndef INCLUDED_VSG60_WAVEFORM_FILE_H
+#define INCLUDED_VSG60_WAVEFORM_FILE_H
+
+#include <gnuradio/gr_complex.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace gr {
+namespace vsg60 {
+
+/*
+ * Header at the start of a .vsgw file, little endian. The body starts at
+ * data_offset, a multiple of the page size, and holds length interleaved
+ * float I/Q pairs, the layout vsgSubmitIQ and vsgRepeatWaveform take.
+ * apps/vsgw_write.py writes these files.
+ */
+struct vsgw_header {
+    char magic[4];          // "VSGW"
+    uint32_t version;       // 1
+    uint32_t data_offset;   // bytes from the start of the file to the body
+    uint32_t checksum;      // CRC-32 of the body
+    uint64_t length;        // complex samples
+    double sample_rate;
+    double frequency;
+    double level;
+};
+
+/*!
+ * \brief A .vsgw waveform file mapped into memory.
+ *
+ * The mapping is private and prefaulted, so samples() can be handed to the
+ * API directly without a copy or page faults during the call. Verifying the
+ * checksum reads the whole body and is optional.
+ */
+class waveform_file
+{
+private:
+      void *_map;
+      size_t _map_size;
+      vsgw_header _header;
+
+public:
+    // Throws std::runtime_error if the file is missing, malformed or corrupt
+    waveform_file(const std::string &path, bool verify = false);
+    ~waveform_file();
+
+      waveform_file(const waveform_file &) = delete;
+      waveform_file &operator=(const waveform_file &) = delete;
+
+      gr_complex *samples() const;
+      int length() const { return (int)_header.length; }
+      double sample_rate() const { return _header.sample_rate; }
+      double frequency() const { return _header.frequency; }
+      double level() const { return _header.level; }
+};
+
+} // namespace vsg60
+} // namespace gr
+
+#endif /* INCLUDED_VSG60_WAVEFORM_FILE_H */
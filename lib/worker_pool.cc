@@ -0,0 +1,96 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2022 Signal Hound.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "worker_pool.h"
+
+#include <algorithm>
+
+namespace gr {
+namespace vsg60 {
+
+worker_pool::worker_pool(int nthreads)
+    : _shutdown(false),
+    _work(0),
+    _n(0),
+    _chunk(0),
+    _ntasks(0),
+    _next(0)
+{
+    for(int i = 0; i < nthreads; i++) {
+        _threads.emplace_back(new gr::thread::thread([this, i]() { run(i); }));
+    }
+}
+
+worker_pool::~worker_pool()
+{
+    {
+        gr::thread::scoped_lock lock(_mutex);
+        _shutdown = true;
+    }
+    _work_cond.notify_all();
+
+    for(auto &t : _threads) {
+        t->join();
+    }
+}
+
+void
+worker_pool::run(int worker) {
+    gr::thread::scoped_lock lock(_mutex);
+
+    while(true) {
+        while(!_shutdown && _next >= _ntasks) {
+            _work_cond.wait(lock);
+        }
+        if(_shutdown) return;
+
+        // Ranges are taken in sample order
+        int task = _next++;
+        int start = task * _chunk;
+        int len = std::min(_chunk, _n - start);
+        const work_fn &work = *_work;
+
+        lock.unlock();
+        work(start, len, worker);
+        lock.lock();
+
+        _done[task] = 1;
+        _done_cond.notify_all();
+    }
+}
+
+void
+worker_pool::run_ordered(int n, int chunk, const work_fn &work, const ready_fn &ready) {
+    if(n <= 0) return;
+
+    {
+        gr::thread::scoped_lock lock(_mutex);
+        _work = &work;
+        _n = n;
+        _chunk = chunk;
+        _ntasks = (n + chunk - 1) / chunk;
+        _next = 0;
+        _done.assign(_ntasks, 0);
+    }
+    _work_cond.notify_all();
+
+    const int ntasks = (n + chunk - 1) / chunk;
+    for(int task = 0; task < ntasks; task++) {
+        {
+            gr::thread::scoped_lock lock(_mutex);
+            while(!_done[task]) {
+                _done_cond.wait(lock);
+            }
+        }
+
+        int start = task * chunk;
+        ready(start, std::min(chunk, n - start));
+    }
+}
+
+} /* namespace vsg60 */
+} /* namespace gr */
@@ -0,0 +1,68 @@
+/* -*- c++ -*- */
+/*
+ * Copyright 2022 Signal Hound.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#ifndef INCLUDED_VSG60_WORKER_POOL_H
+#define INCLUDED_VSG60_WORKER_POOL_H
+
+#include <gnuradio/thread/thread.h>
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace gr {
+namespace vsg60 {
+
+/*!
+ * \brief Small fixed pool of threads for splitting per-sample work.
+ *
+ * Work is split into consecutive ranges which are handed to the workers in
+ * order. The calling thread receives each finished range in sample order, so
+ * it can submit early ranges while later ones are still being processed.
+ */
+class worker_pool
+{
+public:
+    // Process the samples [start, start + len) using the buffers of worker
+    typedef std::function<void(int start, int len, int worker)> work_fn;
+    // Called on the calling thread as each range completes, in order
+    typedef std::function<void(int start, int len)> ready_fn;
+
+private:
+      std::vector<std::unique_ptr<gr::thread::thread>> _threads;
+
+      gr::thread::mutex _mutex;
+      gr::thread::condition_variable _work_cond;
+      gr::thread::condition_variable _done_cond;
+      bool _shutdown;
+
+      // Current job
+      const work_fn *_work;
+      int _n;
+      int _chunk;
+      int _ntasks;
+      int _next;
+      std::vector<char> _done;
+
+      void run(int worker);
+
+public:
+    worker_pool(int nthreads);
+    ~worker_pool();
+
+      int size() const { return (int)_threads.size(); }
+
+      // Split n samples into ranges of chunk samples, process them on the
+      // pool and pass each finished range to ready in order. Returns once
+      // every range has been passed to ready.
+      void run_ordered(int n, int chunk, const work_fn &work, const ready_fn &ready);
+};
+
+} // namespace vsg60
+} // namespace gr
+
+#endif /* INCLUDED_VSG60_WORKER_POOL_H */
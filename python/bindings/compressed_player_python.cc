@@ -0,0 +1,78 @@
+/*
+ * Copyright 2022 Free Software Foundation, Inc.
+ *
+ * This file is part of GNU Radio
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ */
+
+/***********************************************************************************/
+/* This file is automatically generated using bindtool and can be manually edited  */
+/* The following lines can be configured to regenerate this file during cmake      */
+/* If manual edits are made, the following tags should be modified accordingly.    */
+/* BINDTOOL_GEN_AUTOMATIC(0)                                                       */
+/* BINDTOOL_USE_PYGCCXML(0)                                                        */
+/* BINDTOOL_HEADER_FILE(compressed_player.h)                                        */
+/* BINDTOOL_HEADER_FILE_HASH(42e54aaee1ebf455102d158db4ea008e)                     */
+/***********************************************************************************/
+
+#include <pybind11/complex.h>
+#include <pybind11/pybind11.h>
+#include <pybind11/stl.h>
+
+namespace py = pybind11;
+
+#include <vsg60/compressed_player.h>
+// pydoc.h is automatically generated in the build directory
+#include <compressed_player_pydoc.h>
+
+void bind_compressed_player(py::module& m)
+{
+
+    using compressed_player    = ::gr::vsg60::compressed_player;
+
+
+    py::class_<compressed_player, gr::block, gr::basic_block,
+        std::shared_ptr<compressed_player>>(m, "compressed_player", D(compressed_player))
+
+        .def(py::init(&compressed_player::make),
+           py::arg("path"),
+           py::arg("repeat") = false,
+           py::arg("threads") = 0,
+           py::arg("serial") = 0,
+           D(compressed_player,make)
+        )
+
+
+        
+        .def("set_device_priority",&compressed_player::set_device_priority,       
+            py::arg("priority"),
+            D(compressed_player,set_device_priority)
+        )
+
+
+        
+        .def("set_active",&compressed_player::set_active,       
+            py::arg("active"),
+            D(compressed_player,set_active)
+        )
+
+
+        
+        .def("stats",&compressed_player::stats,       
+            D(compressed_player,stats)
+        )
+
+        ;
+
+
+
+
+}
+
+
+
+
+
+
@@ -0,0 +1,57 @@
+/*
+ * Copyright 2022 Free Software Foundation, Inc.
+ *
+ * This file is part of GNU Radio
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ */
+#include "pydoc_macros.h"
+#define D(...) DOC(gr,vsg60, __VA_ARGS__ )
+/*
+  This file contains placeholders for docstrings for the Python bindings.
+  Do not edit! These were automatically extracted during the binding process
+  and will be overwritten during the build process
+ */
+
+
+ 
+ static const char *__doc_gr_vsg60_generator = R"doc()doc";
+
+
+ static const char *__doc_gr_vsg60_generator_generator_0 = R"doc()doc";
+
+
+ static const char *__doc_gr_vsg60_generator_generator_1 = R"doc()doc";
+
+
+ static const char *__doc_gr_vsg60_generator_make = R"doc()doc";
+
+
+ static const char *__doc_gr_vsg60_generator_set_waveform = R"doc()doc";
+
+
+ static const char *__doc_gr_vsg60_generator_set_frequency = R"doc()doc";
+
+
+ static const char *__doc_gr_vsg60_generator_set_level = R"doc()doc";
+
+
+ static const char *__doc_gr_vsg60_generator_set_srate = R"doc()doc";
+
+
+ static const char *__doc_gr_vsg60_generator_set_tones = R"doc()doc";
+
+
+ static const char *__doc_gr_vsg60_generator_set_chirp = R"doc()doc";
+
+
+ static const char *__doc_gr_vsg60_generator_set_noise = R"doc()doc";
+
+
+ static const char *__doc_gr_vsg60_generator_set_device_priority = R"doc()doc";
+
+
+ static const char *__doc_gr_vsg60_generator_set_active = R"doc()doc";
+
+  
@@ -39,4 +39,106 @@
 
  static const char *__doc_gr_vsg60_iqin_set_repeat = R"doc()doc";
 
+
+ static const char *__doc_gr_vsg60_iqin_set_submit_affinity = R"doc()doc";
+
+
+ static const char *__doc_gr_vsg60_iqin_set_submit_priority = R"doc()doc";
+
+
+ static const char *__doc_gr_vsg60_iqin_set_power_saving = R"doc()doc";
+
+
+ static const char *__doc_gr_vsg60_iqin_submit_stats = R"doc()doc";
+
+
+ static const char *__doc_gr_vsg60_iqin_reset_submit_stats = R"doc()doc";
+
+
+ static const char *__doc_gr_vsg60_iqin_set_underrun_concealment = R"doc()doc";
+
+
+ static const char *__doc_gr_vsg60_iqin_set_underrun_filler = R"doc()doc";
+
+
+ static const char *__doc_gr_vsg60_iqin_underrun_stats = R"doc()doc";
+
+
+ static const char *__doc_gr_vsg60_iqin_set_gating = R"doc()doc";
+
+
+ static const char *__doc_gr_vsg60_iqin_gating_stats = R"doc()doc";
+
+
+ static const char *__doc_gr_vsg60_iqin_set_start_time = R"doc()doc";
+
+
+ static const char *__doc_gr_vsg60_iqin_set_trigger_length = R"doc()doc";
+
+
+ static const char *__doc_gr_vsg60_iqin_set_latency_probe = R"doc()doc";
+
+
+ static const char *__doc_gr_vsg60_iqin_latency_histogram = R"doc()doc";
+
+
+ static const char *__doc_gr_vsg60_iqin_latency_stats = R"doc()doc";
+
+
+ static const char *__doc_gr_vsg60_iqin_device_stats = R"doc()doc";
+
+
+ static const char *__doc_gr_vsg60_iqin_set_health_monitor = R"doc()doc";
+
+
+ static const char *__doc_gr_vsg60_iqin_health = R"doc()doc";
+
+
+ static const char *__doc_gr_vsg60_iqin_dump_trace = R"doc()doc";
+
+
+ static const char *__doc_gr_vsg60_iqin_play_waveform_file = R"doc()doc";
+
+
+ static const char *__doc_gr_vsg60_iqin_set_signal_stats = R"doc()doc";
+
+
+ static const char *__doc_gr_vsg60_iqin_signal_stats = R"doc()doc";
+
+
+ static const char *__doc_gr_vsg60_iqin_set_audit_recording = R"doc()doc";
+
+
+ static const char *__doc_gr_vsg60_iqin_audit_stats = R"doc()doc";
+
+
+ static const char *__doc_gr_vsg60_iqin_set_device_priority = R"doc()doc";
+
+
+ static const char *__doc_gr_vsg60_iqin_set_active = R"doc()doc";
+
+
+ static const char *__doc_gr_vsg60_iqin_set_alignment = R"doc()doc";
+
+
+ static const char *__doc_gr_vsg60_iqin_alignment = R"doc()doc";
+
+
+ static const char *__doc_gr_vsg60_iqin_set_level_automation = R"doc()doc";
+
+
+ static const char *__doc_gr_vsg60_iqin_set_level_ramp = R"doc()doc";
+
+
+ static const char *__doc_gr_vsg60_iqin_set_level_profile = R"doc()doc";
+
+
+ static const char *__doc_gr_vsg60_iqin_level_stats = R"doc()doc";
+
+
+ static const char *__doc_gr_vsg60_iqin_set_bus_capacity = R"doc()doc";
+
+
+ static const char *__doc_gr_vsg60_iqin_bus_stats = R"doc()doc";
+
   
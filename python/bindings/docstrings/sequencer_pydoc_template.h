@@ -0,0 +1,60 @@
+/*
+ * Copyright 2022 Free Software Foundation, Inc.
+ *
+ * This file is part of GNU Radio
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ */
+#include "pydoc_macros.h"
+#define D(...) DOC(gr,vsg60, __VA_ARGS__ )
+/*
+  This file contains placeholders for docstrings for the Python bindings.
+  Do not edit! These were automatically extracted during the binding process
+  and will be overwritten during the build process
+ */
+
+
+ 
+ static const char *__doc_gr_vsg60_sequencer = R"doc()doc";
+
+
+ static const char *__doc_gr_vsg60_sequencer_sequencer_0 = R"doc()doc";
+
+
+ static const char *__doc_gr_vsg60_sequencer_sequencer_1 = R"doc()doc";
+
+
+ static const char *__doc_gr_vsg60_sequencer_make = R"doc()doc";
+
+
+ static const char *__doc_gr_vsg60_sequencer_add_segment = R"doc()doc";
+
+
+ static const char *__doc_gr_vsg60_sequencer_load_segment = R"doc()doc";
+
+
+ static const char *__doc_gr_vsg60_sequencer_add_entry = R"doc()doc";
+
+
+ static const char *__doc_gr_vsg60_sequencer_load_playlist = R"doc()doc";
+
+
+ static const char *__doc_gr_vsg60_sequencer_clear = R"doc()doc";
+
+
+ static const char *__doc_gr_vsg60_sequencer_set_srate = R"doc()doc";
+
+
+ static const char *__doc_gr_vsg60_sequencer_set_loops = R"doc()doc";
+
+
+ static const char *__doc_gr_vsg60_sequencer_transition_errors = R"doc()doc";
+
+
+ static const char *__doc_gr_vsg60_sequencer_set_device_priority = R"doc()doc";
+
+
+ static const char *__doc_gr_vsg60_sequencer_set_active = R"doc()doc";
+
+  
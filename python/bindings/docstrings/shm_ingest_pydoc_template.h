@@ -0,0 +1,48 @@
+/*
+ * Copyright 2022 Free Software Foundation, Inc.
+ *
+ * This file is part of GNU Radio
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ */
+#include "pydoc_macros.h"
+#define D(...) DOC(gr,vsg60, __VA_ARGS__ )
+/*
+  This file contains placeholders for docstrings for the Python bindings.
+  Do not edit! These were automatically extracted during the binding process
+  and will be overwritten during the build process
+ */
+
+
+ 
+ static const char *__doc_gr_vsg60_shm_ingest = R"doc()doc";
+
+
+ static const char *__doc_gr_vsg60_shm_ingest_shm_ingest_0 = R"doc()doc";
+
+
+ static const char *__doc_gr_vsg60_shm_ingest_shm_ingest_1 = R"doc()doc";
+
+
+ static const char *__doc_gr_vsg60_shm_ingest_make = R"doc()doc";
+
+
+ static const char *__doc_gr_vsg60_shm_ingest_set_frequency = R"doc()doc";
+
+
+ static const char *__doc_gr_vsg60_shm_ingest_set_level = R"doc()doc";
+
+
+ static const char *__doc_gr_vsg60_shm_ingest_set_srate = R"doc()doc";
+
+
+ static const char *__doc_gr_vsg60_shm_ingest_set_device_priority = R"doc()doc";
+
+
+ static const char *__doc_gr_vsg60_shm_ingest_set_active = R"doc()doc";
+
+
+ static const char *__doc_gr_vsg60_shm_ingest_stats = R"doc()doc";
+
+  
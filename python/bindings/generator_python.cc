@@ -0,0 +1,128 @@
+/*
+ * Copyright 2022 Free Software Foundation, Inc.
+ *
+ * This file is part of GNU Radio
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ */
+
+/***********************************************************************************/
+/* This file is automatically generated using bindtool and can be manually edited  */
+/* The following lines can be configured to regenerate this file during cmake      */
+/* If manual edits are made, the following tags should be modified accordingly.    */
+/* BINDTOOL_GEN_AUTOMATIC(0)                                                       */
+/* BINDTOOL_USE_PYGCCXML(0)                                                        */
+/* BINDTOOL_HEADER_FILE(generator.h)                                        */
+/* BINDTOOL_HEADER_FILE_HASH(1aabedc0f1ddb4da7f89d5843d22c011)                     */
+/***********************************************************************************/
+
+#include <pybind11/complex.h>
+#include <pybind11/pybind11.h>
+#include <pybind11/stl.h>
+
+namespace py = pybind11;
+
+#include <vsg60/generator.h>
+// pydoc.h is automatically generated in the build directory
+#include <generator_pydoc.h>
+
+void bind_generator(py::module& m)
+{
+
+    using generator    = ::gr::vsg60::generator;
+
+
+    py::class_<generator, gr::block, gr::basic_block,
+        std::shared_ptr<generator>>(m, "generator", D(generator))
+
+        .def(py::init(&generator::make),
+           py::arg("waveform") = 0,
+           py::arg("frequency") = 1.0E+9,
+           py::arg("level") = -10,
+           py::arg("srate") = 5.0E+7,
+           py::arg("serial") = 0,
+           D(generator,make)
+        )
+        
+
+
+
+
+        
+        .def("set_waveform",&generator::set_waveform,       
+            py::arg("waveform"),
+            D(generator,set_waveform)
+        )
+
+
+        
+        .def("set_frequency",&generator::set_frequency,       
+            py::arg("frequency"),
+            D(generator,set_frequency)
+        )
+
+
+        
+        .def("set_level",&generator::set_level,       
+            py::arg("level"),
+            D(generator,set_level)
+        )
+
+
+        
+        .def("set_srate",&generator::set_srate,       
+            py::arg("srate"),
+            D(generator,set_srate)
+        )
+
+
+        
+        .def("set_tones",&generator::set_tones,       
+            py::arg("offsets"),
+            D(generator,set_tones)
+        )
+
+
+        
+        .def("set_chirp",&generator::set_chirp,       
+            py::arg("bandwidth"),
+            py::arg("period"),
+            D(generator,set_chirp)
+        )
+
+
+        
+        .def("set_noise",&generator::set_noise,       
+            py::arg("bandwidth"),
+            py::arg("period"),
+            D(generator,set_noise)
+        )
+
+
+        
+        .def("set_device_priority",&generator::set_device_priority,       
+            py::arg("priority"),
+            D(generator,set_device_priority)
+        )
+
+
+        
+        .def("set_active",&generator::set_active,       
+            py::arg("active"),
+            D(generator,set_active)
+        )
+
+        ;
+
+
+
+
+}
+
+
+
+
+
+
+
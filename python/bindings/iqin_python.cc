@@ -14,7 +14,7 @@
 /* BINDTOOL_GEN_AUTOMATIC(0)                                                       */
 /* BINDTOOL_USE_PYGCCXML(0)                                                        */
 /* BINDTOOL_HEADER_FILE(iqin.h)                                        */
-/* BINDTOOL_HEADER_FILE_HASH(b9cebff3da8376352de823af39defc82)                     */
+/* BINDTOOL_HEADER_FILE_HASH(0cedf0ea52d70c7489259ca51c06699a)                     */
 /***********************************************************************************/
 
 #include <pybind11/complex.h>
@@ -41,6 +41,9 @@ void bind_iqin(py::module& m)
            py::arg("level") = -10,
            py::arg("srate") = 5.0E+7,
            py::arg("repeat") = false,
+           py::arg("cal_file") = "",
+           py::arg("threads") = 1,
+           py::arg("serial") = 0,
            D(iqin,make)
         )
         
@@ -75,6 +78,245 @@ void bind_iqin(py::module& m)
             D(iqin,set_repeat)
         )
 
+
+        
+        .def("set_submit_affinity",&iqin::set_submit_affinity,       
+            py::arg("cpus"),
+            D(iqin,set_submit_affinity)
+        )
+
+
+        
+        .def("set_submit_priority",&iqin::set_submit_priority,       
+            py::arg("priority"),
+            D(iqin,set_submit_priority)
+        )
+
+
+        
+        .def("set_power_saving",&iqin::set_power_saving,       
+            py::arg("enabled"),
+            D(iqin,set_power_saving)
+        )
+
+
+        
+        .def("submit_stats",&iqin::submit_stats,       
+            D(iqin,submit_stats)
+        )
+
+
+        
+        .def("reset_submit_stats",&iqin::reset_submit_stats,       
+            D(iqin,reset_submit_stats)
+        )
+
+
+        
+        .def("set_underrun_concealment",&iqin::set_underrun_concealment,       
+            py::arg("samples"),
+            D(iqin,set_underrun_concealment)
+        )
+
+
+        
+        .def("set_underrun_filler",&iqin::set_underrun_filler,       
+            py::arg("filler"),
+            D(iqin,set_underrun_filler)
+        )
+
+
+        
+        .def("underrun_stats",&iqin::underrun_stats,       
+            D(iqin,underrun_stats)
+        )
+
+
+        
+        .def("set_gating",&iqin::set_gating,       
+            py::arg("threshold"),
+            py::arg("min_silence"),
+            D(iqin,set_gating)
+        )
+
+
+        
+        .def("gating_stats",&iqin::gating_stats,       
+            D(iqin,gating_stats)
+        )
+
+
+        
+        .def("set_start_time",&iqin::set_start_time,       
+            py::arg("seconds"),
+            D(iqin,set_start_time)
+        )
+
+
+        
+        .def("set_trigger_length",&iqin::set_trigger_length,       
+            py::arg("seconds"),
+            D(iqin,set_trigger_length)
+        )
+
+
+        
+        .def("set_latency_probe",&iqin::set_latency_probe,       
+            py::arg("interval"),
+            py::arg("udp_port") = 0,
+            py::arg("max_latency") = 0.10000000000000001,
+            py::arg("bins") = 100,
+            D(iqin,set_latency_probe)
+        )
+
+
+        
+        .def("latency_histogram",&iqin::latency_histogram,       
+            py::arg("measured") = true,
+            D(iqin,latency_histogram)
+        )
+
+
+        
+        .def("latency_stats",&iqin::latency_stats,       
+            D(iqin,latency_stats)
+        )
+
+
+        
+        .def("device_stats",&iqin::device_stats,       
+            D(iqin,device_stats)
+        )
+
+
+        
+        .def("set_health_monitor",&iqin::set_health_monitor,       
+            py::arg("interval"),
+            py::arg("recal_threshold") = 0,
+            D(iqin,set_health_monitor)
+        )
+
+
+        
+        .def("health",&iqin::health,       
+            D(iqin,health)
+        )
+
+
+        
+        .def("dump_trace",&iqin::dump_trace,       
+            py::arg("path"),
+            D(iqin,dump_trace)
+        )
+
+
+        
+        .def("play_waveform_file",&iqin::play_waveform_file,       
+            py::arg("path"),
+            py::arg("repeat") = true,
+            py::arg("verify") = false,
+            D(iqin,play_waveform_file)
+        )
+
+
+        
+        .def("set_signal_stats",&iqin::set_signal_stats,       
+            py::arg("interval"),
+            D(iqin,set_signal_stats)
+        )
+
+
+        
+        .def("signal_stats",&iqin::signal_stats,       
+            D(iqin,signal_stats)
+        )
+
+
+        
+        .def("set_audit_recording",&iqin::set_audit_recording,       
+            py::arg("path"),
+            py::arg("queue_blocks") = 16,
+            D(iqin,set_audit_recording)
+        )
+
+
+        
+        .def("audit_stats",&iqin::audit_stats,       
+            D(iqin,audit_stats)
+        )
+
+
+        
+        .def("set_device_priority",&iqin::set_device_priority,       
+            py::arg("priority"),
+            D(iqin,set_device_priority)
+        )
+
+
+        
+        .def("set_active",&iqin::set_active,       
+            py::arg("active"),
+            D(iqin,set_active)
+        )
+
+
+        
+        .def("set_alignment",&iqin::set_alignment,       
+            py::arg("delay"),
+            py::arg("phase"),
+            D(iqin,set_alignment)
+        )
+
+
+        
+        .def("alignment",&iqin::alignment,       
+            D(iqin,alignment)
+        )
+
+
+        
+        .def("set_level_automation",&iqin::set_level_automation,       
+            py::arg("range"),
+            D(iqin,set_level_automation)
+        )
+
+
+        
+        .def("set_level_ramp",&iqin::set_level_ramp,       
+            py::arg("level"),
+            py::arg("seconds"),
+            D(iqin,set_level_ramp)
+        )
+
+
+        
+        .def("set_level_profile",&iqin::set_level_profile,       
+            py::arg("levels"),
+            py::arg("interval"),
+            py::arg("repeat") = false,
+            D(iqin,set_level_profile)
+        )
+
+
+        
+        .def("level_stats",&iqin::level_stats,       
+            D(iqin,level_stats)
+        )
+
+
+        
+        .def("set_bus_capacity",&iqin::set_bus_capacity,       
+            py::arg("bytes_per_second"),
+            py::arg("refuse") = false,
+            D(iqin,set_bus_capacity)
+        )
+
+
+        
+        .def("bus_stats",&iqin::bus_stats,       
+            D(iqin,bus_stats)
+        )
+
         ;
 
 
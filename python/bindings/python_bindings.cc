@@ -22,6 +22,10 @@ namespace py = pybind11;
 /**************************************/
 // BINDING_FUNCTION_PROTOTYPES(
     void bind_iqin(py::module& m);
+    void bind_sequencer(py::module& m);
+    void bind_generator(py::module& m);
+    void bind_shm_ingest(py::module& m);
+    void bind_compressed_player(py::module& m);
 // ) END BINDING_FUNCTION_PROTOTYPES
 
 
@@ -51,5 +55,9 @@ PYBIND11_MODULE(vsg60_python, m)
     /**************************************/
     // BINDING_FUNCTION_CALLS(
     bind_iqin(m);
+    bind_sequencer(m);
+    bind_generator(m);
+    bind_shm_ingest(m);
+    bind_compressed_player(m);
     // ) END BINDING_FUNCTION_CALLS
 }
\ No newline at end of file
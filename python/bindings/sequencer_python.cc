@@ -0,0 +1,137 @@
+/*
+ * Copyright 2022 Free Software Foundation, Inc.
+ *
+ * This file is part of GNU Radio
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ */
+
+/***********************************************************************************/
+/* This file is automatically generated using bindtool and can be manually edited  */
+/* The following lines can be configured to regenerate this file during cmake      */
+/* If manual edits are made, the following tags should be modified accordingly.    */
+/* BINDTOOL_GEN_AUTOMATIC(0)                                                       */
+/* BINDTOOL_USE_PYGCCXML(0)                                                        */
+/* BINDTOOL_HEADER_FILE(sequencer.h)                                        */
+/* BINDTOOL_HEADER_FILE_HASH(001b698e401eb690895e71d47c7a8590)                     */
+/***********************************************************************************/
+
+#include <pybind11/complex.h>
+#include <pybind11/pybind11.h>
+#include <pybind11/stl.h>
+
+namespace py = pybind11;
+
+#include <vsg60/sequencer.h>
+// pydoc.h is automatically generated in the build directory
+#include <sequencer_pydoc.h>
+
+void bind_sequencer(py::module& m)
+{
+
+    using sequencer    = ::gr::vsg60::sequencer;
+
+
+    py::class_<sequencer, gr::block, gr::basic_block,
+        std::shared_ptr<sequencer>>(m, "sequencer", D(sequencer))
+
+        .def(py::init(&sequencer::make),
+           py::arg("srate") = 5.0E+7,
+           py::arg("loops") = 1,
+           py::arg("playlist") = "",
+           py::arg("serial") = 0,
+           D(sequencer,make)
+        )
+        
+
+
+
+
+        
+        .def("add_segment",&sequencer::add_segment,       
+            py::arg("name"),
+            py::arg("samples"),
+            D(sequencer,add_segment)
+        )
+
+
+        
+        .def("load_segment",&sequencer::load_segment,       
+            py::arg("name"),
+            py::arg("path"),
+            D(sequencer,load_segment)
+        )
+
+
+        
+        .def("add_entry",&sequencer::add_entry,       
+            py::arg("segment"),
+            py::arg("frequency"),
+            py::arg("level"),
+            py::arg("duration") = 0,
+            py::arg("repeat") = 1,
+            D(sequencer,add_entry)
+        )
+
+
+        
+        .def("load_playlist",&sequencer::load_playlist,       
+            py::arg("path"),
+            D(sequencer,load_playlist)
+        )
+
+
+        
+        .def("clear",&sequencer::clear,       
+            D(sequencer,clear)
+        )
+
+
+        
+        .def("set_srate",&sequencer::set_srate,       
+            py::arg("srate"),
+            D(sequencer,set_srate)
+        )
+
+
+        
+        .def("set_loops",&sequencer::set_loops,       
+            py::arg("loops"),
+            D(sequencer,set_loops)
+        )
+
+
+        
+        .def("transition_errors",&sequencer::transition_errors,       
+            D(sequencer,transition_errors)
+        )
+
+
+        
+        .def("set_device_priority",&sequencer::set_device_priority,       
+            py::arg("priority"),
+            D(sequencer,set_device_priority)
+        )
+
+
+        
+        .def("set_active",&sequencer::set_active,       
+            py::arg("active"),
+            D(sequencer,set_active)
+        )
+
+        ;
+
+
+
+
+}
+
+
+
+
+
+
+
+
@@ -0,0 +1,100 @@
+/*
+ * Copyright 2022 Free Software Foundation, Inc.
+ *
+ * This file is part of GNU Radio
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ */
+
+/***********************************************************************************/
+/* This file is automatically generated using bindtool and can be manually edited  */
+/* The following lines can be configured to regenerate this file during cmake      */
+/* If manual edits are made, the following tags should be modified accordingly.    */
+/* BINDTOOL_GEN_AUTOMATIC(0)                                                       */
+/* BINDTOOL_USE_PYGCCXML(0)                                                        */
+/* BINDTOOL_HEADER_FILE(shm_ingest.h)                                        */
+/* BINDTOOL_HEADER_FILE_HASH(492d9ec216805c9c4ce00ec9519142ee)                     */
+/***********************************************************************************/
+
+#include <pybind11/complex.h>
+#include <pybind11/pybind11.h>
+#include <pybind11/stl.h>
+
+namespace py = pybind11;
+
+#include <vsg60/shm_ingest.h>
+// pydoc.h is automatically generated in the build directory
+#include <shm_ingest_pydoc.h>
+
+void bind_shm_ingest(py::module& m)
+{
+
+    using shm_ingest    = ::gr::vsg60::shm_ingest;
+
+
+    py::class_<shm_ingest, gr::block, gr::basic_block,
+        std::shared_ptr<shm_ingest>>(m, "shm_ingest", D(shm_ingest))
+
+        .def(py::init(&shm_ingest::make),
+           py::arg("name") = "/vsg60",
+           py::arg("capacity") = 4194304,
+           py::arg("frequency") = 1.0E+9,
+           py::arg("level") = -10,
+           py::arg("srate") = 5.0E+7,
+           py::arg("serial") = 0,
+           D(shm_ingest,make)
+        )
+
+        
+        .def("set_frequency",&shm_ingest::set_frequency,       
+            py::arg("frequency"),
+            D(shm_ingest,set_frequency)
+        )
+
+
+        
+        .def("set_level",&shm_ingest::set_level,       
+            py::arg("level"),
+            D(shm_ingest,set_level)
+        )
+
+
+        
+        .def("set_srate",&shm_ingest::set_srate,       
+            py::arg("srate"),
+            D(shm_ingest,set_srate)
+        )
+
+
+        
+        .def("set_device_priority",&shm_ingest::set_device_priority,       
+            py::arg("priority"),
+            D(shm_ingest,set_device_priority)
+        )
+
+
+        
+        .def("set_active",&shm_ingest::set_active,       
+            py::arg("active"),
+            D(shm_ingest,set_active)
+        )
+
+
+        
+        .def("stats",&shm_ingest::stats,       
+            D(shm_ingest,stats)
+        )
+
+        ;
+
+
+
+
+}
+
+
+
+
+
+